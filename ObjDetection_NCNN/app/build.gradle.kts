@@ -54,6 +54,10 @@ android {
     buildFeatures {
         viewBinding = true
     }
+    androidResources {
+        // stored uncompressed, the weights are mapped straight from the APK (cpp/ModelFile.h)
+        noCompress += listOf("bin")
+    }
     ndkVersion = "27.2.12479018"
     buildToolsVersion = "35.0.0"
 }
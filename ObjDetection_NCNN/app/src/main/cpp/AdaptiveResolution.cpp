@@ -0,0 +1,81 @@
+//
+// Adaptive input resolution
+//
+
+#include "AdaptiveResolution.h"
+
+#include <algorithm>
+#include "Preprocess.h"
+
+void AdaptiveResolution::configure(const AdaptiveOptions &options, int target_size, int max_stride)
+{
+    std::vector<int> sizes = options.ladder;
+    if (sizes.empty())
+    {
+        const float scales[5] = {0.4f, 0.5f, 0.65f, 0.8f, 1.f};
+        for (float scale : scales)
+            sizes.push_back((int) (target_size * scale));
+    }
+    for (int &size : sizes)
+        size = std::max((size + max_stride - 1) / max_stride * max_stride, max_stride);
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ladder = sizes;
+    index = (int) ladder.size() - 1;
+    target_ms = options.target_ms;
+    window = std::max(options.window, 1);
+    this->max_stride = max_stride;
+    headroom = options.headroom;
+    sum_ms = 0.0;
+    count = 0;
+
+    current.store(target_ms > 0.f ? ladder[index] : 0);
+    ladder_generation.fetch_add(1);
+}
+
+std::vector<int> AdaptiveResolution::sizes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (target_ms <= 0.f)
+        return std::vector<int>();
+    return ladder;
+}
+
+// Padded input area of the frame at a letterbox target, what the network cost follows
+static double input_area(int img_w, int img_h, int size, int max_stride)
+{
+    LetterboxInfo letterbox = compute_letterbox(img_w, img_h, size, max_stride);
+    return (double) (letterbox.w + letterbox.wpad) * (letterbox.h + letterbox.hpad);
+}
+
+void AdaptiveResolution::update(int size, int img_w, int img_h, double ms)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (target_ms <= 0.f || size != ladder[index])
+        return;
+
+    sum_ms += ms;
+    count++;
+    if (count < window)
+        return;
+
+    const double mean_ms = sum_ms / count;
+    sum_ms = 0.0;
+    count = 0;
+
+    if (mean_ms > target_ms && index > 0)
+    {
+        index--;
+    }
+    else if (index + 1 < (int) ladder.size())
+    {
+        // the network cost grows with the padded input area
+        const double ratio = input_area(img_w, img_h, ladder[index + 1], max_stride)
+                             / input_area(img_w, img_h, ladder[index], max_stride);
+        if (mean_ms * ratio < headroom * target_ms)
+            index++;
+    }
+    current.store(ladder[index]);
+}
@@ -0,0 +1,57 @@
+//
+// Adaptive input resolution
+// Steps the letterbox target through a ladder of sizes so the measured per-frame latency stays within
+// a budget: down as soon as a window of frames runs over it, up when the next size is predicted to fit.
+// A throttled device then keeps its frame rate at a lower resolution instead of falling behind.
+//
+
+#ifndef AdaptiveResolution_H
+#define AdaptiveResolution_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+typedef struct AdaptiveOptions {
+    float target_ms = 0.f;          // per-frame latency budget, <= 0 disables the adaptive mode
+    // letterbox targets, rounded up to multiples of max_stride; empty uses 0.4, 0.5, 0.65, 0.8 and 1 x target_size
+    std::vector<int> ladder;
+    int window = 8;                 // frames averaged before each decision
+    float headroom = 0.8f;          // step up only when the predicted latency is below headroom * target_ms
+} AdaptiveOptions;
+
+class AdaptiveResolution {
+public:
+    // Starts at the largest size
+    void configure(const AdaptiveOptions &options, int target_size, int max_stride);
+
+    bool enabled() const { return current.load(std::memory_order_relaxed) > 0; }
+
+    // Letterbox target for the next frame, 0 when disabled
+    int size() const { return current.load(std::memory_order_relaxed); }
+
+    // Sizes to keep warm, ascending
+    std::vector<int> sizes() const;
+
+    // Bumped by every configure(), contexts warmed for an older ladder warm up again
+    int generation() const { return ladder_generation.load(std::memory_order_relaxed); }
+
+    // Latency of an img_w x img_h frame that ran at size; frames still in flight from before a step are ignored
+    void update(int size, int img_w, int img_h, double ms);
+
+private:
+    mutable std::mutex mutex;
+    std::vector<int> ladder;
+    int index = 0;
+    float target_ms = 0.f;
+    int window = 8;
+    float headroom = 0.8f;
+    int max_stride = 64;
+    double sum_ms = 0.0;
+    int count = 0;
+
+    std::atomic<int> current{0};
+    std::atomic<int> ladder_generation{0};
+};
+
+#endif //AdaptiveResolution_H
@@ -0,0 +1,128 @@
+//
+// Heap allocation counter
+//
+
+#include "AllocCounter.h"
+
+#ifdef OBJDET_COUNT_ALLOCATIONS
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// plain integer, no constructor runs on first access from inside operator new
+static thread_local long long alloc_count = 0;
+
+static void *counted_alloc(std::size_t size, std::size_t alignment)
+{
+    alloc_count++;
+    if (size == 0)
+        size = 1;
+
+    void *ptr = nullptr;
+    if (alignment <= alignof(std::max_align_t))
+        ptr = malloc(size);
+    else if (posix_memalign(&ptr, alignment, size) != 0)
+        ptr = nullptr;
+    return ptr;
+}
+
+void *operator new(std::size_t size)
+{
+    void *ptr = counted_alloc(size, 0);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, 0);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    void *ptr = counted_alloc(size, (std::size_t) alignment);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+bool alloc_counter_enabled()
+{
+    return true;
+}
+
+long long thread_alloc_count()
+{
+    return alloc_count;
+}
+
+#else
+
+bool alloc_counter_enabled()
+{
+    return false;
+}
+
+long long thread_alloc_count()
+{
+    return 0;
+}
+
+#endif // OBJDET_COUNT_ALLOCATIONS
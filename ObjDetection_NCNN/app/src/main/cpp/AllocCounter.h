@@ -0,0 +1,28 @@
+//
+// Heap allocation counter, to check that the detection loop runs without allocating once warmed up
+// Only counts when the core is built with OBJDET_COUNT_ALLOCATIONS, which replaces the global
+// operator new / delete. ncnn::Mat storage comes from ncnn::fastMalloc or the pool allocators of
+// the DetectContext and is not seen here.
+//
+
+#ifndef AllocCounter_H
+#define AllocCounter_H
+
+// false when built without OBJDET_COUNT_ALLOCATIONS, every count stays 0 then
+bool alloc_counter_enabled();
+
+// operator new calls made by the calling thread so far
+long long thread_alloc_count();
+
+// Allocations of the calling thread since construction, e.g. around one detect() call
+class AllocScope {
+public:
+    AllocScope() : start(thread_alloc_count()) {}
+
+    long long count() const { return thread_alloc_count() - start; }
+
+private:
+    long long start;
+};
+
+#endif //AllocCounter_H
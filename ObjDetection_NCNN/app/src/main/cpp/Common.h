@@ -0,0 +1,101 @@
+//
+// Platform-neutral types shared by the detectors
+// Nothing in here depends on JNI or the Android NDK, so the detection core can be built on any host with ncnn
+//
+
+#ifndef Common_H
+#define Common_H
+
+#include <vector>
+#include "mat.h"
+
+typedef struct BoxInfo {
+    float x1;
+    float y1;
+    float w;
+    float h;
+    float score;
+    int label;
+} BoxInfo;
+
+// Memory layout of an interleaved 8-bit pixel buffer
+enum PixelFormat {
+    PIXEL_FORMAT_RGBA = 0,      // Android Bitmap ARGB_8888 is stored as RGBA in memory
+    PIXEL_FORMAT_BGRA,
+    PIXEL_FORMAT_RGB,
+    PIXEL_FORMAT_BGR,
+    PIXEL_FORMAT_GRAY,
+};
+
+typedef struct ImageBuffer {
+    const unsigned char *data;
+    int width;
+    int height;
+    int stride;                 // bytes per row, 0 means tightly packed
+    PixelFormat format;
+} ImageBuffer;
+
+// Android YUV_420_888 frame (ImageProxy / media.Image planes): full resolution luma, 2x2 subsampled chroma
+// NV21 and NV12 are the special case uv_pixel_stride == 2 with interleaved u and v pointers
+typedef struct YuvImageBuffer {
+    const unsigned char *y;
+    const unsigned char *u;
+    const unsigned char *v;
+    int width;                  // sensor frame size, before rotation
+    int height;
+    int y_row_stride;
+    int uv_row_stride;
+    int uv_pixel_stride;
+    int rotation;               // clockwise degrees that make the frame upright: 0, 90, 180 or 270
+} YuvImageBuffer;
+
+static inline int pixel_format_channels(PixelFormat format)
+{
+    switch (format)
+    {
+        case PIXEL_FORMAT_RGBA:
+        case PIXEL_FORMAT_BGRA:
+            return 4;
+        case PIXEL_FORMAT_RGB:
+        case PIXEL_FORMAT_BGR:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+static inline int image_row_stride(const ImageBuffer &image)
+{
+    return image.stride ? image.stride : image.width * pixel_format_channels(image.format);
+}
+
+// Geometry of the letterbox that maps an image into the network input
+typedef struct LetterboxInfo {
+    int img_w;                  // source image size
+    int img_h;
+    int w;                      // resized image size
+    int h;
+    int wpad;                   // total padding up to a multiple of max_stride, split evenly on both sides
+    int hpad;
+    float scale;                // resized / source
+} LetterboxInfo;
+
+// ncnn pixel conversion type from the buffer layout to the channel order the model was trained with
+static inline int pixel_convert_type(PixelFormat format, bool to_bgr)
+{
+    switch (format)
+    {
+        case PIXEL_FORMAT_RGBA:
+            return to_bgr ? ncnn::Mat::PIXEL_RGBA2BGR : ncnn::Mat::PIXEL_RGBA2RGB;
+        case PIXEL_FORMAT_BGRA:
+            return to_bgr ? ncnn::Mat::PIXEL_BGRA2BGR : ncnn::Mat::PIXEL_BGRA2RGB;
+        case PIXEL_FORMAT_RGB:
+            return to_bgr ? ncnn::Mat::PIXEL_RGB2BGR : ncnn::Mat::PIXEL_RGB;
+        case PIXEL_FORMAT_BGR:
+            return to_bgr ? ncnn::Mat::PIXEL_BGR : ncnn::Mat::PIXEL_BGR2RGB;
+        default:
+            return to_bgr ? ncnn::Mat::PIXEL_GRAY2BGR : ncnn::Mat::PIXEL_GRAY2RGB;
+    }
+}
+
+#endif //Common_H
@@ -0,0 +1,198 @@
+//
+// CPU clusters and thread placement
+//
+
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static int read_max_freq_khz(int cpu)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    int khz = 0;
+    if (fscanf(fp, "%d", &khz) != 1)
+        khz = 0;
+    fclose(fp);
+    return khz;
+}
+
+static std::vector<CpuCluster> detect_clusters()
+{
+    const int count = std::max(ncnn::get_cpu_count(), 1);
+
+    // cores sharing a maximum frequency share a cluster; cores without cpufreq (offline, or a kernel
+    // that hides it) end up together in a cluster of their own at 0 kHz, sorted last
+    std::vector<CpuCluster> clusters;
+    for (int cpu = 0; cpu < count; cpu++)
+    {
+        const int khz = read_max_freq_khz(cpu);
+        auto it = std::find_if(clusters.begin(), clusters.end(), [khz](const CpuCluster &c) { return c.max_freq_khz == khz; });
+        if (it == clusters.end())
+        {
+            clusters.push_back(CpuCluster());
+            it = clusters.end() - 1;
+            it->max_freq_khz = khz;
+        }
+        it->cpus.push_back(cpu);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const CpuCluster &a, const CpuCluster &b) { return a.max_freq_khz > b.max_freq_khz; });
+    return clusters;
+}
+
+const std::vector<CpuCluster> &cpu_clusters()
+{
+    static const std::vector<CpuCluster> clusters = detect_clusters();
+    return clusters;
+}
+
+std::string cpu_layout()
+{
+    std::string layout;
+    char part[32];
+    for (const CpuCluster &cluster : cpu_clusters())
+    {
+        snprintf(part, sizeof(part), "%s%dx%d", layout.empty() ? "" : ",", cluster.max_freq_khz, (int) cluster.cpus.size());
+        layout += part;
+    }
+    return layout;
+}
+
+ncnn::CpuSet cluster_cpuset(unsigned int cluster_mask)
+{
+    const std::vector<CpuCluster> &clusters = cpu_clusters();
+
+    ncnn::CpuSet set;
+    set.disable_all();
+    for (size_t i = 0; i < clusters.size() && i < 32; i++)
+    {
+        if (cluster_mask & (1u << i))
+        {
+            for (int cpu : clusters[i].cpus)
+                set.enable(cpu);
+        }
+    }
+    return set;
+}
+
+// Clusters of the plan that exist on this device
+static unsigned int valid_clusters(unsigned int cluster_mask)
+{
+    const size_t n = std::min(cpu_clusters().size(), (size_t) 32);
+    const unsigned int all = n == 32 ? ~0u : (1u << n) - 1;
+    return cluster_mask & all;
+}
+
+int plan_threads(const SchedulingPlan &plan)
+{
+    if (plan.infer_threads > 0)
+        return plan.infer_threads;
+
+    const unsigned int mask = valid_clusters(plan.infer_clusters);
+    if (mask == 0)
+        return 0;
+    return cluster_cpuset(mask).num_enabled();
+}
+
+void plan_cpusets(const SchedulingPlan &plan, ncnn::CpuSet &infer, ncnn::CpuSet &aux)
+{
+    const unsigned int mask = valid_clusters(plan.infer_clusters);
+    infer = mask ? cluster_cpuset(mask) : ncnn::get_cpu_thread_affinity_mask(2);
+
+    aux.disable_all();
+    if (!plan.pin_aux)
+        return;
+
+    const int count = std::max(ncnn::get_cpu_count(), 1);
+    for (int cpu = 0; cpu < count; cpu++)
+    {
+        if (!infer.is_enabled(cpu))
+            aux.enable(cpu);
+    }
+    // inference took every core, share them
+    if (aux.num_enabled() == 0)
+        aux = cluster_cpuset(~0u);
+}
+
+std::string format_plan(const SchedulingPlan &plan)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "clusters=%u threads=%d aux=%d", plan.infer_clusters, plan.infer_threads,
+             plan.pin_aux ? 1 : 0);
+    return text;
+}
+
+bool parse_plan(const std::string &text, SchedulingPlan &plan)
+{
+    const unsigned int n = (unsigned int) std::min(cpu_clusters().size(), (size_t) 31);
+    const unsigned int all = (1u << n) - 1;
+
+    SchedulingPlan parsed;
+    if (text == "prime")
+    {
+        parsed.infer_clusters = 1;
+    }
+    else if (text == "performance")
+    {
+        parsed.infer_clusters = n > 1 ? all >> 1 : all;
+    }
+    else if (text == "all")
+    {
+        parsed.infer_clusters = all;
+    }
+    else
+    {
+        unsigned int clusters = 0;
+        int threads = 0;
+        int aux = 1;
+        if (sscanf(text.c_str(), "clusters=%u threads=%d aux=%d", &clusters, &threads, &aux) != 3)
+            return false;
+        parsed.infer_clusters = clusters;
+        parsed.infer_threads = threads;
+        parsed.pin_aux = aux != 0;
+    }
+
+    plan = parsed;
+    return true;
+}
+
+void candidate_plans(std::vector<SchedulingPlan> &plans)
+{
+    const std::vector<CpuCluster> &clusters = cpu_clusters();
+    const int n = (int) std::min(clusters.size(), (size_t) 31);
+
+    plans.clear();
+    auto add = [&plans](unsigned int mask, int threads) {
+        SchedulingPlan plan;
+        plan.infer_clusters = mask;
+        plan.infer_threads = threads;
+        for (const SchedulingPlan &p : plans)
+        {
+            if (p.infer_clusters == plan.infer_clusters && plan_threads(p) == plan_threads(plan))
+                return;
+        }
+        plans.push_back(plan);
+    };
+
+    // ncnn's own big cores, so a tuned plan never loses to the default
+    add(0, 0);
+
+    // the fastest k clusters: prime core only, prime + big, ..., every core
+    for (int k = 1; k <= n; k++)
+        add((1u << k) - 1, 0);
+
+    // a middle cluster on its own, e.g. the three A710, leaving the prime core to the rest of the app
+    for (int i = 1; i < n - 1; i++)
+        add(1u << i, 0);
+
+    // one thread on the fastest core, often the winner for small models
+    if (!clusters.empty() && clusters[0].cpus.size() > 1)
+        add(1, 1);
+}
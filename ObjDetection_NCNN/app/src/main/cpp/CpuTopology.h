@@ -0,0 +1,54 @@
+//
+// CPU clusters and thread placement
+// Cores are grouped by their maximum frequency read from sysfs cpufreq, fastest cluster first, so a
+// tri-cluster SoC such as the Snapdragon 8 Gen 1 shows up as 1 x X2 + 3 x A710 + 4 x A510 instead of
+// ncnn's two-way big/little split. A SchedulingPlan says which clusters and how many threads the
+// inference gets; pre/post-processing workers go to the remaining cores so they do not compete with it.
+//
+
+#ifndef CpuTopology_H
+#define CpuTopology_H
+
+#include <string>
+#include <vector>
+#include "cpu.h"
+
+typedef struct CpuCluster {
+    int max_freq_khz;           // 0 when cpufreq is not readable
+    std::vector<int> cpus;
+} CpuCluster;
+
+// Detected once, fastest first; a single cluster of every core when sysfs has no cpufreq entries
+const std::vector<CpuCluster> &cpu_clusters();
+
+// "2995200x1,2496000x3,1785600x4", a saved plan is only reused on the same layout
+std::string cpu_layout();
+
+// Cores of the clusters in cluster_mask, bit i being cpu_clusters()[i]
+ncnn::CpuSet cluster_cpuset(unsigned int cluster_mask);
+
+typedef struct SchedulingPlan {
+    // clusters the inference threads are pinned to, bit i being cpu_clusters()[i]; 0 keeps ncnn's big cores
+    unsigned int infer_clusters = 0;
+    int infer_threads = 0;      // <= 0 runs one thread per core of infer_clusters
+    bool pin_aux = true;        // pre/post-processing workers on the cores left over, all of them if none are
+} SchedulingPlan;
+
+// Thread count the plan gives the net, 0 when it keeps the detector's own
+int plan_threads(const SchedulingPlan &plan);
+
+// Inference cores, and the cores for everything else
+void plan_cpusets(const SchedulingPlan &plan, ncnn::CpuSet &infer, ncnn::CpuSet &aux);
+
+// "clusters=1 threads=1 aux=1"
+std::string format_plan(const SchedulingPlan &plan);
+
+// Reads format_plan's output, or one of the presets "prime" (fastest cluster), "performance"
+// (every cluster but the slowest) and "all"; false leaves plan untouched
+bool parse_plan(const std::string &text, SchedulingPlan &plan);
+
+// Configurations worth timing on this layout: ncnn's default, the fastest k clusters for every k,
+// each cluster but the slowest on its own, and a single thread on the fastest core
+void candidate_plans(std::vector<SchedulingPlan> &plans);
+
+#endif //CpuTopology_H
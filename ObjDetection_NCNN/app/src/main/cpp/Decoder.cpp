@@ -0,0 +1,411 @@
+//
+// Proposal decoders for the detection heads
+//
+
+#include "Decoder.h"
+
+#include <cfloat>
+#include <cmath>
+#include "SimdMath.h"
+
+static inline float sigmoid(float x)
+{
+    return static_cast<float>(1.f / (1.f + expf(-x)));
+}
+
+// Smallest logit whose sigmoid can still reach prob_threshold.
+// The margin keeps the float rounding of the exact test on the safe side, the full sigmoid check still decides.
+static float logit_threshold(float prob_threshold)
+{
+    if (prob_threshold <= 0.f || prob_threshold >= 1.f)
+        return -FLT_MAX;
+
+    return logf(prob_threshold / (1.f - prob_threshold)) - 1e-3f;
+}
+
+// Class argmax for 4 neighbouring cells, class k of the cells starts at ptr + k * cstep
+// Ties keep the lowest class index like the reference loop
+// NUM_CLASS > 0 fixes the trip count at compile time, 0 takes num_class
+template<int NUM_CLASS>
+static inline void argmax_4cells(const float *ptr, size_t cstep, int num_class, float *max_score, int *max_index)
+{
+    if (NUM_CLASS > 0)
+        num_class = NUM_CLASS;
+
+#if __ARM_NEON
+    float32x4_t _max = vld1q_f32(ptr);
+    float32x4_t _index = vdupq_n_f32(0.f);
+    float32x4_t _k = vdupq_n_f32(0.f);
+    const float32x4_t _one = vdupq_n_f32(1.f);
+    for (int k = 1; k < num_class; k++)
+    {
+        _k = vaddq_f32(_k, _one);
+        float32x4_t _v = vld1q_f32(ptr + k * cstep);
+        uint32x4_t _gt = vcgtq_f32(_v, _max);
+        _max = vbslq_f32(_gt, _v, _max);
+        _index = vbslq_f32(_gt, _k, _index);
+    }
+    vst1q_f32(max_score, _max);
+    int32x4_t _index_i = vcvtq_s32_f32(_index);
+    vst1q_s32(max_index, _index_i);
+#elif __SSE2__
+    __m128 _max = _mm_loadu_ps(ptr);
+    __m128 _index = _mm_setzero_ps();
+    __m128 _k = _mm_setzero_ps();
+    const __m128 _one = _mm_set1_ps(1.f);
+    for (int k = 1; k < num_class; k++)
+    {
+        _k = _mm_add_ps(_k, _one);
+        __m128 _v = _mm_loadu_ps(ptr + k * cstep);
+        __m128 _gt = _mm_cmpgt_ps(_v, _max);
+        _max = _mm_or_ps(_mm_and_ps(_gt, _v), _mm_andnot_ps(_gt, _max));
+        _index = _mm_or_ps(_mm_and_ps(_gt, _k), _mm_andnot_ps(_gt, _index));
+    }
+    _mm_storeu_ps(max_score, _max);
+    _mm_storeu_si128((__m128i *) max_index, _mm_cvttps_epi32(_index));
+#else
+    for (int l = 0; l < 4; l++)
+    {
+        max_score[l] = ptr[l];
+        max_index[l] = 0;
+    }
+    for (int k = 1; k < num_class; k++)
+    {
+        const float *p = ptr + k * cstep;
+        for (int l = 0; l < 4; l++)
+        {
+            if (p[l] > max_score[l])
+            {
+                max_score[l] = p[l];
+                max_index[l] = k;
+            }
+        }
+    }
+#endif
+}
+
+template<int NUM_CLASS>
+static inline void argmax_1cell(const float *ptr, size_t cstep, int num_class, float *max_score, int *max_index)
+{
+    if (NUM_CLASS > 0)
+        num_class = NUM_CLASS;
+
+    float score = ptr[0];
+    int index = 0;
+    for (int k = 1; k < num_class; k++)
+    {
+        float s = ptr[k * cstep];
+        if (s > score)
+        {
+            index = k;
+            score = s;
+        }
+    }
+    *max_score = score;
+    *max_index = index;
+}
+
+template<int NUM_CLASS>
+static void decode_yolov5(const ncnn::Mat &anchors, int stride, const ncnn::Mat &feat_blob,
+                          float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    const int num_grid_x = feat_blob.w;
+    const int num_grid_y = feat_blob.h;
+
+    const int num_anchors = anchors.w / 2;
+
+    const int num_class = NUM_CLASS > 0 ? NUM_CLASS : feat_blob.c / num_anchors - 5;
+
+    const int feat_offset = num_class + 5;
+
+    const size_t cstep = feat_blob.cstep;
+
+    // sigmoid(class_score) <= 1, so sigmoid(box_score) >= prob_threshold is necessary
+    const float obj_threshold = logit_threshold(prob_threshold);
+
+    for (int q = 0; q < num_anchors; q++)
+    {
+        const float anchor_w = anchors[q * 2];
+        const float anchor_h = anchors[q * 2 + 1];
+
+        const float *feat = (const float *) feat_blob.data + q * feat_offset * cstep;
+
+        for (int i = 0; i < num_grid_y; i++)
+        {
+            const float *ptr_box = feat + i * num_grid_x;
+            const float *ptr_obj = ptr_box + 4 * cstep;
+            const float *ptr_cls = ptr_box + 5 * cstep;
+
+            for (int j = 0; j < num_grid_x; j += 4)
+            {
+                const int lanes = std::min(4, num_grid_x - j);
+
+                // almost every cell is background, reject on the objectness logit before touching the class planes
+                bool any = false;
+                for (int l = 0; l < lanes; l++)
+                    any |= ptr_obj[j + l] >= obj_threshold;
+                if (!any)
+                    continue;
+
+                float class_scores[4];
+                int class_indexes[4];
+                if (lanes == 4)
+                {
+                    argmax_4cells<NUM_CLASS>(ptr_cls + j, cstep, num_class, class_scores, class_indexes);
+                }
+                else
+                {
+                    for (int l = 0; l < lanes; l++)
+                        argmax_1cell<NUM_CLASS>(ptr_cls + j + l, cstep, num_class, class_scores + l, class_indexes + l);
+                }
+
+                for (int l = 0; l < lanes; l++)
+                {
+                    const int x = j + l;
+
+                    float box_score = ptr_obj[x];
+                    if (box_score < obj_threshold)
+                        continue;
+
+                    float confidence = sigmoid(box_score) * sigmoid(class_scores[l]);
+                    if (confidence < prob_threshold)
+                        continue;
+
+                    // yolov5/models/yolo.py Detect forward
+                    // y = x[i].sigmoid()
+                    // y[..., 0:2] = (y[..., 0:2] * 2. - 0.5 + self.grid[i].to(x[i].device)) * self.stride[i]  # xy
+                    // y[..., 2:4] = (y[..., 2:4] * 2) ** 2 * self.anchor_grid[i]  # wh
+
+                    float dx = sigmoid(ptr_box[x]);
+                    float dy = sigmoid(ptr_box[cstep + x]);
+                    float dw = sigmoid(ptr_box[2 * cstep + x]) * 2.f;
+                    float dh = sigmoid(ptr_box[3 * cstep + x]) * 2.f;
+
+                    float pb_cx = (dx * 2.f - 0.5f + x) * stride;
+                    float pb_cy = (dy * 2.f - 0.5f + i) * stride;
+
+                    // the square is exact in double, this rounds exactly like pow(dw, 2) * anchor_w did
+                    float pb_w = (float) ((double) dw * dw * anchor_w);
+                    float pb_h = (float) ((double) dh * dh * anchor_h);
+
+                    float x0 = pb_cx - pb_w * 0.5f;
+                    float y0 = pb_cy - pb_h * 0.5f;
+                    float x1 = pb_cx + pb_w * 0.5f;
+                    float y1 = pb_cy + pb_h * 0.5f;
+
+                    BoxInfo obj;
+                    obj.x1 = x0;
+                    obj.y1 = y0;
+                    obj.w = x1 - x0;
+                    obj.h = y1 - y0;
+                    obj.label = class_indexes[l];
+                    obj.score = confidence;
+
+                    objects.push_back(obj);
+                }
+            }
+        }
+    }
+}
+
+YoloDecoder select_yolov5_decoder(int num_class)
+{
+    // single class, VOC and COCO heads
+    switch (num_class)
+    {
+    case 1:
+        return decode_yolov5<1>;
+    case 20:
+        return decode_yolov5<20>;
+    case 80:
+        return decode_yolov5<80>;
+    default:
+        return decode_yolov5<0>;
+    }
+}
+
+void generate_proposals_yolov5(const ncnn::Mat &anchors, int stride, const ncnn::Mat &feat_blob,
+                               float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    const int num_class = feat_blob.c / (anchors.w / 2) - 5;
+    select_yolov5_decoder(num_class)(anchors, stride, feat_blob, prob_threshold, objects);
+}
+
+// Distribution focal loss: softmax over the bins of each side, then the expectation of the bin index
+// dfl holds the bins interleaved by side (dfl[l * 4 + side]) so the 4 sides of a box share one vector
+static inline void dfl_decode(const float *dfl, int num_bins, float *distances)
+{
+#if __ARM_NEON
+    float32x4_t _max = vld1q_f32(dfl);
+    for (int l = 1; l < num_bins; l++)
+        _max = vmaxq_f32(_max, vld1q_f32(dfl + l * 4));
+
+    float32x4_t _sum = vdupq_n_f32(0.f);
+    float32x4_t _dot = vdupq_n_f32(0.f);
+    float32x4_t _l = vdupq_n_f32(0.f);
+    const float32x4_t _one = vdupq_n_f32(1.f);
+    for (int l = 0; l < num_bins; l++)
+    {
+        float32x4_t _e = exp_ps(vsubq_f32(vld1q_f32(dfl + l * 4), _max));
+        _sum = vaddq_f32(_sum, _e);
+        _dot = vmlaq_f32(_dot, _e, _l);
+        _l = vaddq_f32(_l, _one);
+    }
+#if __aarch64__
+    vst1q_f32(distances, vdivq_f32(_dot, _sum));
+#else
+    float32x4_t _reciprocal = vrecpeq_f32(_sum);
+    _reciprocal = vmulq_f32(vrecpsq_f32(_sum, _reciprocal), _reciprocal);
+    _reciprocal = vmulq_f32(vrecpsq_f32(_sum, _reciprocal), _reciprocal);
+    vst1q_f32(distances, vmulq_f32(_dot, _reciprocal));
+#endif
+#elif __SSE2__
+    __m128 _max = _mm_loadu_ps(dfl);
+    for (int l = 1; l < num_bins; l++)
+        _max = _mm_max_ps(_max, _mm_loadu_ps(dfl + l * 4));
+
+    __m128 _sum = _mm_setzero_ps();
+    __m128 _dot = _mm_setzero_ps();
+    __m128 _l = _mm_setzero_ps();
+    const __m128 _one = _mm_set1_ps(1.f);
+    for (int l = 0; l < num_bins; l++)
+    {
+        __m128 _e = exp_ps(_mm_sub_ps(_mm_loadu_ps(dfl + l * 4), _max));
+        _sum = _mm_add_ps(_sum, _e);
+        _dot = _mm_add_ps(_dot, _mm_mul_ps(_e, _l));
+        _l = _mm_add_ps(_l, _one);
+    }
+    _mm_storeu_ps(distances, _mm_div_ps(_dot, _sum));
+#else
+    for (int k = 0; k < 4; k++)
+    {
+        float max = dfl[k];
+        for (int l = 1; l < num_bins; l++)
+            max = std::max(max, dfl[l * 4 + k]);
+
+        float sum = 0.f;
+        float dot = 0.f;
+        for (int l = 0; l < num_bins; l++)
+        {
+            float e = expf(dfl[l * 4 + k] - max);
+            sum += e;
+            dot += e * l;
+        }
+        distances[k] = dot / sum;
+    }
+#endif
+}
+
+template<int NUM_CLASS>
+static void decode_nanodet(const ncnn::Mat &pred, int stride, int num_class,
+                           float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    if (NUM_CLASS > 0)
+        num_class = NUM_CLASS;
+
+    const int num_grid_x = pred.w;
+    const int num_grid_y = pred.h;
+
+    const int reg_max_1 = (pred.c - num_class) / 4;
+
+    const size_t cstep = pred.cstep;
+
+    const float score_threshold = logit_threshold(prob_threshold);
+
+    // bins of the current cell, reused for every cell
+    float dfl_local[4 * 32];
+    std::vector<float> dfl_large;
+    float *dfl = dfl_local;
+    if (reg_max_1 > 32)
+    {
+        dfl_large.resize(4 * reg_max_1);
+        dfl = dfl_large.data();
+    }
+
+    const float *pred_cls = (const float *) pred.data;
+    const float *pred_dis = pred_cls + num_class * cstep;
+
+    for (int i = 0; i < num_grid_y; i++)
+    {
+        const float *ptr_cls = pred_cls + i * num_grid_x;
+
+        for (int j = 0; j < num_grid_x; j += 4)
+        {
+            const int lanes = std::min(4, num_grid_x - j);
+
+            float class_scores[4];
+            int class_indexes[4];
+            if (lanes == 4)
+            {
+                argmax_4cells<NUM_CLASS>(ptr_cls + j, cstep, num_class, class_scores, class_indexes);
+            }
+            else
+            {
+                for (int l = 0; l < lanes; l++)
+                    argmax_1cell<NUM_CLASS>(ptr_cls + j + l, cstep, num_class, class_scores + l, class_indexes + l);
+            }
+
+            for (int l = 0; l < lanes; l++)
+            {
+                if (class_scores[l] < score_threshold)
+                    continue;
+
+                float score = sigmoid(class_scores[l]);
+                if (score < prob_threshold)
+                    continue;
+
+                const int x = j + l;
+                const float *ptr_dis = pred_dis + i * num_grid_x + x;
+                for (int k = 0; k < 4; k++)
+                {
+                    for (int b = 0; b < reg_max_1; b++)
+                    {
+                        dfl[b * 4 + k] = ptr_dis[(k * reg_max_1 + b) * cstep];
+                    }
+                }
+
+                float distances[4];
+                dfl_decode(dfl, reg_max_1, distances);
+
+                float pb_cx = x * stride;
+                float pb_cy = i * stride;
+
+                float x0 = pb_cx - distances[0] * stride;
+                float y0 = pb_cy - distances[1] * stride;
+                float x1 = pb_cx + distances[2] * stride;
+                float y1 = pb_cy + distances[3] * stride;
+
+                BoxInfo obj;
+                obj.x1 = x0;
+                obj.y1 = y0;
+                obj.w = x1 - x0;
+                obj.h = y1 - y0;
+                obj.label = class_indexes[l];
+                obj.score = score;
+
+                objects.push_back(obj);
+            }
+        }
+    }
+}
+
+GflDecoder select_nanodet_decoder(int num_class)
+{
+    switch (num_class)
+    {
+    case 1:
+        return decode_nanodet<1>;
+    case 20:
+        return decode_nanodet<20>;
+    case 80:
+        return decode_nanodet<80>;
+    default:
+        return decode_nanodet<0>;
+    }
+}
+
+void generate_proposals_nanodet(const ncnn::Mat &pred, int stride, int num_class,
+                                float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    select_nanodet_decoder(num_class)(pred, stride, num_class, prob_threshold, objects);
+}
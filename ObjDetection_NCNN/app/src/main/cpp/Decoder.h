@@ -0,0 +1,36 @@
+//
+// Proposal decoders for the detection heads
+// Both detectors share these so the hot loops can be benchmarked on a host without a device
+//
+
+#ifndef Decoder_H
+#define Decoder_H
+
+#include "mat.h"
+#include "Common.h"
+
+// YOLOv5 anchor-based head, feat_blob is (grid_w, grid_h, num_anchors * (5 + num_class))
+// Cells are rejected on the objectness logit first, then the class argmax runs over contiguous channel rows
+// Produces exactly the same boxes as the reference sigmoid(obj) * sigmoid(max cls) >= prob_threshold decoder
+void generate_proposals_yolov5(const ncnn::Mat &anchors, int stride, const ncnn::Mat &feat_blob,
+                               float prob_threshold, std::vector<BoxInfo> &objects);
+
+// NanoDet-Plus anchor-free GFL head, pred is (grid_w, grid_h, num_class + 4 * (reg_max + 1))
+// The distribution focal loss softmax and expectation are fused per cell, no per-cell Mat or layer is created
+void generate_proposals_nanodet(const ncnn::Mat &pred, int stride, int num_class,
+                                float prob_threshold, std::vector<BoxInfo> &objects);
+
+typedef void (*YoloDecoder)(const ncnn::Mat &anchors, int stride, const ncnn::Mat &feat_blob,
+                            float prob_threshold, std::vector<BoxInfo> &objects);
+
+typedef void (*GflDecoder)(const ncnn::Mat &pred, int stride, int num_class,
+                           float prob_threshold, std::vector<BoxInfo> &objects);
+
+// Decoders with the class loop unrolled at compile time for the common class counts (1, 20, 80),
+// the generic one otherwise; the blob must really have num_class classes.
+// The functions above pick one on every call, a configured model picks its decoder once.
+YoloDecoder select_yolov5_decoder(int num_class);
+
+GflDecoder select_nanodet_decoder(int num_class);
+
+#endif //Decoder_H
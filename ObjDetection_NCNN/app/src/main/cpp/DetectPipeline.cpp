@@ -0,0 +1,372 @@
+//
+// Asynchronous detection pipeline
+//
+
+#include "DetectPipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "cpu.h"
+
+#if defined __ANDROID__ || defined __linux__
+#include <sched.h>
+#endif
+
+// Pin the calling worker to the little (1) or big (2) cluster, 0 leaves it to the scheduler
+static void pin_current_thread(int powersave, bool openmp_team)
+{
+    if (powersave == 0)
+        return;
+
+    const ncnn::CpuSet &mask = ncnn::get_cpu_thread_affinity_mask(powersave);
+    if (mask.num_enabled() == 0)
+        return;
+
+    if (openmp_team)
+    {
+        // the inference worker also pins the OpenMP threads ncnn runs the layers on
+        ncnn::set_cpu_thread_affinity(mask);
+        return;
+    }
+
+#if defined __ANDROID__ || defined __linux__
+    sched_setaffinity(0, sizeof(cpu_set_t), &mask.cpu_set);
+#endif
+}
+
+// Tightly packed copy of the image rows into pixels
+static void copy_image(const ImageBuffer &image, std::vector<unsigned char> &pixels, ImageBuffer &copy)
+{
+    const int row_bytes = image.width * pixel_format_channels(image.format);
+    const int stride = image_row_stride(image);
+
+    pixels.resize((size_t) row_bytes * image.height);
+    for (int y = 0; y < image.height; y++)
+        memcpy(pixels.data() + (size_t) y * row_bytes, image.data + (size_t) y * stride, row_bytes);
+
+    copy = image;
+    copy.data = pixels.data();
+    copy.stride = row_bytes;
+}
+
+// Planar I420 copy of a YUV_420_888 frame, whatever the strides of the source planes
+static void copy_yuv(const YuvImageBuffer &image, std::vector<unsigned char> &pixels, YuvImageBuffer &copy)
+{
+    const int w = image.width;
+    const int h = image.height;
+    const int uv_w = (w + 1) / 2;
+    const int uv_h = (h + 1) / 2;
+
+    pixels.resize((size_t) w * h + (size_t) uv_w * uv_h * 2);
+    unsigned char *y = pixels.data();
+    unsigned char *u = y + (size_t) w * h;
+    unsigned char *v = u + (size_t) uv_w * uv_h;
+
+    for (int i = 0; i < h; i++)
+        memcpy(y + (size_t) i * w, image.y + (size_t) i * image.y_row_stride, w);
+
+    for (int i = 0; i < uv_h; i++)
+    {
+        const unsigned char *urow = image.u + (size_t) i * image.uv_row_stride;
+        const unsigned char *vrow = image.v + (size_t) i * image.uv_row_stride;
+        unsigned char *uptr = u + (size_t) i * uv_w;
+        unsigned char *vptr = v + (size_t) i * uv_w;
+        if (image.uv_pixel_stride == 1)
+        {
+            memcpy(uptr, urow, uv_w);
+            memcpy(vptr, vrow, uv_w);
+        }
+        else
+        {
+            for (int j = 0; j < uv_w; j++)
+            {
+                uptr[j] = urow[j * image.uv_pixel_stride];
+                vptr[j] = vrow[j * image.uv_pixel_stride];
+            }
+        }
+    }
+
+    copy = image;
+    copy.y = y;
+    copy.u = u;
+    copy.v = v;
+    copy.y_row_stride = w;
+    copy.uv_row_stride = uv_w;
+    copy.uv_pixel_stride = 1;
+}
+
+DetectPipeline::DetectPipeline(std::shared_ptr<Detector> detector, const PipelineOptions &options)
+    : detector(std::move(detector)), options(options)
+{
+    const int depth = std::max(this->options.depth, 1);
+    for (int i = 0; i < depth; i++)
+    {
+        slots.emplace_back(new Slot());
+        free_slots.push_back(slots.back().get());
+    }
+
+    // without temporal reuse every frame is a key frame, the tracker still numbers the boxes
+    TemporalOptions temporal = this->options.temporal;
+    if (!this->options.temporal_reuse)
+        temporal.max_interval = 1;
+    scheduler.configure(temporal);
+    tracker = BoxTracker(temporal.tracker);
+
+    for (int stage = 0; stage < 3; stage++)
+        workers[stage] = std::thread(&DetectPipeline::worker, this, stage);
+}
+
+DetectPipeline::~DetectPipeline()
+{
+    stop();
+}
+
+void DetectPipeline::stop()
+{
+    // stage by stage, so every frame already accepted by a stage still reaches the end
+    for (int stage = 0; stage < 3; stage++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping[stage] = true;
+        }
+        stage_cv[stage].notify_all();
+        if (stage == 0)
+            free_cv.notify_all();
+
+        if (workers[stage].joinable())
+            workers[stage].join();
+    }
+    result_cv.notify_all();
+}
+
+DetectPipeline::Slot *DetectPipeline::acquire_slot()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (free_slots.empty() && options.drop_policy == BLOCK)
+        free_cv.wait(lock, [this]() { return !free_slots.empty() || stopping[0]; });
+
+    if (stopping[0])
+        return 0;
+
+    Slot *slot = 0;
+    if (!free_slots.empty())
+    {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else if (options.drop_policy == DROP_OLDEST)
+    {
+        // the oldest frame that is not in the network yet is stale anyway
+        std::deque<Slot *> *queue = 0;
+        if (!queues[0].empty())
+            queue = &queues[0];
+        if (!queues[1].empty() && (!queue || queues[1].front()->frame_id < queue->front()->frame_id))
+            queue = &queues[1];
+
+        if (queue)
+        {
+            slot = queue->front();
+            queue->pop_front();
+        }
+        num_dropped++;
+    }
+    else
+    {
+        num_dropped++;
+    }
+
+    if (slot)
+        slot->frame_id = next_frame_id++;
+
+    return slot;
+}
+
+void DetectPipeline::enqueue(int stage, Slot *slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queues[stage].push_back(slot);
+    }
+    stage_cv[stage].notify_one();
+}
+
+long long DetectPipeline::submit(const ImageBuffer &image, float threshold, float nms_threshold)
+{
+    Slot *slot = acquire_slot();
+    if (!slot)
+        return -1;
+
+    slot->is_yuv = false;
+    slot->threshold = threshold;
+    slot->nms_threshold = nms_threshold;
+    slot->width = image.width;
+    slot->height = image.height;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->key_frame = scheduler.key_frame(image);
+    }
+    if (slot->key_frame)
+        copy_image(image, slot->pixels, slot->image);
+
+    const long long frame_id = slot->frame_id;
+    enqueue(0, slot);
+    return frame_id;
+}
+
+long long DetectPipeline::submit(const YuvImageBuffer &image, float threshold, float nms_threshold)
+{
+    Slot *slot = acquire_slot();
+    if (!slot)
+        return -1;
+
+    slot->is_yuv = true;
+    slot->threshold = threshold;
+    slot->nms_threshold = nms_threshold;
+    yuv_rotated_size(image, slot->width, slot->height);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->key_frame = scheduler.key_frame(image);
+    }
+    if (slot->key_frame)
+        copy_yuv(image, slot->pixels, slot->yuv);
+
+    const long long frame_id = slot->frame_id;
+    enqueue(0, slot);
+    return frame_id;
+}
+
+void DetectPipeline::worker(int stage)
+{
+    // a detector with a scheduling plan decides itself where inference and the other stages run
+    if (!detector->pin_current_thread(stage == 1))
+        pin_current_thread(options.powersave[stage], stage == 1);
+
+    for (;;)
+    {
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stage_cv[stage].wait(lock, [this, stage]() { return !queues[stage].empty() || stopping[stage]; });
+            if (queues[stage].empty())
+                return;
+
+            slot = queues[stage].front();
+            queues[stage].pop_front();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        // frames skipped by the scheduler only get boxes from the tracker in the last stage
+        if (stage == 0 && slot->key_frame)
+        {
+            detector->begin_frame(slot->ctx);
+            if (slot->is_yuv)
+                detector->preprocess(slot->yuv, slot->ctx);
+            else
+                detector->preprocess(slot->image, slot->ctx);
+        }
+        else if (stage == 1 && slot->key_frame)
+        {
+            // adaptive mode: the first frame of a slot warms its allocators for the whole ladder
+            detector->warm_up(slot->ctx, slot->ctx.letterbox.img_w, slot->ctx.letterbox.img_h);
+            const double infer_start = stage_clock_ms();
+            detector->infer(slot->ctx);
+            detector->record_stage(slot->ctx, STAGE_INFER, infer_start, stage_clock_ms());
+        }
+        else if (stage == 2)
+        {
+            // frames leave the last stage in submission order, the tracker sees them one after the other
+            tracker.predict();
+            if (slot->key_frame)
+            {
+                detector->postprocess(slot->ctx, slot->threshold, slot->nms_threshold, slot->boxes);
+                detector->end_frame(slot->ctx);
+                tracker.update(slot->boxes, slot->track_ids);
+            }
+            else
+            {
+                tracker.current(slot->width, slot->height, slot->boxes, slot->track_ids);
+            }
+        }
+        slot->stage_ms[stage] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (stage < 2)
+            enqueue(stage + 1, slot);
+        else
+            complete(slot);
+    }
+}
+
+void DetectPipeline::complete(Slot *slot)
+{
+    if (slot->key_frame)
+    {
+        detector->record_latency(slot->ctx, std::max(std::max(slot->stage_ms[0], slot->stage_ms[1]), slot->stage_ms[2]));
+
+        const float motion = tracker.motion();
+        std::lock_guard<std::mutex> lock(mutex);
+        scheduler.adapt(motion);
+    }
+
+    DetectResult result;
+    result.frame_id = slot->frame_id;
+    result.width = slot->width;
+    result.height = slot->height;
+    result.boxes.swap(slot->boxes);
+    result.track_ids.swap(slot->track_ids);
+    result.key_frame = slot->key_frame;
+
+    if (options.callback)
+        options.callback(result);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!options.callback)
+        {
+            results.push_back(std::move(result));
+            // nobody is polling, keep the latest frames only
+            while ((int) results.size() > (int) slots.size())
+                results.pop_front();
+        }
+        free_slots.push_back(slot);
+    }
+    free_cv.notify_all();
+    result_cv.notify_all();
+}
+
+bool DetectPipeline::poll(DetectResult &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (results.empty())
+        return false;
+
+    result = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+bool DetectPipeline::wait(DetectResult &result)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    result_cv.wait(lock, [this]() { return !results.empty() || free_slots.size() == slots.size(); });
+    if (results.empty())
+        return false;
+
+    result = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+void DetectPipeline::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    free_cv.wait(lock, [this]() { return free_slots.size() == slots.size(); });
+}
+
+long long DetectPipeline::dropped_frames() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_dropped;
+}
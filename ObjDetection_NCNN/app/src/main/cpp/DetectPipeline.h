@@ -0,0 +1,132 @@
+//
+// Asynchronous detection pipeline
+// Preprocessing, inference and post-processing run on their own worker threads, connected by queues,
+// so frame N+1 is letterboxed while frame N is in the network and frame N-1 is being decoded.
+// Throughput approaches the slowest stage instead of the sum of the stages.
+//
+
+#ifndef DetectPipeline_H
+#define DetectPipeline_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Detector.h"
+#include "TemporalDetector.h"
+
+typedef struct DetectResult {
+    long long frame_id;
+    int width;                  // size of the (rotated) image the boxes refer to
+    int height;
+    std::vector<BoxInfo> boxes;
+    // temporal mode: track of each box, and whether the detector ran on this frame or the tracker filled it in
+    std::vector<int> track_ids;
+    bool key_frame;
+} DetectResult;
+
+enum DropPolicy {
+    DROP_NEWEST = 0,            // reject the frame being submitted
+    DROP_OLDEST,                // replace the oldest frame that has not reached the network yet
+    BLOCK,                      // wait in submit() for a free slot
+};
+
+typedef struct PipelineOptions {
+    int depth = 4;              // frames in flight, including the ones waiting between stages
+    DropPolicy drop_policy = DROP_OLDEST;
+    // cluster each stage worker is pinned to, as ncnn powersave: 0 = any, 1 = little, 2 = big;
+    // only used when the detector has no scheduling plan
+    int powersave[3] = {1, 2, 1};
+    // called on the post-processing thread for every finished frame, otherwise results are kept for poll()
+    std::function<void(DetectResult &)> callback;
+    // detect key frames only and track the boxes in between
+    bool temporal_reuse = false;
+    TemporalOptions temporal;
+} PipelineOptions;
+
+class DetectPipeline {
+public:
+    // The pipeline keeps the detector alive, frames in flight finish on it even after it was
+    // replaced in a DetectorRegistry
+    DetectPipeline(std::shared_ptr<Detector> detector, const PipelineOptions &options);
+
+    ~DetectPipeline();
+
+    // The pixels are copied, the buffer can be released as soon as submit returns
+    // Returns the frame id, or -1 when the frame was dropped
+    long long submit(const ImageBuffer &image, float threshold, float nms_threshold);
+
+    long long submit(const YuvImageBuffer &image, float threshold, float nms_threshold);
+
+    // Oldest finished frame, false when none is ready
+    bool poll(DetectResult &result);
+
+    // Blocks until a frame finishes, false when nothing is in flight
+    bool wait(DetectResult &result);
+
+    // Blocks until every submitted frame went through all stages
+    void flush();
+
+    // Finishes the frames in flight and joins the workers, submit() fails afterwards
+    void stop();
+
+    long long dropped_frames() const;
+
+private:
+    struct Slot {
+        long long frame_id;
+        bool is_yuv;
+        // frames the scheduler skipped are not copied and only go through the tracker
+        bool key_frame;
+        int width;
+        int height;
+        float threshold;
+        float nms_threshold;
+        // owned copy of the submitted frame
+        std::vector<unsigned char> pixels;
+        ImageBuffer image;
+        YuvImageBuffer yuv;
+        DetectContext ctx;
+        std::vector<BoxInfo> boxes;
+        std::vector<int> track_ids;
+        // time spent in each stage, the slowest one bounds the frame rate
+        double stage_ms[3];
+    };
+
+    Slot *acquire_slot();
+
+    void enqueue(int stage, Slot *slot);
+
+    void worker(int stage);
+
+    void complete(Slot *slot);
+
+    std::shared_ptr<Detector> detector;
+    PipelineOptions options;
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Slot *> free_slots;
+    // frames waiting for preprocess, infer and postprocess
+    std::deque<Slot *> queues[3];
+    std::deque<DetectResult> results;
+
+    mutable std::mutex mutex;
+    std::condition_variable stage_cv[3];
+    std::condition_variable free_cv;
+    std::condition_variable result_cv;
+    bool stopping[3] = {false, false, false};
+    std::thread workers[3];
+
+    // temporal mode: the scheduler sees the frames in submission order, under mutex,
+    // the tracker in completion order on the post-processing thread
+    KeyFrameScheduler scheduler;
+    BoxTracker tracker;
+
+    long long next_frame_id = 0;
+    long long num_dropped = 0;
+};
+
+#endif //DetectPipeline_H
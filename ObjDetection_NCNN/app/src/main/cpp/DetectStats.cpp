@@ -0,0 +1,231 @@
+//
+// Runtime statistics of a detector
+//
+
+#include "DetectStats.h"
+
+#include <cmath>
+#include <cstdio>
+
+// bucket b holds durations up to first_bucket_us * 2^(b / 4), the last one everything above
+static const double first_bucket_us = 10.0;
+
+// trace ids of the threads, in the order they first recorded an event
+static std::atomic<int> next_tid(1);
+static thread_local int trace_tid = 0;
+
+const char *stage_name(int stage)
+{
+    static const char *const names[STAGE_COUNT] = {"preprocess", "infer", "decode", "sort", "nms", "frame"};
+    return stage >= 0 && stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+static double bucket_limit_us(int bucket)
+{
+    return first_bucket_us * std::exp2(bucket * 0.25);
+}
+
+static void store_max(std::atomic<uint64_t> &target, uint64_t value)
+{
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::record(double ms)
+{
+    const double us = std::max(ms * 1000.0, 0.0);
+    int bucket = us <= first_bucket_us ? 0 : (int) std::ceil(4.0 * std::log2(us / first_bucket_us));
+    bucket = std::min(bucket, num_buckets - 1);
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_us.fetch_add((uint64_t) std::llround(us), std::memory_order_relaxed);
+    store_max(max_us, (uint64_t) std::llround(us));
+}
+
+void LatencyHistogram::summarize(StageSummary &summary) const
+{
+    // buckets read one by one while other threads record: the counts may be a frame apart, never torn
+    uint64_t counts[num_buckets];
+    uint64_t n = 0;
+    for (int b = 0; b < num_buckets; b++)
+    {
+        counts[b] = buckets[b].load(std::memory_order_relaxed);
+        n += counts[b];
+    }
+
+    summary.count = n;
+    summary.max_ms = max_us.load(std::memory_order_relaxed) / 1000.0;
+    summary.mean_ms = n ? total_us.load(std::memory_order_relaxed) / 1000.0 / n : 0.0;
+
+    auto percentile = [&](double p) {
+        if (n == 0)
+            return 0.0;
+        const uint64_t rank = (uint64_t) std::ceil(p * n);
+        uint64_t seen = 0;
+        for (int b = 0; b < num_buckets - 1; b++)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+                return std::min(bucket_limit_us(b) / 1000.0, summary.max_ms);
+        }
+        return summary.max_ms;
+    };
+    summary.p50_ms = percentile(0.50);
+    summary.p90_ms = percentile(0.90);
+    summary.p99_ms = percentile(0.99);
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    total_us.store(0, std::memory_order_relaxed);
+    max_us.store(0, std::memory_order_relaxed);
+}
+
+void DetectStats::set_enabled(bool enabled, int trace_events)
+{
+    if (enabled && trace_events > 0 && !trace.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        if (!trace_storage)
+        {
+            trace_storage.reset(new TraceEvent[trace_events]);
+            trace_capacity = trace_events;
+            trace.store(trace_storage.get(), std::memory_order_release);
+        }
+    }
+    tracing.store(enabled && trace_events > 0, std::memory_order_relaxed);
+    on.store(enabled, std::memory_order_relaxed);
+}
+
+void DetectStats::record_stage(int stage, double start_ms, double end_ms)
+{
+    histograms[stage].record(end_ms - start_ms);
+
+    TraceEvent *events = trace.load(std::memory_order_acquire);
+    if (!events || !tracing.load(std::memory_order_relaxed))
+        return;
+
+    if (trace_tid == 0)
+        trace_tid = next_tid.fetch_add(1);
+
+    // a writer lapped by the whole ring while it writes would tear the slot, the sequence check drops it then
+    const uint64_t n = trace_next.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &event = events[n % trace_capacity];
+    event.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.stage.store(stage, std::memory_order_relaxed);
+    event.tid.store(trace_tid, std::memory_order_relaxed);
+    event.start_us.store((int64_t) std::llround(start_ms * 1000.0), std::memory_order_relaxed);
+    event.duration_us.store((int64_t) std::llround((end_ms - start_ms) * 1000.0), std::memory_order_relaxed);
+    event.seq.store(2 * n + 2, std::memory_order_release);
+}
+
+void DetectStats::record_frame(int proposals, int kept, uint64_t blob_hits, uint64_t blob_misses,
+                               uint64_t workspace_hits, uint64_t workspace_misses)
+{
+    frames.fetch_add(1, std::memory_order_relaxed);
+    this->proposals.fetch_add(proposals, std::memory_order_relaxed);
+    this->kept.fetch_add(kept, std::memory_order_relaxed);
+    store_max(max_proposals, proposals);
+    pool_counts[0].fetch_add(blob_hits, std::memory_order_relaxed);
+    pool_counts[1].fetch_add(blob_misses, std::memory_order_relaxed);
+    pool_counts[2].fetch_add(workspace_hits, std::memory_order_relaxed);
+    pool_counts[3].fetch_add(workspace_misses, std::memory_order_relaxed);
+}
+
+StatsSnapshot DetectStats::snapshot() const
+{
+    StatsSnapshot stats;
+    stats.frames = frames.load(std::memory_order_relaxed);
+    for (int s = 0; s < STAGE_COUNT; s++)
+        histograms[s].summarize(stats.stages[s]);
+    stats.mean_proposals = stats.frames ? (double) proposals.load(std::memory_order_relaxed) / stats.frames : 0.0;
+    stats.mean_kept = stats.frames ? (double) kept.load(std::memory_order_relaxed) / stats.frames : 0.0;
+    stats.max_proposals = max_proposals.load(std::memory_order_relaxed);
+    stats.blob_hits = pool_counts[0].load(std::memory_order_relaxed);
+    stats.blob_misses = pool_counts[1].load(std::memory_order_relaxed);
+    stats.workspace_hits = pool_counts[2].load(std::memory_order_relaxed);
+    stats.workspace_misses = pool_counts[3].load(std::memory_order_relaxed);
+    stats.trace_events = std::min(trace_next.load(std::memory_order_relaxed), (uint64_t) trace_capacity);
+    return stats;
+}
+
+void DetectStats::reset()
+{
+    for (auto &histogram : histograms)
+        histogram.reset();
+    frames.store(0, std::memory_order_relaxed);
+    proposals.store(0, std::memory_order_relaxed);
+    kept.store(0, std::memory_order_relaxed);
+    max_proposals.store(0, std::memory_order_relaxed);
+    for (auto &count : pool_counts)
+        count.store(0, std::memory_order_relaxed);
+}
+
+bool DetectStats::write_trace(const char *path) const
+{
+    const TraceEvent *events = trace.load(std::memory_order_acquire);
+    if (!events)
+        return false;
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    // oldest first; events being written or overwritten while we read are left out
+    const uint64_t next = trace_next.load(std::memory_order_acquire);
+    const uint64_t first = next > trace_capacity ? next - trace_capacity : 0;
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    bool separator = false;
+    for (uint64_t n = first; n < next; n++)
+    {
+        const TraceEvent &event = events[n % trace_capacity];
+        if (event.seq.load(std::memory_order_acquire) != 2 * n + 2)
+            continue;
+        const int stage = event.stage.load(std::memory_order_relaxed);
+        const int tid = event.tid.load(std::memory_order_relaxed);
+        const long long start_us = event.start_us.load(std::memory_order_relaxed);
+        const long long duration_us = event.duration_us.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != 2 * n + 2)
+            continue;
+
+        fprintf(fp, "%s\n{\"name\": \"%s\", \"cat\": \"detect\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %lld, \"dur\": %lld}",
+                separator ? "," : "", stage_name(stage), tid, start_us, duration_us);
+        separator = true;
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
+
+std::string format_stats(const StatsSnapshot &stats)
+{
+    std::string json;
+    char text[256];
+    snprintf(text, sizeof(text), "{\"frames\": %llu, \"stages\": {", (unsigned long long) stats.frames);
+    json += text;
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        const StageSummary &stage = stats.stages[s];
+        snprintf(text, sizeof(text),
+                 "%s\"%s\": {\"count\": %llu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+                 s ? ", " : "", stage_name(s), (unsigned long long) stage.count, stage.mean_ms, stage.p50_ms, stage.p90_ms,
+                 stage.p99_ms, stage.max_ms);
+        json += text;
+    }
+    snprintf(text, sizeof(text),
+             "}, \"proposals\": {\"mean\": %.1f, \"max\": %llu, \"kept\": %.1f}, \"blob_pool\": {\"hits\": %llu, \"misses\": %llu}, ",
+             stats.mean_proposals, (unsigned long long) stats.max_proposals, stats.mean_kept,
+             (unsigned long long) stats.blob_hits, (unsigned long long) stats.blob_misses);
+    json += text;
+    snprintf(text, sizeof(text), "\"workspace_pool\": {\"hits\": %llu, \"misses\": %llu}, \"trace_events\": %llu}",
+             (unsigned long long) stats.workspace_hits, (unsigned long long) stats.workspace_misses,
+             (unsigned long long) stats.trace_events);
+    json += text;
+    return json;
+}
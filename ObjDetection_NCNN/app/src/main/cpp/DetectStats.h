@@ -0,0 +1,256 @@
+//
+// Runtime statistics of a detector
+// Stage latencies go into fixed log-scale histograms with atomic buckets, so recording a frame takes no lock
+// and no allocation and any thread can take a snapshot meanwhile. Proposal counts and the hits / misses of the
+// context's pool allocators are summed the same way. Optionally the stages are also kept as Chrome trace
+// events in a ring buffer, written out for chrome://tracing or ui.perfetto.dev.
+//
+
+#ifndef DetectStats_H
+#define DetectStats_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allocator.h"
+
+enum DetectStage {
+    STAGE_PREPROCESS = 0,
+    STAGE_INFER,
+    STAGE_DECODE,               // with the overlapped decode, what is left after the last extract
+    STAGE_SORT,
+    STAGE_NMS,
+    STAGE_FRAME,                // first stage start to last stage end, queues of a pipeline included
+    STAGE_COUNT,
+};
+
+const char *stage_name(int stage);
+
+typedef struct StageSummary {
+    uint64_t count;
+    double mean_ms;
+    double p50_ms;              // percentiles are bucket upper bounds, within 19% of the real value
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+} StageSummary;
+
+typedef struct StatsSnapshot {
+    uint64_t frames;            // detections recorded, one per image, tile or region
+    StageSummary stages[STAGE_COUNT];
+    double mean_proposals;      // decoded proposals above the threshold, before top-k and NMS
+    double mean_kept;           // boxes left after NMS
+    uint64_t max_proposals;
+    uint64_t blob_hits;         // pool allocations served from a block the pool already held
+    uint64_t blob_misses;
+    uint64_t workspace_hits;
+    uint64_t workspace_misses;
+    uint64_t trace_events;      // events in the trace buffer
+} StatsSnapshot;
+
+// One JSON object, also what GenericDetector.getStats() returns
+std::string format_stats(const StatsSnapshot &stats);
+
+// Lock-free histogram of durations, 4 buckets per octave from 10 us to about 0.5 s
+class LatencyHistogram {
+public:
+    void record(double ms);
+
+    void summarize(StageSummary &summary) const;
+
+    void reset();
+
+private:
+    static const int num_buckets = 64;
+
+    std::atomic<uint64_t> buckets[num_buckets] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_us{0};
+    std::atomic<uint64_t> max_us{0};
+};
+
+// Pool allocator counting whether an allocation reused a block the pool held, when counting is on.
+// A block handed back by fastFree() and paid out again is a hit, any other block is a miss: the pool
+// had to ask the system for it. Blocks freed before counting started count as misses once.
+// Bytes are counted too: those of the misses, what the pool grew by, and those handed out and not back yet.
+// Limitation: only blocks going through fastFree() are seen. ncnn's pools drop a cached block on a miss once
+// they hold size_drop_threshold of them and release it straight to the system, so a counting pool turns
+// dropping off. Blocks released by clear() on the base class are not seen either; their addresses may come
+// back from the system later and be taken for hits, so the list of returned blocks is bounded.
+template<typename Pool>
+class CountingPool : public Pool {
+public:
+    CountingPool()
+    {
+        // a net reuses the same few dozen blocks every frame, the pool may as well keep them all
+        this->set_size_drop_threshold(std::numeric_limits<size_t>::max());
+    }
+
+    void clear()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            returned.clear();
+        }
+        Pool::clear();
+    }
+
+    void *fastMalloc(size_t size) override
+    {
+        void *ptr = Pool::fastMalloc(size);
+        if (counting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = std::find(returned.begin(), returned.end(), ptr);
+            if (it != returned.end())
+            {
+                *it = returned.back();
+                returned.pop_back();
+                hits++;
+            }
+            else
+            {
+                misses++;
+                grown_bytes += size;
+            }
+            live.emplace_back(ptr, size);
+            in_use += size;
+            peak = std::max(peak, in_use);
+        }
+        return ptr;
+    }
+
+    void fastFree(void *ptr) override
+    {
+        if (counting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // forget the first one should the pool release blocks behind our back after all
+            if (returned.size() >= max_returned)
+            {
+                returned.front() = returned.back();
+                returned.pop_back();
+            }
+            returned.push_back(ptr);
+            // blocks paid out before counting started are not in live
+            for (auto &block : live)
+            {
+                if (block.first == ptr)
+                {
+                    in_use -= block.second;
+                    block = live.back();
+                    live.pop_back();
+                    break;
+                }
+            }
+        }
+        Pool::fastFree(ptr);
+    }
+
+    void set_counting(bool enabled)
+    {
+        counting.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Counts since the last call
+    void take_counts(uint64_t &hits, uint64_t &misses)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        hits = this->hits;
+        misses = this->misses;
+        this->hits = 0;
+        this->misses = 0;
+    }
+
+    // Bytes of all misses while counting, an upper bound of what the pool holds after a clear()
+    uint64_t allocated_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return grown_bytes;
+    }
+
+    // Most bytes handed out at once since the last reset_peak()
+    uint64_t peak_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+    void reset_peak()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        peak = in_use;
+    }
+
+private:
+    // the workspace pool is shared by the OpenMP threads of a layer
+    mutable std::mutex mutex;
+    std::atomic<bool> counting{false};
+    // blocks the pool holds, a few dozen at most
+    static constexpr size_t max_returned = 256;
+    std::vector<void *> returned;
+    // blocks handed out, with their size
+    std::vector<std::pair<void *, size_t>> live;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t grown_bytes = 0;
+    uint64_t in_use = 0;
+    uint64_t peak = 0;
+};
+
+class DetectStats {
+public:
+    // Off by default. trace_events > 0 also keeps the stages of the last frames as trace events; the buffer
+    // is allocated on the first call asking for it and kept, later calls only switch tracing on and off.
+    void set_enabled(bool enabled, int trace_events = 0);
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    // One stage of a frame, start and end from stage_clock_ms()
+    void record_stage(int stage, double start_ms, double end_ms);
+
+    // Frame totals, once all its stages are recorded
+    void record_frame(int proposals, int kept, uint64_t blob_hits, uint64_t blob_misses, uint64_t workspace_hits,
+                      uint64_t workspace_misses);
+
+    StatsSnapshot snapshot() const;
+
+    void reset();
+
+    // Chrome trace JSON of the buffered events; false when tracing was never enabled or the file cannot be written
+    bool write_trace(const char *path) const;
+
+private:
+    typedef struct TraceEvent {
+        // 2 * n + 1 while the n-th event is being written, 2 * n + 2 once it is complete
+        std::atomic<uint64_t> seq{0};
+        std::atomic<int> stage{0};
+        std::atomic<int> tid{0};
+        std::atomic<int64_t> start_us{0};
+        std::atomic<int64_t> duration_us{0};
+    } TraceEvent;
+
+    std::atomic<bool> on{false};
+    std::atomic<bool> tracing{false};
+    LatencyHistogram histograms[STAGE_COUNT];
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> proposals{0};
+    std::atomic<uint64_t> kept{0};
+    std::atomic<uint64_t> max_proposals{0};
+    std::atomic<uint64_t> pool_counts[4] = {};
+
+    // allocated once under trace_mutex, then published through trace
+    std::mutex trace_mutex;
+    std::unique_ptr<TraceEvent[]> trace_storage;
+    size_t trace_capacity = 0;
+    std::atomic<TraceEvent *> trace{nullptr};
+    std::atomic<uint64_t> trace_next{0};
+};
+
+#endif //DetectStats_H
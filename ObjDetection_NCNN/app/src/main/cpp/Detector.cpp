@@ -0,0 +1,716 @@
+//
+// Common interface of the detection models
+//
+
+#include "Detector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include "cpu.h"
+
+#if defined __ANDROID__ || defined __linux__
+#include <sched.h>
+#endif
+
+// plan the calling thread was last pinned for, see Detector::set_scheduling
+static thread_local int pinned_plan_id = 0;
+static std::atomic<int> next_plan_id(1);
+
+std::vector<BoxInfo> Detector::detect(const ImageBuffer &image, float threshold, float nms_threshold)
+{
+    std::vector<BoxInfo> result;
+    detect(image, threshold, nms_threshold, result);
+    return result;
+}
+
+void Detector::detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result)
+{
+    std::unique_ptr<DetectContext> ctx = acquire_context();
+    const bool timed = adaptive.enabled();
+    const auto start = std::chrono::steady_clock::now();
+
+    begin_frame(*ctx);
+    preprocess(image, *ctx);
+    if (timed)
+        warm_up(*ctx, ctx->letterbox.img_w, ctx->letterbox.img_h);
+    infer_postprocess(*ctx, threshold, nms_threshold, result);
+    end_frame(*ctx);
+
+    if (timed)
+        record_latency(*ctx, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    release_context(std::move(ctx));
+}
+
+std::vector<BoxInfo> Detector::detect(const YuvImageBuffer &image, float threshold, float nms_threshold)
+{
+    std::vector<BoxInfo> result;
+    detect(image, threshold, nms_threshold, result);
+    return result;
+}
+
+void Detector::detect(const YuvImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result)
+{
+    std::unique_ptr<DetectContext> ctx = acquire_context();
+    const bool timed = adaptive.enabled();
+    const auto start = std::chrono::steady_clock::now();
+
+    begin_frame(*ctx);
+    preprocess(image, *ctx);
+    if (timed)
+        warm_up(*ctx, ctx->letterbox.img_w, ctx->letterbox.img_h);
+    infer_postprocess(*ctx, threshold, nms_threshold, result);
+    end_frame(*ctx);
+
+    if (timed)
+        record_latency(*ctx, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    release_context(std::move(ctx));
+}
+
+void Detector::detect_batch(const std::vector<ImageBuffer> &images, float threshold, float nms_threshold,
+                            std::vector<std::vector<BoxInfo>> &results, int num_workers)
+{
+    const int n = (int) images.size();
+    results.assign(n, std::vector<BoxInfo>());
+    if (n == 0)
+        return;
+
+    // same letterboxed shape next to each other, a worker then mostly keeps its input tensor
+    // and the blob sizes its pool allocators already hold
+    std::vector<long long> shape(n);
+    for (int i = 0; i < n; i++)
+    {
+        LetterboxInfo letterbox = compute_letterbox(images[i].width, images[i].height, target_size, max_stride);
+        shape[i] = (long long) (letterbox.w + letterbox.wpad) << 32 | (letterbox.h + letterbox.hpad);
+    }
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&shape](int a, int b) { return shape[a] < shape[b]; });
+
+    if (num_workers <= 0)
+        num_workers = std::max(ncnn::get_big_cpu_count(), 1);
+    num_workers = std::min(num_workers, n);
+
+    // split the net's threads between the workers instead of oversubscribing the cores
+    const int net_threads = std::max(Net ? Net->opt.num_threads : 1, 1);
+    std::vector<std::unique_ptr<DetectContext>> contexts(num_workers);
+    for (int w = 0; w < num_workers; w++)
+    {
+        contexts[w] = acquire_context();
+        contexts[w]->num_threads = std::max(net_threads / num_workers, 1);
+    }
+
+    std::atomic<int> next(0);
+    auto work = [&](int w) {
+        DetectContext &ctx = *contexts[w];
+        for (;;)
+        {
+            int k = next.fetch_add(1);
+            if (k >= n)
+                break;
+
+            const int i = order[k];
+            begin_frame(ctx);
+            preprocess(images[i], ctx);
+            infer_postprocess(ctx, threshold, nms_threshold, results[i]);
+            end_frame(ctx);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; w++)
+        workers.emplace_back(work, w);
+    work(0);
+    for (auto &worker : workers)
+        worker.join();
+
+    for (int w = 0; w < num_workers; w++)
+        release_context(std::move(contexts[w]));
+}
+
+void Detector::detect_tiled(const ImageBuffer &image, float threshold, float nms_threshold,
+                            const TileOptions &options, std::vector<BoxInfo> &result)
+{
+    result.clear();
+    if (image.width <= 0 || image.height <= 0)
+        return;
+
+    // the model's own input size, a tile is then letterboxed without being scaled down
+    int tile_size = options.tile_size > 0 ? options.tile_size : target_size;
+    std::vector<TileRect> tiles;
+    compute_tiles(image.width, image.height, tile_size, options.overlap, tiles);
+    while (options.max_tiles > 0 && (int) tiles.size() > options.max_tiles)
+    {
+        tile_size = tile_size * 5 / 4;
+        compute_tiles(image.width, image.height, tile_size, options.overlap, tiles);
+    }
+
+    const bool single_tile = tiles.size() == 1 && tiles[0].w == image.width && tiles[0].h == image.height;
+    if (options.global_pass && !single_tile)
+    {
+        TileRect whole;
+        whole.x = 0;
+        whole.y = 0;
+        whole.w = image.width;
+        whole.h = image.height;
+        tiles.push_back(whole);
+    }
+
+    std::vector<ImageBuffer> views(tiles.size());
+    for (size_t i = 0; i < tiles.size(); i++)
+        views[i] = crop_image(image, tiles[i]);
+
+    std::vector<std::vector<BoxInfo>> tile_boxes;
+    detect_batch(views, threshold, nms_threshold, tile_boxes, options.num_workers);
+
+    std::vector<TileBoxSource> sources;
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        for (BoxInfo box : tile_boxes[i])
+        {
+            box.x1 += tiles[i].x;
+            box.y1 += tiles[i].y;
+            result.push_back(box);
+            sources.push_back(tile_box_source(box, tiles[i], (int) i, image.width, image.height));
+        }
+    }
+
+    merge_tile_boxes(result, sources, options.merge, options.merge_threshold, nms_threshold);
+    if (max_detections > 0 && (int) result.size() > max_detections)
+        result.resize(max_detections);
+}
+
+void Detector::detect_regions(const ImageBuffer &image, const std::vector<TileRect> &regions, float threshold,
+                              float nms_threshold, std::vector<BoxInfo> &result)
+{
+    result.clear();
+    if (regions.empty())
+        return;
+
+    // the scale a full frame would get, the network sees the objects at the size it would see them anyway
+    const int frame_size = current_target_size();
+    const float scale = std::min((float) frame_size / std::max(image.width, image.height), 1.f);
+    // whole strides once scaled, so the letterbox adds no padding
+    const int align = (int) std::ceil(max_stride / scale);
+
+    std::unique_ptr<DetectContext> ctx = acquire_context();
+    std::vector<BoxInfo> boxes;
+    for (const TileRect &rect : regions)
+    {
+        TileRect region = rect;
+        align_tile(region, image.width, image.height, align);
+        if (region.w <= 0 || region.h <= 0)
+            continue;
+
+        const int longer = std::max(region.w, region.h);
+        begin_frame(*ctx);
+        preprocess(crop_image(image, region), *ctx, std::min((int) std::lround(longer * scale), frame_size));
+        infer_postprocess(*ctx, threshold, nms_threshold, boxes);
+        end_frame(*ctx);
+
+        for (BoxInfo box : boxes)
+        {
+            box.x1 += region.x;
+            box.y1 += region.y;
+            result.push_back(box);
+        }
+    }
+    release_context(std::move(ctx));
+}
+
+void Detector::preprocess(const ImageBuffer &image, DetectContext &ctx) const
+{
+    preprocess(image, ctx, current_target_size());
+}
+
+void Detector::preprocess(const ImageBuffer &image, DetectContext &ctx, int letterbox_size) const
+{
+    const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+    // letterbox pad to multiple of max_stride
+    // yolov5/utils/datasets.py letterbox
+    ctx.target_size = letterbox_size;
+    ctx.letterbox = compute_letterbox(image.width, image.height, ctx.target_size, max_stride);
+    ctx.preprocessor.run(image, ctx.letterbox, to_bgr, pad_value, mean_vals, norm_vals, ctx.in_pad);
+    if (ctx.times.enabled)
+        record_stage(ctx, STAGE_PREPROCESS, start, stage_clock_ms());
+}
+
+void Detector::preprocess(const YuvImageBuffer &image, DetectContext &ctx) const
+{
+    preprocess(image, ctx, current_target_size());
+}
+
+void Detector::preprocess(const YuvImageBuffer &image, DetectContext &ctx, int letterbox_size) const
+{
+    const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+    int img_w, img_h;
+    yuv_rotated_size(image, img_w, img_h);
+
+    ctx.target_size = letterbox_size;
+    ctx.letterbox = compute_letterbox(img_w, img_h, ctx.target_size, max_stride);
+    ctx.preprocessor.run(image, ctx.letterbox, to_bgr, pad_value, mean_vals, norm_vals, ctx.in_pad);
+    if (ctx.times.enabled)
+        record_stage(ctx, STAGE_PREPROCESS, start, stage_clock_ms());
+}
+
+void Detector::set_adaptive(const AdaptiveOptions &options)
+{
+    adaptive.configure(options, target_size, max_stride);
+}
+
+int Detector::current_target_size() const
+{
+    return adaptive.enabled() ? adaptive.size() : target_size;
+}
+
+void Detector::warm_up(DetectContext &ctx, int img_w, int img_h) const
+{
+    const int generation = adaptive.generation();
+    if (ctx.warm_w == img_w && ctx.warm_h == img_h && ctx.warm_generation == generation)
+        return;
+
+    ctx.warm_w = img_w;
+    ctx.warm_h = img_h;
+    ctx.warm_generation = generation;
+    const std::vector<int> sizes = adaptive.sizes();
+    if (sizes.empty())
+        return;
+
+    // the frame being processed keeps its input, the warm-up outputs go back to the pool
+    ncnn::Mat in_pad = ctx.in_pad;
+    for (int size : sizes)
+    {
+        LetterboxInfo letterbox = compute_letterbox(img_w, img_h, size, max_stride);
+        ctx.in_pad = ncnn::Mat(letterbox.w + letterbox.wpad, letterbox.h + letterbox.hpad, 3);
+        ctx.in_pad.fill(0.f);
+        infer(ctx);
+        ctx.outputs.clear();
+    }
+    ctx.in_pad = in_pad;
+}
+
+void Detector::warm_up(int img_w, int img_h)
+{
+    std::unique_ptr<DetectContext> ctx = acquire_context();
+    warm_up(*ctx, img_w, img_h);
+    release_context(std::move(ctx));
+}
+
+void Detector::prewarm(int img_w, int img_h)
+{
+    if (img_w <= 0 || img_h <= 0)
+        return;
+
+    std::vector<unsigned char> pixels((size_t) img_w * img_h * 4, 0);
+    ImageBuffer image = {pixels.data(), img_w, img_h, 0, PIXEL_FORMAT_RGBA};
+    std::vector<BoxInfo> boxes;
+
+    // like detect(), without reporting the slow first frame to the adaptive controller
+    std::unique_ptr<DetectContext> ctx = acquire_context();
+    preprocess(image, *ctx);
+    warm_up(*ctx, ctx->letterbox.img_w, ctx->letterbox.img_h);
+    infer_postprocess(*ctx, 1.f, 0.5f, boxes);
+    release_context(std::move(ctx));
+}
+
+void Detector::record_latency(const DetectContext &ctx, double ms)
+{
+    adaptive.update(ctx.target_size, ctx.letterbox.img_w, ctx.letterbox.img_h, ms);
+}
+
+void Detector::set_scheduling(const SchedulingPlan &plan)
+{
+    this->plan = plan;
+    plan_cpusets(plan, infer_cpus, aux_cpus);
+    plan_id = next_plan_id.fetch_add(1);
+
+    if (!Net)
+        return;
+    if (default_threads < 0)
+        default_threads = Net->opt.num_threads;
+    const int threads = plan_threads(plan);
+    Net->opt.num_threads = threads > 0 ? threads : default_threads;
+}
+
+bool Detector::pin_current_thread(bool inference) const
+{
+    if (plan_id == 0)
+        return false;
+
+    if (inference)
+    {
+        // pins the OpenMP threads ncnn runs the layers on, the calling thread is one of them
+        ncnn::set_cpu_thread_affinity(infer_cpus);
+        pinned_plan_id = plan_id;
+        return true;
+    }
+
+    if (aux_cpus.num_enabled() == 0)
+        return false;
+#if defined __ANDROID__ || defined __linux__
+    sched_setaffinity(0, sizeof(cpu_set_t), &aux_cpus.cpu_set);
+#endif
+    return true;
+}
+
+SchedulingPlan Detector::autotune_scheduling(int img_w, int img_h, int rounds, std::vector<double> *median_ms)
+{
+    std::vector<SchedulingPlan> candidates;
+    candidate_plans(candidates);
+    rounds = std::max(rounds, 1);
+
+    // textured frame, a flat one lets the decoder skip most of its work
+    std::vector<unsigned char> pixels((size_t) img_w * img_h * 4);
+    unsigned int seed = 12345;
+    for (unsigned char &p : pixels)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p = (unsigned char) (seed >> 16);
+    }
+    ImageBuffer image = {pixels.data(), img_w, img_h, 0, PIXEL_FORMAT_RGBA};
+
+    if (median_ms)
+        median_ms->assign(candidates.size(), 0.0);
+
+    std::vector<BoxInfo> boxes;
+    std::vector<double> times(rounds);
+    size_t best = 0;
+    double best_ms = 0.0;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        set_scheduling(candidates[c]);
+
+        // first frames on new cores fill the caches and spin the OpenMP team up
+        for (int i = 0; i < 2; i++)
+            detect(image, 0.4f, 0.5f, boxes);
+        for (int i = 0; i < rounds; i++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            detect(image, 0.4f, 0.5f, boxes);
+            times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::nth_element(times.begin(), times.begin() + rounds / 2, times.end());
+        const double ms = times[rounds / 2];
+
+        if (median_ms)
+            (*median_ms)[c] = ms;
+        if (c == 0 || ms < best_ms)
+        {
+            best = c;
+            best_ms = ms;
+        }
+    }
+
+    set_scheduling(candidates[best]);
+    return candidates[best];
+}
+
+ncnn::Extractor Detector::create_extractor(DetectContext &ctx) const
+{
+    // first inference of this thread under the current plan
+    if (plan_id != 0 && pinned_plan_id != plan_id)
+        pin_current_thread(true);
+
+    ncnn::Extractor ex = Net->create_extractor();
+    ex.set_blob_allocator(&ctx.blob_allocator);
+    ex.set_workspace_allocator(&ctx.workspace_allocator);
+    if (ctx.num_threads > 0)
+        ex.set_num_threads(ctx.num_threads);
+    return ex;
+}
+
+ncnn::Extractor &Detector::kept_extractor(DetectContext &ctx) const
+{
+    // the extractor copied the net's thread count, which a new plan may have changed
+    if (!ctx.extractor || ctx.extractor_plan != plan_id)
+    {
+        ctx.extractor.reset();
+        ctx.extractor.reset(new ncnn::Extractor(create_extractor(ctx)));
+        ctx.extractor_plan = plan_id;
+        return *ctx.extractor;
+    }
+
+    // the session may have moved to another thread
+    if (plan_id != 0 && pinned_plan_id != plan_id)
+        pin_current_thread(true);
+    return *ctx.extractor;
+}
+
+std::unique_ptr<DetectContext> Detector::acquire_context()
+{
+    std::unique_ptr<DetectContext> ctx;
+    {
+        std::lock_guard<std::mutex> lock(context_mutex);
+        if (!idle_contexts.empty())
+        {
+            ctx = std::move(idle_contexts.back());
+            idle_contexts.pop_back();
+        }
+    }
+    if (!ctx)
+        ctx.reset(new DetectContext());
+    // batch workers narrow it down, a single detect uses the net's setting
+    ctx->num_threads = 0;
+    // timed again by begin_frame(), prewarm() and the like stay out of the stats
+    ctx->times.enabled = false;
+    return ctx;
+}
+
+void Detector::release_context(std::unique_ptr<DetectContext> ctx)
+{
+    std::lock_guard<std::mutex> lock(context_mutex);
+    idle_contexts.push_back(std::move(ctx));
+}
+
+void Detector::postprocess(DetectContext &ctx, float threshold, float nms_threshold, std::vector<BoxInfo> &result) const
+{
+    const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+    ctx.proposals.clear();
+    decode(ctx, threshold);
+    if (ctx.times.enabled)
+        record_stage(ctx, STAGE_DECODE, start, stage_clock_ms());
+    select(ctx, nms_threshold, result);
+}
+
+void Detector::infer_postprocess(DetectContext &ctx, float threshold, float nms_threshold,
+                                 std::vector<BoxInfo> &result) const
+{
+    const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+    if (decode_overlap && infer_decode(ctx, threshold))
+    {
+        // the inference ends where the wait for the last decode began
+        if (ctx.times.enabled)
+            record_stage(ctx, STAGE_INFER, start, stage_clock_ms() - ctx.times.ms[STAGE_DECODE]);
+        select(ctx, nms_threshold, result);
+        return;
+    }
+
+    infer(ctx);
+    if (ctx.times.enabled)
+        record_stage(ctx, STAGE_INFER, start, stage_clock_ms());
+    postprocess(ctx, threshold, nms_threshold, result);
+}
+
+void Detector::select(DetectContext &ctx, float nms_threshold, std::vector<BoxInfo> &result) const
+{
+    const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+    ctx.times.proposals = (int) ctx.proposals.size();
+    // keep the pre_nms_topk best proposals, sorted by score from highest to lowest
+    select_topk_descent(ctx.proposals, pre_nms_topk);
+    const double sorted = ctx.times.enabled ? stage_clock_ms() : 0;
+
+    // apply nms with nms_threshold
+    ctx.nms.run(ctx.proposals, ctx.picked, nms_threshold, false, max_detections);
+    ctx.times.kept = (int) ctx.picked.size();
+    if (ctx.times.enabled)
+    {
+        record_stage(ctx, STAGE_SORT, start, sorted);
+        record_stage(ctx, STAGE_NMS, sorted, stage_clock_ms());
+    }
+
+    const int img_w = ctx.letterbox.img_w;
+    const int img_h = ctx.letterbox.img_h;
+    const int wpad = ctx.letterbox.wpad;
+    const int hpad = ctx.letterbox.hpad;
+    const float scale = ctx.letterbox.scale;
+
+    int count = ctx.picked.size();
+    result.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        result[i] = ctx.proposals[ctx.picked[i]];
+
+        // adjust offset to original unpadded
+        float x0 = (result[i].x1 - (wpad / 2)) / scale;
+        float y0 = (result[i].y1 - (hpad / 2)) / scale;
+        float x1 = (result[i].x1 + result[i].w - (wpad / 2)) / scale;
+        float y1 = (result[i].y1 + result[i].h - (hpad / 2)) / scale;
+
+        // clip
+        x0 = std::max(std::min(x0, (float) (img_w - 1)), 0.f);
+        y0 = std::max(std::min(y0, (float) (img_h - 1)), 0.f);
+        x1 = std::max(std::min(x1, (float) (img_w - 1)), 0.f);
+        y1 = std::max(std::min(y1, (float) (img_h - 1)), 0.f);
+
+        result[i].x1 = x0;
+        result[i].y1 = y0;
+        result[i].w = x1 - x0;
+        result[i].h = y1 - y0;
+    }
+}
+
+void Detector::set_topk(int pre_nms_topk, int max_detections)
+{
+    this->pre_nms_topk = pre_nms_topk;
+    this->max_detections = max_detections;
+}
+
+void Detector::set_stats_enabled(bool enabled, int trace_events)
+{
+    stats.set_enabled(enabled, trace_events);
+}
+
+StatsSnapshot Detector::get_stats() const
+{
+    return stats.snapshot();
+}
+
+void Detector::reset_stats()
+{
+    stats.reset();
+}
+
+bool Detector::write_trace(const char *path) const
+{
+    return stats.write_trace(path);
+}
+
+bool Detector::set_layer_profiling(bool enabled)
+{
+    if (!Net || use_gpu)
+        return false;
+    if (enabled && !layer_profiler.attached() && !layer_profiler.attach(*Net))
+        return false;
+    layer_profiler.set_enabled(enabled);
+    return true;
+}
+
+std::vector<LayerProfile> Detector::layer_profile() const
+{
+    return layer_profiler.profile();
+}
+
+void Detector::reset_layer_profile()
+{
+    layer_profiler.reset();
+}
+
+void Detector::begin_frame(DetectContext &ctx) const
+{
+    const bool enabled = stats.enabled();
+    ctx.times.enabled = enabled;
+    ctx.blob_allocator.set_counting(enabled || ctx.track_memory);
+    ctx.workspace_allocator.set_counting(enabled || ctx.track_memory);
+    if (!enabled)
+        return;
+
+    // allocations made since the last frame, e.g. by prewarm(), are not this frame's
+    uint64_t hits, misses;
+    ctx.blob_allocator.take_counts(hits, misses);
+    ctx.workspace_allocator.take_counts(hits, misses);
+    ctx.times.frame_start = stage_clock_ms();
+}
+
+void Detector::end_frame(DetectContext &ctx) const
+{
+    // stats switched off meanwhile, the frame is left out
+    if (!ctx.times.enabled || !stats.enabled())
+        return;
+
+    record_stage(ctx, STAGE_FRAME, ctx.times.frame_start, stage_clock_ms());
+    uint64_t blob_hits, blob_misses, workspace_hits, workspace_misses;
+    ctx.blob_allocator.take_counts(blob_hits, blob_misses);
+    ctx.workspace_allocator.take_counts(workspace_hits, workspace_misses);
+    stats.record_frame(ctx.times.proposals, ctx.times.kept, blob_hits, blob_misses, workspace_hits, workspace_misses);
+}
+
+void Detector::record_stage(DetectContext &ctx, int stage, double start_ms, double end_ms) const
+{
+    if (!ctx.times.enabled)
+        return;
+
+    ctx.times.ms[stage] = end_ms - start_ms;
+    if (stats.enabled())
+        stats.record_stage(stage, start_ms, end_ms);
+}
+
+void Detector::set_min_stride(int min_stride)
+{
+    this->min_stride = min_stride;
+}
+
+void Detector::set_decode_overlap(bool enabled)
+{
+    decode_overlap = enabled;
+}
+
+DecodeWorker::~DecodeWorker()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void DecodeWorker::begin(const Detector *detector, DetectContext *ctx, float threshold)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->detector = detector;
+        this->ctx = ctx;
+        this->threshold = threshold;
+        pushed.clear();
+        num_done = 0;
+    }
+
+    if (!thread.joinable())
+        thread = std::thread(&DecodeWorker::run, this);
+}
+
+void DecodeWorker::push(int output)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pushed.push_back(output);
+    }
+    cv.notify_one();
+}
+
+void DecodeWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return num_done == pushed.size(); });
+}
+
+void DecodeWorker::run()
+{
+    bool pinned = false;
+    for (;;)
+    {
+        int output;
+        const Detector *owner;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return num_done < pushed.size() || stopping; });
+            if (num_done == pushed.size())
+                return;
+            output = pushed[num_done];
+            owner = detector;
+        }
+
+        // with a scheduling plan, decoding stays off the inference cores
+        if (!pinned)
+        {
+            owner->pin_current_thread(false);
+            pinned = true;
+        }
+
+        std::vector<BoxInfo> &proposals = ctx->head_proposals[output];
+        proposals.clear();
+        owner->decode_head(*ctx, output, threshold, proposals);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_done++;
+        }
+        done_cv.notify_one();
+    }
+}
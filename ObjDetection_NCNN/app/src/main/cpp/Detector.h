@@ -0,0 +1,359 @@
+//
+// Common interface of the detection models
+// detect() is split into preprocess / infer / postprocess stages that only share state through a
+// DetectContext, so a pipeline can keep several frames in different stages at the same time.
+// The net is read-only once loaded: any number of threads may detect on one instance at once,
+// each through its own context and extractor.
+//
+
+#ifndef Detector_H
+#define Detector_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "net.h"
+#include "AdaptiveResolution.h"
+#include "DetectStats.h"
+#include "Common.h"
+#include "LayerProfiler.h"
+#include "CpuTopology.h"
+#include "Preprocess.h"
+#include "PostProcess.h"
+#include "Tiling.h"
+
+class Detector;
+class DetectContext;
+
+// Background thread of a context that decodes head outputs while the net computes the next ones.
+// Outputs are decoded one at a time, in the order they were pushed, each into ctx.head_proposals[i].
+class DecodeWorker {
+public:
+    ~DecodeWorker();
+
+    // Frame start, the thread is started on the first one
+    void begin(const Detector *detector, DetectContext *ctx, float threshold);
+
+    // ctx->outputs[output] is extracted
+    void push(int output);
+
+    // Blocks until every pushed output is decoded
+    void wait();
+
+private:
+    void run();
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable done_cv;
+    const Detector *detector = nullptr;
+    DetectContext *ctx = nullptr;
+    float threshold = 0.f;
+    std::vector<int> pushed;
+    size_t num_done = 0;
+    bool stopping = false;
+};
+
+// Steady clock in milliseconds, for StageTimes
+static inline double stage_clock_ms()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Stage durations of the last frame of a context, in milliseconds. Only measured while enabled: detect() and
+// pipelines turn it on with the detector's stats, the benchmark harness for its own contexts.
+typedef struct StageTimes {
+    bool enabled = false;
+    double frame_start = 0;
+    // indexed by DetectStage
+    double ms[STAGE_COUNT] = {};
+    // per head output, since the previous extract, or since the extractor was created for the first one;
+    // 0 for a skipped head
+    std::vector<double> extract;
+    int proposals = 0;          // decoded, before top-k and NMS
+    int kept = 0;
+} StageTimes;
+
+// Per-frame working set of a detector, reused from frame to frame to keep its buffers
+class DetectContext {
+public:
+    // blob and workspace memory of the extractors run on this context, so contexts on different
+    // threads never share an allocator; declared first, the Mats below are released before them
+    CountingPool<ncnn::UnlockedPoolAllocator> blob_allocator;
+    CountingPool<ncnn::PoolAllocator> workspace_allocator;
+    // threads of the extractor, 0 keeps the net's num_threads
+    int num_threads = 0;
+
+    LetterboxInfo letterbox;
+    // letterbox target the last frame was preprocessed with
+    int target_size = 0;
+    // frame size and ladder generation the allocators were last warmed for
+    int warm_w = 0;
+    int warm_h = 0;
+    int warm_generation = 0;
+    LetterboxPreprocessor preprocessor;
+    ncnn::Mat in_pad;
+    // output blobs in head order, allocated from blob_allocator (unlocked):
+    // they are only released by the next infer() on this context, never by the post-processing thread
+    std::vector<ncnn::Mat> outputs;
+    std::vector<BoxInfo> proposals;
+    std::vector<int> picked;
+    NmsEngine nms;
+    // overlapped decode: proposals of each head output, merged into proposals in head order
+    std::vector<std::vector<BoxInfo>> head_proposals;
+    std::unique_ptr<DecodeWorker> decode_worker;
+    StageTimes times;
+    // StreamSession: infer() reuses one extractor from frame to frame instead of creating one per frame,
+    // and the allocators count bytes whether or not the stats are on
+    bool keep_extractor = false;
+    bool track_memory = false;
+    // declared after the allocators, its blobs go back to them first
+    std::unique_ptr<ncnn::Extractor> extractor;
+    // scheduling plan the kept extractor was created under
+    int extractor_plan = 0;
+};
+
+class Detector {
+public:
+    virtual ~Detector() {}
+
+    // Thread-safe, every concurrent caller borrows a context of its own
+    std::vector<BoxInfo> detect(const ImageBuffer &image, float threshold, float nms_threshold);
+
+    // Camera frame straight from ImageAnalysis, boxes are in the coordinates of the rotated frame
+    std::vector<BoxInfo> detect(const YuvImageBuffer &image, float threshold, float nms_threshold);
+
+    // Same, into a vector the caller keeps between frames: once the context pool and the buffers have
+    // grown to the largest frame seen, a CPU detection makes no heap allocation outside of ncnn's extractor
+    void detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result);
+
+    void detect(const YuvImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result);
+
+    // Offline jobs: images are grouped by letterboxed shape and spread over num_workers extractors,
+    // each with its own context, so input tensors and allocator pools are set up once per worker.
+    // num_workers <= 0 uses one worker per big core. results[i] belongs to images[i].
+    void detect_batch(const std::vector<ImageBuffer> &images, float threshold, float nms_threshold,
+                      std::vector<std::vector<BoxInfo>> &results, int num_workers = 0);
+
+    // High-resolution stills: overlapping tiles (plus the whole image when options.global_pass) go through
+    // detect_batch, boxes are shifted back to the image and merged across the tile seams
+    void detect_tiled(const ImageBuffer &image, float threshold, float nms_threshold, const TileOptions &options,
+                      std::vector<BoxInfo> &result);
+
+    // Changed regions of a still camera: every region is scaled like the full frame would be and grown
+    // to whole strides, so it costs its share of the frame. Boxes are in image coordinates, sorted per
+    // region, regions are not merged with each other.
+    void detect_regions(const ImageBuffer &image, const std::vector<TileRect> &regions, float threshold,
+                        float nms_threshold, std::vector<BoxInfo> &result);
+
+    // Letterbox the image into ctx.in_pad
+    void preprocess(const ImageBuffer &image, DetectContext &ctx) const;
+
+    // Same with the longer side scaled to letterbox_size instead of the current target
+    void preprocess(const ImageBuffer &image, DetectContext &ctx, int letterbox_size) const;
+
+    void preprocess(const YuvImageBuffer &image, DetectContext &ctx) const;
+
+    void preprocess(const YuvImageBuffer &image, DetectContext &ctx, int letterbox_size) const;
+
+    // Run the network on ctx.in_pad into ctx.outputs, the only stage that touches the net
+    virtual void infer(DetectContext &ctx) const = 0;
+
+    // Decode, select and suppress, boxes are mapped back to the image coordinates
+    void postprocess(DetectContext &ctx, float threshold, float nms_threshold, std::vector<BoxInfo> &result) const;
+
+    // infer() and postprocess() on the calling thread; a model with several head outputs decodes each one on
+    // the context's DecodeWorker while the net computes the next, with the same boxes as the two stages
+    void infer_postprocess(DetectContext &ctx, float threshold, float nms_threshold, std::vector<BoxInfo> &result) const;
+
+    // Proposals of head output i alone, appended to proposals; called by the DecodeWorker
+    virtual void decode_head(const DetectContext &ctx, int i, float threshold, std::vector<BoxInfo> &proposals) const {}
+
+    // pre_nms_topk caps the proposals handed to NMS, max_detections caps the result, <= 0 disables either
+    // Part of the setup, call it before the detector is shared between threads
+    void set_topk(int pre_nms_topk, int max_detections);
+
+    // Heads with a stride below min_stride are not extracted nor decoded, e.g. 16 drops the stride-8 head when
+    // only large objects matter; the coarsest head always runs. 0 keeps every head. Part of the setup.
+    void set_min_stride(int min_stride);
+
+    // Overlapped decode in infer_postprocess(), on by default. Part of the setup.
+    void set_decode_overlap(bool enabled);
+
+    bool uses_gpu() const { return use_gpu; }
+
+    // Adaptive mode: detect() and pipelines time every frame and move the letterbox target along
+    // options.ladder to stay within options.target_ms. target_ms <= 0 goes back to the fixed target_size.
+    void set_adaptive(const AdaptiveOptions &options);
+
+    // Letterbox target the next frame gets
+    int current_target_size() const;
+
+    // Run a blank frame of img_w x img_h at every ladder size through ctx, so its pool allocators hold
+    // blocks for each resolution before the controller switches to it. Nothing to do outside adaptive mode,
+    // and only done again when the frame size or the ladder changes.
+    void warm_up(DetectContext &ctx, int img_w, int img_h) const;
+
+    // Same for the contexts of detect(), e.g. before the camera starts
+    void warm_up(int img_w, int img_h);
+
+    // One blank img_w x img_h frame through detect(), so the first real frame does not pay for paging in
+    // mapped weights, starting the OpenMP threads, growing the pools or the first GPU submission
+    void prewarm(int img_w, int img_h);
+
+    // Per-frame latency for the adaptive mode, a pipeline reports its slowest stage
+    void record_latency(const DetectContext &ctx, double ms);
+
+    // Inference threads on the plan's clusters: every thread running infer() pins itself and its OpenMP team
+    // there on its first frame after the change. Part of the setup, like set_topk.
+    void set_scheduling(const SchedulingPlan &plan);
+
+    const SchedulingPlan &scheduling() const { return plan; }
+
+    // Pins the calling thread to the plan's inference cores (with its OpenMP team) or to the cores left
+    // for pre/post-processing; false when there is no plan, or it leaves the auxiliary threads alone
+    bool pin_current_thread(bool inference) const;
+
+    // Runtime statistics (DetectStats.h), off by default and cheap enough to leave on in production; they can be
+    // switched while other threads detect. trace_events > 0 also keeps that many stage events for write_trace().
+    void set_stats_enabled(bool enabled, int trace_events = 0);
+
+    StatsSnapshot get_stats() const;
+
+    void reset_stats();
+
+    // Chrome trace / Perfetto JSON of the last stage events
+    bool write_trace(const char *path) const;
+
+    // For callers running the stages themselves, like DetectPipeline: begin_frame() before preprocess() turns
+    // the timing of ctx on while the stats are, end_frame() after postprocess() adds the frame to them
+    void begin_frame(DetectContext &ctx) const;
+
+    void end_frame(DetectContext &ctx) const;
+
+    // Duration of one stage of ctx's frame, start and end from stage_clock_ms(); nothing when its timing is off
+    void record_stage(DetectContext &ctx, int stage, double start_ms, double end_ms) const;
+
+    // Forward time, output shape and size of every layer of the net (LayerProfiler.h), summed over the frames
+    // detected while it is on. The first enable wraps the layers of the net, so it is part of the setup;
+    // after that it can be switched while other threads detect. False on the GPU or without a net.
+    bool set_layer_profiling(bool enabled);
+
+    // Layers that ran, slowest in total first
+    std::vector<LayerProfile> layer_profile() const;
+
+    void reset_layer_profile();
+
+    // Times every candidate_plans() configuration on a synthetic img_w x img_h frame, median of rounds
+    // detections each, and keeps the fastest; median_ms gets the time of each candidate.
+    // Part of the setup: nothing else may detect on this instance meanwhile.
+    SchedulingPlan autotune_scheduling(int img_w, int img_h, int rounds = 8, std::vector<double> *median_ms = 0);
+
+protected:
+    // Extractor using the allocators and thread count of ctx
+    ncnn::Extractor create_extractor(DetectContext &ctx) const;
+
+    // Calls run with the extractor of this frame of ctx: a new one, or the one ctx keeps from frame to frame
+    template<typename Run>
+    void run_extractor(DetectContext &ctx, Run run) const
+    {
+        if (ctx.keep_extractor)
+        {
+            ncnn::Extractor &ex = kept_extractor(ctx);
+            run(ex);
+            // the extractor lets go of the input and the intermediate blobs, so the next frame fills in_pad
+            // in place and finds the blocks back in the pool; the outputs stay in ctx.outputs
+            ex.clear();
+            return;
+        }
+        ncnn::Extractor ex = create_extractor(ctx);
+        run(ex);
+    }
+
+    ncnn::Extractor &kept_extractor(DetectContext &ctx) const;
+
+    // Idle context from the pool, or a new one; give it back with release_context
+    std::unique_ptr<DetectContext> acquire_context();
+
+    void release_context(std::unique_ptr<DetectContext> ctx);
+
+    // Append the proposals of every output blob to ctx.proposals, in letterboxed input coordinates
+    virtual void decode(DetectContext &ctx, float threshold) const = 0;
+
+    // Overlapped variant of infer() + decode(): false when the model has no separate head outputs to overlap
+    virtual bool infer_decode(DetectContext &ctx, float threshold) const { return false; }
+
+    // For infer_decode(): extract(i) runs the net up to head output i on the calling thread, for every
+    // ctx.outputs[i] in order, and returns false for a head it skips; the outputs already extracted are
+    // decoded on the context's DecodeWorker meanwhile. ctx.proposals ends up as decode() would have left it.
+    template<typename Extract>
+    void infer_heads(DetectContext &ctx, float threshold, Extract extract) const
+    {
+        if (!ctx.decode_worker)
+            ctx.decode_worker.reset(new DecodeWorker());
+        const int n = (int) ctx.outputs.size();
+        ctx.head_proposals.resize(n);
+
+        ctx.decode_worker->begin(this, &ctx, threshold);
+        for (int i = 0; i < n; i++)
+        {
+            if (extract(i))
+                ctx.decode_worker->push(i);
+            else
+                ctx.head_proposals[i].clear();
+        }
+        const double start = ctx.times.enabled ? stage_clock_ms() : 0;
+        ctx.decode_worker->wait();
+
+        ctx.proposals.clear();
+        for (int i = 0; i < n; i++)
+            ctx.proposals.insert(ctx.proposals.end(), ctx.head_proposals[i].begin(), ctx.head_proposals[i].end());
+        if (ctx.times.enabled)
+            record_stage(ctx, STAGE_DECODE, start, stage_clock_ms());
+    }
+
+    // input settings, filled in by the model constructors
+    int target_size = 640;
+    int max_stride = 64;
+    bool to_bgr = false;
+    float pad_value = 0.f;
+    float mean_vals[3] = {0.f, 0.f, 0.f};
+    float norm_vals[3] = {1.f, 1.f, 1.f};
+
+    int pre_nms_topk = 1000;
+    int max_detections = 0;
+    int min_stride = 0;
+    bool decode_overlap = true;
+
+    ncnn::Net *Net = nullptr;
+    // vulkan compute was requested and a device is there
+    bool use_gpu = false;
+
+    AdaptiveResolution adaptive;
+    // the const stages record into it
+    mutable DetectStats stats;
+    // destroyed after the net, which owns its layer wrappers
+    LayerProfiler layer_profiler;
+
+private:
+    // Top-k, NMS and the mapping back to the image, on the proposals decode() left in ctx
+    void select(DetectContext &ctx, float nms_threshold, std::vector<BoxInfo> &result) const;
+
+    // scheduling plan and its cores; plan_id is unique across detectors and plans, 0 without a plan
+    SchedulingPlan plan;
+    ncnn::CpuSet infer_cpus;
+    ncnn::CpuSet aux_cpus;
+    int plan_id = 0;
+    // net threads before the first plan, restored by a plan that keeps the default
+    int default_threads = -1;
+
+    // contexts of detect() and detect_batch() callers, kept between calls; a pipeline brings its own
+    std::mutex context_mutex;
+    std::vector<std::unique_ptr<DetectContext>> idle_contexts;
+};
+
+#endif //Detector_H
@@ -0,0 +1,59 @@
+//
+// Named detector instances shared by every caller of the process
+//
+
+#include "DetectorRegistry.h"
+
+std::shared_ptr<Detector> DetectorRegistry::get(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = detectors.find(name);
+    if (it == detectors.end())
+        return nullptr;
+    return it->second;
+}
+
+std::shared_ptr<Detector> DetectorRegistry::put(const std::string &name, std::shared_ptr<Detector> detector)
+{
+    std::shared_ptr<Detector> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<Detector> &entry = detectors[name];
+        old.swap(entry);
+        entry = std::move(detector);
+    }
+    // the caller decides where the old net is released, never under the lock
+    return old;
+}
+
+std::shared_ptr<Detector> DetectorRegistry::remove(const std::string &name)
+{
+    std::shared_ptr<Detector> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = detectors.find(name);
+        if (it == detectors.end())
+            return nullptr;
+        old.swap(it->second);
+        detectors.erase(it);
+    }
+    return old;
+}
+
+void DetectorRegistry::clear()
+{
+    std::map<std::string, std::shared_ptr<Detector>> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        old.swap(detectors);
+    }
+}
+
+std::vector<std::string> DetectorRegistry::names() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> result;
+    for (const auto &entry : detectors)
+        result.push_back(entry.first);
+    return result;
+}
@@ -0,0 +1,37 @@
+//
+// Named detector instances shared by every caller of the process
+// Each entry is an independently configured model (own net, options and context pool). Callers take a
+// shared_ptr snapshot and detect outside the lock, so replacing an entry never waits for detections:
+// the ones in flight finish on the old net, which is freed when the last of them lets go of it.
+//
+
+#ifndef DetectorRegistry_H
+#define DetectorRegistry_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Detector.h"
+
+class DetectorRegistry {
+public:
+    // Detector registered under name, null when there is none
+    std::shared_ptr<Detector> get(const std::string &name) const;
+
+    // Register or hot-swap, returns the detector that was replaced
+    std::shared_ptr<Detector> put(const std::string &name, std::shared_ptr<Detector> detector);
+
+    std::shared_ptr<Detector> remove(const std::string &name);
+
+    void clear();
+
+    std::vector<std::string> names() const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, std::shared_ptr<Detector>> detectors;
+};
+
+#endif //DetectorRegistry_H
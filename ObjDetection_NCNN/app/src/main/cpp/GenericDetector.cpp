@@ -0,0 +1,269 @@
+//
+// Detector driven by a ModelConfig
+//
+
+#include "GenericDetector.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "cpu.h"
+#include "datareader.h"
+
+// Milliseconds since last, which moves on to now
+static double lap(double &last)
+{
+    const double now = stage_clock_ms();
+    const double ms = now - last;
+    last = now;
+    return ms;
+}
+
+// ncnn2mem writes <name>.param.bin
+static bool is_binary_param(const char *path)
+{
+    const size_t n = strlen(path);
+    return n >= 4 && strcmp(path + n - 4, ".bin") == 0;
+}
+
+// Index of a config blob: looked up by name in a text param, a binary one has no names and the config
+// gives the index from ncnn2mem's id.h instead
+static int find_blob(const ncnn::Net &net, const std::string &name, bool binary_param)
+{
+    const std::vector<ncnn::Blob> &blobs = net.blobs();
+    if (binary_param)
+    {
+        char *end = nullptr;
+        const long index = strtol(name.c_str(), &end, 10);
+        if (name.empty() || *end != 0 || index < 0 || index >= (long) blobs.size())
+            return -1;
+        return (int) index;
+    }
+
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        if (blobs[i].name == name)
+            return (int) i;
+    }
+    return -1;
+}
+
+GenericDetector::GenericDetector(const ModelConfig &config, const char *param, const char *bin, bool useGPU,
+                                 int threads_number) {
+
+    init_option(config, useGPU, threads_number);
+
+    MappedFile param_file;
+    if (!param_file.open(param))
+        error = LOAD_PARAM_MISSING;
+    else if (!weights.open(bin))
+        error = LOAD_MODEL_MISSING;
+    else
+        error = load(param_file, is_binary_param(param));
+}
+
+#ifdef __ANDROID__
+GenericDetector::GenericDetector(AAssetManager *mgr, const ModelConfig &config, const char *param, const char *bin,
+                                 bool useGPU, int threads_number, const char *cache_dir) {
+
+    init_option(config, useGPU, threads_number);
+
+    // the param is small and parsed once, only the weights are worth a cached copy
+    MappedFile param_file;
+    if (!param_file.open(mgr, param, nullptr))
+        error = LOAD_PARAM_MISSING;
+    else if (!weights.open(mgr, bin, cache_dir))
+        error = LOAD_MODEL_MISSING;
+    else
+        error = load(param_file, is_binary_param(param));
+}
+#endif
+
+int GenericDetector::load(const MappedFile &param_file, bool binary_param) {
+
+    if (binary_param)
+    {
+        const unsigned char *mem = param_file.data();
+        ncnn::DataReaderFromMemory reader(mem);
+        if (this->Net->load_param_bin(reader))
+            return LOAD_PARAM_INVALID;
+    }
+    else
+    {
+        // load_param_mem wants a terminated string, the mapping is not
+        std::string text((const char *) param_file.data(), param_file.size());
+        if (this->Net->load_param_mem(text.c_str()))
+            return LOAD_PARAM_INVALID;
+    }
+
+    // zero-copy: weights that need no conversion keep pointing into the mapping
+    const unsigned char *mem = weights.data();
+    ncnn::DataReaderFromMemory reader(mem);
+    if (this->Net->load_model(reader))
+        return LOAD_MODEL_INVALID;
+
+    input_index = find_blob(*this->Net, config.input_blob, binary_param);
+    if (input_index < 0)
+        return LOAD_BLOB_NOT_FOUND;
+    output_indexes.resize(config.outputs.size());
+    for (size_t i = 0; i < config.outputs.size(); i++)
+    {
+        output_indexes[i] = find_blob(*this->Net, config.outputs[i].blob, binary_param);
+        if (output_indexes[i] < 0)
+            return LOAD_BLOB_NOT_FOUND;
+    }
+    return LOAD_OK;
+}
+
+void GenericDetector::init_option(const ModelConfig &config, bool useGPU, int threads_number) {
+
+    this->config = config;
+    target_size = config.target_size;
+    max_stride = config.max_stride;
+    to_bgr = config.to_bgr;
+    pad_value = config.pad_value;
+    for (int c = 0; c < 3; c++)
+    {
+        mean_vals[c] = config.mean_vals[c];
+        norm_vals[c] = config.norm_vals[c];
+    }
+
+    // the Mats point into this->config, which stays put for the lifetime of the detector
+    anchors.resize(this->config.outputs.size());
+    for (size_t i = 0; i < this->config.outputs.size(); i++)
+    {
+        std::vector<float> &output_anchors = this->config.outputs[i].anchors;
+        if (!output_anchors.empty())
+            anchors[i] = ncnn::Mat((int) output_anchors.size(), output_anchors.data());
+    }
+    for (const HeadOutput &output : this->config.outputs)
+        coarsest_stride = std::max(coarsest_stride, output.stride);
+    if (config.head == HEAD_YOLO)
+        yolo_decoder = select_yolov5_decoder(config.num_class);
+    else
+        gfl_decoder = select_nanodet_decoder(config.num_class);
+
+    Net = new ncnn::Net();
+#if NCNN_VULKAN
+    // ncnn's vulkan layers have no int8 path, a quantized net stays on the CPU
+    use_gpu = useGPU && ncnn::get_gpu_count() > 0 && config.precision != PRECISION_INT8;
+#else
+    use_gpu = false;
+#endif
+    // opt 需要在加载前设置
+    if (use_gpu) {
+        // enable vulkan compute
+        this->Net->opt.use_vulkan_compute = true;
+        // turn on for adreno
+        this->Net->opt.use_image_storage = true;
+        this->Net->opt.use_tensor_storage = true;
+    }
+    if (config.precision == PRECISION_INT8) {
+        // quantized convolutions read int8 weights, the layers around them stay in fp32
+        this->Net->opt.use_int8_inference = true;
+        this->Net->opt.use_int8_packed = true;
+        this->Net->opt.use_int8_storage = true;
+    } else if (config.precision == PRECISION_FP32) {
+        // reference precision for accuracy comparisons
+        this->Net->opt.use_fp16_packed = false;
+        this->Net->opt.use_fp16_storage = false;
+        this->Net->opt.use_fp16_arithmetic = false;
+    } else {
+        // enable bf16 data type for storage
+        // improve most operator performance on all arm devices, may consume more memory
+        this->Net->opt.use_bf16_storage = true;
+    }
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(threads_number);
+    if(threads_number)
+        this->Net->opt.num_threads = threads_number;
+//  this number is automatically set to the number of all big cores (details in NCNN option.h).
+//  However, for some SOC with 3 different architectures
+//  (e.g. Snapdragon 8 Gen 1, Kryo 1*Cortex-X2 @3.0 GHz + 3*Cortex-A710 @2.5GHz + 4*Cortex-A510 @1.8GHz),
+//  and some small models such as NanoDet-Plus,
+//  it may be much better to set this number to the number of super large cores,
+//  for Snapdragon 8 Gen 1, the best number is 1.
+}
+
+GenericDetector::~GenericDetector() {
+    Net->clear();
+    delete Net;
+}
+
+void GenericDetector::infer(DetectContext &ctx) const {
+    double last = ctx.times.enabled ? stage_clock_ms() : 0;
+    run_extractor(ctx, [this, &ctx, &last](ncnn::Extractor &ex) {
+        ex.input(input_index, ctx.in_pad);
+
+        // ncnn only computes the layers an extracted blob depends on, a skipped head costs nothing
+        ctx.outputs.resize(config.outputs.size());
+        ctx.times.extract.resize(config.outputs.size());
+        for (size_t i = 0; i < config.outputs.size(); i++)
+        {
+            if (skip_head((int) i))
+                ctx.outputs[i].release();
+            else
+                ex.extract(output_indexes[i], ctx.outputs[i]);
+            if (ctx.times.enabled)
+                ctx.times.extract[i] = lap(last);
+        }
+    });
+}
+
+bool GenericDetector::infer_decode(DetectContext &ctx, float threshold) const {
+    // a single output leaves nothing to overlap
+    if (config.outputs.size() < 2)
+        return false;
+
+    double last = ctx.times.enabled ? stage_clock_ms() : 0;
+    run_extractor(ctx, [this, &ctx, &last, threshold](ncnn::Extractor &ex) {
+        ex.input(input_index, ctx.in_pad);
+
+        // in head order, e.g. YOLOv5's stride-8 output is ready before the bottom-up path computes the others
+        ctx.outputs.resize(config.outputs.size());
+        ctx.times.extract.resize(config.outputs.size());
+        infer_heads(ctx, threshold, [this, &ex, &ctx, &last](int i) {
+            const bool skipped = skip_head(i);
+            if (skipped)
+                ctx.outputs[i].release();
+            else
+                ex.extract(output_indexes[i], ctx.outputs[i]);
+            if (ctx.times.enabled)
+                ctx.times.extract[i] = lap(last);
+            return !skipped;
+        });
+    });
+    return true;
+}
+
+bool GenericDetector::skip_head(int i) const {
+    const int stride = config.outputs[i].stride;
+    return stride < min_stride && stride < coarsest_stride;
+}
+
+void GenericDetector::decode(DetectContext &ctx, float threshold) const {
+    for (size_t i = 0; i < config.outputs.size(); i++)
+    {
+        if (!skip_head((int) i))
+            decode_head(ctx, (int) i, threshold, ctx.proposals);
+    }
+}
+
+void GenericDetector::decode_head(const DetectContext &ctx, int i, float threshold, std::vector<BoxInfo> &proposals) const {
+    const ncnn::Mat &blob = ctx.outputs[i];
+    const int stride = config.outputs[i].stride;
+
+    if (config.head == HEAD_YOLO)
+    {
+        // the specialized decoder trusts num_class, a blob that disagrees takes the generic path
+        if (blob.c == anchors[i].w / 2 * (config.num_class + 5))
+            yolo_decoder(anchors[i], stride, blob, threshold, proposals);
+        else
+            generate_proposals_yolov5(anchors[i], stride, blob, threshold, proposals);
+    }
+    else
+    {
+        gfl_decoder(blob, stride, config.num_class, threshold, proposals);
+    }
+}
@@ -0,0 +1,67 @@
+//
+// Detector driven by a ModelConfig: anchor-based YOLO and anchor-free GFL heads
+// The decoder of every output is chosen once, specialized for the class count when it is a common one
+//
+
+#ifndef GenericDetector_H
+#define GenericDetector_H
+
+#include "net.h"
+#include "Decoder.h"
+#include "Detector.h"
+#include "ModelConfig.h"
+#include "ModelFile.h"
+
+// param is a text .param, or a binary .param.bin from ncnn2mem whose blobs the config names by index.
+// The weights stay mapped and the net points into them. A failed load is reported by load_error(),
+// the detector must not be used then.
+class GenericDetector : public Detector {
+public:
+    GenericDetector(const ModelConfig &config, const char *param, const char *bin, bool useGPU, int threads_number);
+#ifdef __ANDROID__
+    // cache_dir keeps an inflated copy of a compressed weight asset, see MappedFile
+    GenericDetector(AAssetManager *mgr, const ModelConfig &config, const char *param, const char *bin, bool useGPU,
+                    int threads_number, const char *cache_dir = nullptr);
+#endif
+
+    ~GenericDetector();
+
+    void infer(DetectContext &ctx) const override;
+
+    void decode_head(const DetectContext &ctx, int i, float threshold, std::vector<BoxInfo> &proposals) const override;
+
+    const ModelConfig &model_config() const { return config; }
+
+    // LOAD_OK, or the LoadError that stopped the constructor
+    int load_error() const { return error; }
+
+protected:
+    void decode(DetectContext &ctx, float threshold) const override;
+
+    bool infer_decode(DetectContext &ctx, float threshold) const override;
+
+private:
+    void init_option(const ModelConfig &config, bool useGPU, int threads_number);
+
+    // Param from param_file, weights from this->weights, then the blob indexes
+    int load(const MappedFile &param_file, bool binary_param);
+
+    // Head i is left out by set_min_stride
+    bool skip_head(int i) const;
+
+    ModelConfig config;
+    int error = LOAD_OK;
+    // the net's weights point into it, released after the net
+    MappedFile weights;
+    // blobs of the config resolved once, so frames skip the lookup by name
+    int input_index = -1;
+    std::vector<int> output_indexes;
+    // largest head stride, never skipped
+    int coarsest_stride = 0;
+    // per output, wraps config.outputs[i].anchors
+    std::vector<ncnn::Mat> anchors;
+    YoloDecoder yolo_decoder = nullptr;
+    GflDecoder gfl_decoder = nullptr;
+};
+
+#endif //GenericDetector_H
@@ -0,0 +1,272 @@
+//
+// Per-layer timing of an ncnn net on the CPU
+//
+
+#include "LayerProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+// Stands in for a layer of the net: same flags, blobs and shapes, so the net converts and feeds it like the
+// original, and forwards every call to it
+class ProfiledLayer : public ncnn::Layer {
+public:
+    ProfiledLayer(ncnn::Layer *inner, const std::atomic<bool> &on, LayerProfiler::LayerCounters &counters)
+        : inner(inner), on(on), counters(counters)
+    {
+        one_blob_only = inner->one_blob_only;
+        support_inplace = inner->support_inplace;
+        support_vulkan = false;
+        support_packing = inner->support_packing;
+        support_bf16_storage = inner->support_bf16_storage;
+        support_fp16_storage = inner->support_fp16_storage;
+        support_int8_storage = inner->support_int8_storage;
+        support_image_storage = inner->support_image_storage;
+        support_tensor_storage = inner->support_tensor_storage;
+        featmask = inner->featmask;
+        userdata = inner->userdata;
+        typeindex = inner->typeindex;
+        type = inner->type;
+        name = inner->name;
+        bottoms = inner->bottoms;
+        tops = inner->tops;
+        bottom_shapes = inner->bottom_shapes;
+        top_shapes = inner->top_shapes;
+    }
+
+    ~ProfiledLayer() override
+    {
+        delete inner;
+    }
+
+    int create_pipeline(const ncnn::Option &opt) override
+    {
+        return inner->create_pipeline(opt);
+    }
+
+    int destroy_pipeline(const ncnn::Option &opt) override
+    {
+        return inner->destroy_pipeline(opt);
+    }
+
+    int forward(const std::vector<ncnn::Mat> &bottom_blobs, std::vector<ncnn::Mat> &top_blobs,
+                const ncnn::Option &opt) const override
+    {
+        if (!on.load(std::memory_order_relaxed))
+            return inner->forward(bottom_blobs, top_blobs, opt);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int ret = inner->forward(bottom_blobs, top_blobs, opt);
+        record(start, top_blobs.empty() ? ncnn::Mat() : top_blobs[0], blobs_bytes(top_blobs));
+        return ret;
+    }
+
+    int forward(const ncnn::Mat &bottom_blob, ncnn::Mat &top_blob, const ncnn::Option &opt) const override
+    {
+        if (!on.load(std::memory_order_relaxed))
+            return inner->forward(bottom_blob, top_blob, opt);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int ret = inner->forward(bottom_blob, top_blob, opt);
+        record(start, top_blob, blob_bytes(top_blob));
+        return ret;
+    }
+
+    int forward_inplace(std::vector<ncnn::Mat> &bottom_top_blobs, const ncnn::Option &opt) const override
+    {
+        if (!on.load(std::memory_order_relaxed))
+            return inner->forward_inplace(bottom_top_blobs, opt);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int ret = inner->forward_inplace(bottom_top_blobs, opt);
+        record(start, bottom_top_blobs.empty() ? ncnn::Mat() : bottom_top_blobs[0], blobs_bytes(bottom_top_blobs));
+        return ret;
+    }
+
+    int forward_inplace(ncnn::Mat &bottom_top_blob, const ncnn::Option &opt) const override
+    {
+        if (!on.load(std::memory_order_relaxed))
+            return inner->forward_inplace(bottom_top_blob, opt);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int ret = inner->forward_inplace(bottom_top_blob, opt);
+        record(start, bottom_top_blob, blob_bytes(bottom_top_blob));
+        return ret;
+    }
+
+private:
+    static size_t blob_bytes(const ncnn::Mat &blob)
+    {
+        return blob.total() * blob.elemsize;
+    }
+
+    static size_t blobs_bytes(const std::vector<ncnn::Mat> &blobs)
+    {
+        size_t bytes = 0;
+        for (const ncnn::Mat &blob : blobs)
+            bytes += blob_bytes(blob);
+        return bytes;
+    }
+
+    void record(std::chrono::steady_clock::time_point start, const ncnn::Mat &top, size_t bytes) const
+    {
+        const uint64_t ns = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        counters.count.fetch_add(1, std::memory_order_relaxed);
+        counters.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t current = counters.max_ns.load(std::memory_order_relaxed);
+        while (ns > current && !counters.max_ns.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+        {
+        }
+
+        const int pack = std::max(top.elempack, 1);
+        counters.w.store(top.w, std::memory_order_relaxed);
+        counters.h.store(top.h, std::memory_order_relaxed);
+        counters.c.store(top.c * pack, std::memory_order_relaxed);
+        counters.bytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    ncnn::Layer *inner;
+    const std::atomic<bool> &on;
+    LayerProfiler::LayerCounters &counters;
+};
+
+bool LayerProfiler::attach(ncnn::Net &net)
+{
+    // the wrappers only forward the CPU entry points
+    if (net.opt.use_vulkan_compute)
+        return false;
+    return attach(net.mutable_layers());
+}
+
+bool LayerProfiler::attach(std::vector<ncnn::Layer *> &layers)
+{
+    if (attached() || layers.empty())
+        return false;
+
+    num_layers = (int) layers.size();
+    counters.reset(new LayerCounters[num_layers]);
+    names.resize(num_layers);
+    types.resize(num_layers);
+    for (int i = 0; i < num_layers; i++)
+    {
+        if (!layers[i])
+            continue;
+        names[i] = layers[i]->name;
+        types[i] = layers[i]->type;
+        layers[i] = new ProfiledLayer(layers[i], on, counters[i]);
+    }
+    return true;
+}
+
+void LayerProfiler::reset()
+{
+    for (int i = 0; i < num_layers; i++)
+    {
+        LayerCounters &layer = counters[i];
+        layer.count.store(0, std::memory_order_relaxed);
+        layer.total_ns.store(0, std::memory_order_relaxed);
+        layer.max_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::vector<LayerProfile> LayerProfiler::profile() const
+{
+    std::vector<LayerProfile> layers;
+    for (int i = 0; i < num_layers; i++)
+    {
+        const LayerCounters &counter = counters[i];
+        LayerProfile layer;
+        layer.count = counter.count.load(std::memory_order_relaxed);
+        if (layer.count == 0)
+            continue;
+
+        layer.index = i;
+        layer.name = names[i];
+        layer.type = types[i];
+        layer.total_ms = counter.total_ns.load(std::memory_order_relaxed) / 1e6;
+        layer.mean_ms = layer.total_ms / layer.count;
+        layer.max_ms = counter.max_ns.load(std::memory_order_relaxed) / 1e6;
+        layer.w = counter.w.load(std::memory_order_relaxed);
+        layer.h = counter.h.load(std::memory_order_relaxed);
+        layer.c = counter.c.load(std::memory_order_relaxed);
+        layer.bytes = (size_t) counter.bytes.load(std::memory_order_relaxed);
+        layers.push_back(layer);
+    }
+
+    std::stable_sort(layers.begin(), layers.end(),
+                     [](const LayerProfile &a, const LayerProfile &b) { return a.total_ms > b.total_ms; });
+    return layers;
+}
+
+std::string format_layer_report(const std::vector<LayerProfile> &profile, int max_rows)
+{
+    double total_ms = 0;
+    size_t peak_bytes = 0;
+    for (const LayerProfile &layer : profile)
+    {
+        total_ms += layer.total_ms;
+        peak_bytes = std::max(peak_bytes, layer.bytes);
+    }
+
+    std::string report;
+    char line[256];
+    snprintf(line, sizeof(line), "%-5s %-24s %-24s %9s %9s %6s %6s  %-18s %9s\n", "index", "name", "type", "mean ms",
+             "max ms", "%", "cum %", "output", "KiB");
+    report += line;
+    double cumulative = 0;
+    const int rows = max_rows > 0 ? std::min(max_rows, (int) profile.size()) : (int) profile.size();
+    for (int r = 0; r < rows; r++)
+    {
+        const LayerProfile &layer = profile[r];
+        cumulative += layer.total_ms;
+        char shape[48];
+        snprintf(shape, sizeof(shape), "%dx%dx%d", layer.w, layer.h, layer.c);
+        snprintf(line, sizeof(line), "%-5d %-24.24s %-24.24s %9.3f %9.3f %6.1f %6.1f  %-18s %9.1f\n", layer.index,
+                 layer.name.c_str(), layer.type.c_str(), layer.mean_ms, layer.max_ms,
+                 total_ms > 0 ? 100 * layer.total_ms / total_ms : 0.0, total_ms > 0 ? 100 * cumulative / total_ms : 0.0,
+                 shape, layer.bytes / 1024.0);
+        report += line;
+    }
+
+    // where the time goes by kind of layer, like the widest frames of a flame graph
+    std::map<std::string, std::pair<double, int>> by_type;
+    for (const LayerProfile &layer : profile)
+    {
+        by_type[layer.type].first += layer.total_ms;
+        by_type[layer.type].second++;
+    }
+    std::vector<std::pair<std::string, std::pair<double, int>>> types(by_type.begin(), by_type.end());
+    std::stable_sort(types.begin(), types.end(),
+                     [](const std::pair<std::string, std::pair<double, int>> &a,
+                        const std::pair<std::string, std::pair<double, int>> &b) { return a.second.first > b.second.first; });
+
+    snprintf(line, sizeof(line), "\n%-24s %6s %10s %6s\n", "type", "layers", "total ms", "%");
+    report += line;
+    for (const auto &type : types)
+    {
+        snprintf(line, sizeof(line), "%-24.24s %6d %10.3f %6.1f\n", type.first.c_str(), type.second.second,
+                 type.second.first, total_ms > 0 ? 100 * type.second.first / total_ms : 0.0);
+        report += line;
+    }
+    snprintf(line, sizeof(line), "%-24s %6d %10.3f, largest output %.1f KiB\n", "all", (int) profile.size(), total_ms,
+             peak_bytes / 1024.0);
+    report += line;
+    return report;
+}
+
+std::string format_folded_stacks(const std::vector<LayerProfile> &profile, const std::string &root)
+{
+    std::string folded;
+    for (const LayerProfile &layer : profile)
+    {
+        // flame graph tools split frames on ';' and the count on the last space
+        std::string name = layer.name;
+        std::replace(name.begin(), name.end(), ';', '_');
+        std::replace(name.begin(), name.end(), ' ', '_');
+        folded += root + ";" + layer.type + ";" + name + " " + std::to_string((long long) (layer.total_ms * 1000 + 0.5)) + "\n";
+    }
+    return folded;
+}
@@ -0,0 +1,80 @@
+//
+// Per-layer timing of an ncnn net on the CPU
+// ncnn only times layers in NCNN_BENCHMARK builds, which the prebuilt libraries are not. Instead every layer of
+// the loaded net is wrapped in a layer that forwards to it and records its forward time and the shape and size
+// of what it wrote, so the profile works with any ncnn, on a device as well as on the host.
+// Counters are atomic: several extractors may run the net at once.
+//
+
+#ifndef LayerProfiler_H
+#define LayerProfiler_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "layer.h"
+#include "net.h"
+
+typedef struct LayerProfile {
+    int index;                  // position in the .param
+    std::string name;
+    std::string type;
+    uint64_t count;             // forwards timed
+    double total_ms;
+    double mean_ms;
+    double max_ms;
+    // output of the last forward, channels unpacked; the first top blob of a multi-output layer
+    int w;
+    int h;
+    int c;
+    size_t bytes;               // every top blob of the last forward
+} LayerProfile;
+
+class LayerProfiler {
+public:
+    // Wraps every layer of a loaded CPU net, once; not while the net is running, the net owns the wrappers
+    // and this profiler has to outlive them
+    bool attach(ncnn::Net &net);
+
+    // Same on a list of layers, e.g. Net::mutable_layers()
+    bool attach(std::vector<ncnn::Layer *> &layers);
+
+    bool attached() const { return num_layers > 0; }
+
+    // Timing off keeps the wrappers and only costs them a flag check; may change while the net runs
+    void set_enabled(bool enabled) { on.store(enabled, std::memory_order_relaxed); }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    void reset();
+
+    // Layers that ran, slowest in total first
+    std::vector<LayerProfile> profile() const;
+
+    typedef struct LayerCounters {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::atomic<int> w{0};
+        std::atomic<int> h{0};
+        std::atomic<int> c{0};
+        std::atomic<uint64_t> bytes{0};
+    } LayerCounters;
+
+private:
+    std::atomic<bool> on{false};
+    std::unique_ptr<LayerCounters[]> counters;
+    std::vector<std::string> names;
+    std::vector<std::string> types;
+    int num_layers = 0;
+};
+
+// Table of the slowest max_rows layers (all when <= 0) with their share of the total, then the time per layer type
+std::string format_layer_report(const std::vector<LayerProfile> &profile, int max_rows = 0);
+
+// Folded stacks "root;type;name microseconds", one line per layer, for flamegraph.pl or speedscope.app
+std::string format_folded_stacks(const std::vector<LayerProfile> &profile, const std::string &root);
+
+#endif //LayerProfiler_H
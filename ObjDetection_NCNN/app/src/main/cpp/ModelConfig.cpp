@@ -0,0 +1,151 @@
+//
+// Description of a detection model, read from a small sidecar file next to its param / bin
+//
+
+#include "ModelConfig.h"
+
+#include <fstream>
+#include <sstream>
+
+static bool fail(std::string *error, int line, const std::string &message)
+{
+    if (error)
+        *error = "line " + std::to_string(line) + ": " + message;
+    return false;
+}
+
+// every value of the line, false when one is missing or something is left over
+template<typename T>
+static bool read_values(std::istringstream &values, T *out, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!(values >> out[i]))
+            return false;
+    }
+    std::string rest;
+    return !(values >> rest);
+}
+
+bool parse_model_config(const std::string &text, ModelConfig &config, std::string *error)
+{
+    ModelConfig parsed;
+    bool has_head = false;
+
+    std::istringstream lines(text);
+    std::string line;
+    int line_number = 0;
+    while (std::getline(lines, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                return fail(error, line_number, "expected key = value");
+            continue;
+        }
+
+        std::string key;
+        std::istringstream(line.substr(0, eq)) >> key;
+        std::istringstream values(line.substr(eq + 1));
+
+        bool ok;
+        if (key == "head")
+        {
+            std::string head;
+            ok = read_values(values, &head, 1) && (head == "yolo" || head == "gfl");
+            parsed.head = head == "gfl" ? HEAD_GFL : HEAD_YOLO;
+            has_head = true;
+        }
+        else if (key == "input")
+            ok = read_values(values, &parsed.input_blob, 1);
+        else if (key == "target_size")
+            ok = read_values(values, &parsed.target_size, 1) && parsed.target_size > 0;
+        else if (key == "max_stride")
+            ok = read_values(values, &parsed.max_stride, 1) && parsed.max_stride > 0;
+        else if (key == "bgr")
+        {
+            int bgr;
+            ok = read_values(values, &bgr, 1);
+            parsed.to_bgr = bgr != 0;
+        }
+        else if (key == "pad_value")
+            ok = read_values(values, &parsed.pad_value, 1);
+        else if (key == "mean")
+            ok = read_values(values, parsed.mean_vals, 3);
+        else if (key == "norm")
+            ok = read_values(values, parsed.norm_vals, 3);
+        else if (key == "num_class")
+            ok = read_values(values, &parsed.num_class, 1) && parsed.num_class > 0;
+        else if (key == "output")
+        {
+            HeadOutput output;
+            ok = bool(values >> output.blob >> output.stride) && output.stride > 0;
+            float v;
+            while (ok && values >> v)
+                output.anchors.push_back(v);
+            ok = ok && values.eof();
+            parsed.outputs.push_back(output);
+        }
+        else if (key == "precision")
+        {
+            std::string precision;
+            ok = read_values(values, &precision, 1) && (precision == "fp32" || precision == "bf16" || precision == "int8");
+            parsed.precision = precision == "fp32" ? PRECISION_FP32 : precision == "int8" ? PRECISION_INT8 : PRECISION_BF16;
+        }
+        else
+            return fail(error, line_number, "unknown key " + key);
+
+        if (!ok)
+            return fail(error, line_number, "bad value for " + key);
+    }
+
+    if (!has_head)
+        return fail(error, line_number, "no head type");
+    if (parsed.outputs.empty())
+        return fail(error, line_number, "no output");
+    for (const HeadOutput &output : parsed.outputs)
+    {
+        bool anchored = !output.anchors.empty();
+        if (parsed.head == HEAD_YOLO && (!anchored || output.anchors.size() % 2 != 0))
+            return fail(error, line_number, "output " + output.blob + " needs w h anchor pairs");
+        if (parsed.head == HEAD_GFL && anchored)
+            return fail(error, line_number, "output " + output.blob + " of an anchor-free head has anchors");
+    }
+
+    config = parsed;
+    return true;
+}
+
+bool load_model_config(const char *path, ModelConfig &config, std::string *error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        if (error)
+            *error = std::string("cannot open ") + path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse_model_config(text.str(), config, error);
+}
+
+#ifdef __ANDROID__
+bool load_model_config(AAssetManager *mgr, const char *name, ModelConfig &config, std::string *error)
+{
+    AAsset *asset = AAssetManager_open(mgr, name, AASSET_MODE_BUFFER);
+    if (asset == nullptr)
+    {
+        if (error)
+            *error = std::string("no asset ") + name;
+        return false;
+    }
+    std::string text((const char *) AAsset_getBuffer(asset), (size_t) AAsset_getLength(asset));
+    AAsset_close(asset);
+    return parse_model_config(text, config, error);
+}
+#endif
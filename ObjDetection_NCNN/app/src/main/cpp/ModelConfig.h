@@ -0,0 +1,73 @@
+//
+// Description of a detection model, read from a small sidecar file next to its param / bin
+// Everything a Detector needs besides the weights: input size and normalization, head type,
+// output blobs with their strides and anchors, and the class count.
+//
+// Sidecar format, one "key = value" per line, '#' starts a comment:
+//   head = yolo                          # yolo (anchor-based, YOLOv5 style) or gfl (anchor-free GFL / DFL, NanoDet style)
+//   input = in0
+//   target_size = 640                    # longer side after the letterbox resize
+//   max_stride = 64                      # the padded input is a multiple of it
+//   bgr = 0                              # 1 feeds b, g, r planes
+//   pad_value = 114
+//   mean = 0 0 0
+//   norm = 0.003921569 0.003921569 0.003921569
+//   num_class = 80
+//   output = out0 8 10 13 16 30 33 23    # blob, stride, then anchor w h pairs for yolo heads
+//   precision = bf16                     # fp32, bf16 (default) or int8 for a pair quantized with ncnn2int8
+//
+// With a binary <name>.param.bin from ncnn2mem the net has no blob names: input and output then give the
+// blob indexes from the generated id.h instead.
+//
+
+#ifndef ModelConfig_H
+#define ModelConfig_H
+
+#include <string>
+#include <vector>
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+enum HeadType {
+    HEAD_YOLO = 0,
+    HEAD_GFL,
+};
+
+// Storage / arithmetic the net runs with on the CPU
+enum Precision {
+    PRECISION_FP32 = 0,
+    PRECISION_BF16,
+    PRECISION_INT8,             // weights quantized by ncnn2int8 with a table from objdet_calibrate, CPU only
+};
+
+typedef struct HeadOutput {
+    std::string blob;
+    int stride = 0;
+    std::vector<float> anchors;     // w, h pairs in input pixels, empty for anchor-free heads
+} HeadOutput;
+
+typedef struct ModelConfig {
+    HeadType head = HEAD_YOLO;
+    std::string input_blob = "in0";
+    int target_size = 640;
+    int max_stride = 64;
+    bool to_bgr = false;
+    float pad_value = 0.f;
+    float mean_vals[3] = {0.f, 0.f, 0.f};
+    float norm_vals[3] = {1.f, 1.f, 1.f};
+    int num_class = 80;
+    std::vector<HeadOutput> outputs;
+    Precision precision = PRECISION_BF16;
+} ModelConfig;
+
+// Parse the sidecar text into config, false and a reason in error when it is malformed
+bool parse_model_config(const std::string &text, ModelConfig &config, std::string *error = nullptr);
+
+bool load_model_config(const char *path, ModelConfig &config, std::string *error = nullptr);
+
+#ifdef __ANDROID__
+bool load_model_config(AAssetManager *mgr, const char *name, ModelConfig &config, std::string *error = nullptr);
+#endif
+
+#endif //ModelConfig_H
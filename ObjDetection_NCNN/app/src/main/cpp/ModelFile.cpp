@@ -0,0 +1,135 @@
+//
+// Model files mapped into memory and load error codes
+//
+
+#include "ModelFile.h"
+
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char *load_error_string(int error)
+{
+    switch (error)
+    {
+    case LOAD_OK:
+        return "ok";
+    case LOAD_CONFIG_INVALID:
+        return "invalid model config";
+    case LOAD_PARAM_MISSING:
+        return "param file not found";
+    case LOAD_PARAM_INVALID:
+        return "invalid param file";
+    case LOAD_MODEL_MISSING:
+        return "weight file not found";
+    case LOAD_MODEL_INVALID:
+        return "weights do not match the param";
+    case LOAD_BLOB_NOT_FOUND:
+        return "config blob not found in the param";
+    default:
+        return "unknown error";
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    ptr = map;
+    length = (size_t) st.st_size;
+    mapped = true;
+    return true;
+}
+
+#ifdef __ANDROID__
+bool MappedFile::open(AAssetManager *mgr, const char *name, const char *cache_dir)
+{
+    close();
+
+    std::string cache_path;
+    if (cache_dir && cache_dir[0])
+    {
+        cache_path = std::string(cache_dir) + "/" + name;
+        if (open(cache_path.c_str()))
+            return true;
+    }
+
+    AAsset *file = AAssetManager_open(mgr, name, AASSET_MODE_BUFFER);
+    if (!file)
+        return false;
+
+    const void *buffer = AAsset_getBuffer(file);
+    const size_t size = (size_t) AAsset_getLength(file);
+    if (!buffer || size == 0)
+    {
+        AAsset_close(file);
+        return false;
+    }
+
+    // stored uncompressed: the buffer is a mapping of the APK, nothing to cache
+    if (!AAsset_isAllocated(file) || cache_path.empty())
+    {
+        asset = file;
+        ptr = (void *) buffer;
+        length = size;
+        return true;
+    }
+
+    // inflated into the heap, keep a copy for the next launches; written aside and renamed, so a
+    // launch killed halfway never maps a truncated file
+    const std::string tmp_path = cache_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    bool written = fp && fwrite(buffer, 1, size, fp) == size;
+    if (fp)
+        written = fclose(fp) == 0 && written;
+    if (written && rename(tmp_path.c_str(), cache_path.c_str()) == 0 && open(cache_path.c_str()))
+    {
+        AAsset_close(file);
+        return true;
+    }
+    unlink(tmp_path.c_str());
+
+    asset = file;
+    ptr = (void *) buffer;
+    length = size;
+    return true;
+}
+#endif
+
+void MappedFile::close()
+{
+    if (mapped)
+        munmap(ptr, length);
+#ifdef __ANDROID__
+    if (asset)
+        AAsset_close(asset);
+    asset = nullptr;
+#endif
+    ptr = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,64 @@
+//
+// Model files mapped into memory and load error codes
+// ncnn's load_model(const unsigned char *) keeps pointers into the buffer instead of copying the weights,
+// so a mapped .bin costs no heap copy and only the pages the net touches are read from flash.
+// The mapping has to outlive the net.
+//
+
+#ifndef ModelFile_H
+#define ModelFile_H
+
+#include <cstddef>
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+enum LoadError {
+    LOAD_OK = 0,
+    LOAD_CONFIG_INVALID = -1,       // the <name>.cfg sidecar could not be parsed
+    LOAD_PARAM_MISSING = -2,        // neither <name>.param.bin nor <name>.param
+    LOAD_PARAM_INVALID = -3,
+    LOAD_MODEL_MISSING = -4,
+    LOAD_MODEL_INVALID = -5,        // weights do not match the param
+    LOAD_BLOB_NOT_FOUND = -6,       // an input / output of the config is not in the param
+};
+
+const char *load_error_string(int error);
+
+// Read-only file contents, page aligned, valid until close() or destruction
+class MappedFile {
+public:
+    MappedFile() {}
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const char *path);
+
+#ifdef __ANDROID__
+    // Assets stored uncompressed in the APK are mapped in place. A compressed one is inflated once into
+    // cache_dir (when given) and mapped from there on later launches; codeCacheDir is cleared on app updates,
+    // which keeps the copies in step with the APK.
+    bool open(AAssetManager *mgr, const char *name, const char *cache_dir);
+#endif
+
+    void close();
+
+    const unsigned char *data() const { return (const unsigned char *) ptr; }
+
+    size_t size() const { return length; }
+
+private:
+    void *ptr = nullptr;
+    size_t length = 0;
+    // mmap'd by us, otherwise ptr belongs to the asset
+    bool mapped = false;
+#ifdef __ANDROID__
+    AAsset *asset = nullptr;
+#endif
+};
+
+#endif //ModelFile_H
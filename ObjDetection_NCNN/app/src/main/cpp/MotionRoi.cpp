@@ -0,0 +1,276 @@
+//
+// Region-of-interest inference for still cameras
+//
+
+#include "MotionRoi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+BackgroundModel::BackgroundModel(const RoiOptions &options)
+    : options(options)
+{
+}
+
+void BackgroundModel::reset()
+{
+    img_w = 0;
+    img_h = 0;
+    background.clear();
+}
+
+// Luma of every cell from 2x2 point samples, (r + 2g + b) / 4 for color formats
+void BackgroundModel::sample(const ImageBuffer &image)
+{
+    const int channels = pixel_format_channels(image.format);
+    const int stride = image_row_stride(image);
+
+    luma.resize(grid_w * grid_h);
+    for (int gy = 0; gy < grid_h; gy++)
+    {
+        const int y0 = std::min(gy * cell + cell / 4, image.height - 1);
+        const int y1 = std::min(gy * cell + cell * 3 / 4, image.height - 1);
+        const unsigned char *rows[2] = {image.data + (size_t) y0 * stride, image.data + (size_t) y1 * stride};
+        for (int gx = 0; gx < grid_w; gx++)
+        {
+            const int x0 = std::min(gx * cell + cell / 4, image.width - 1) * channels;
+            const int x1 = std::min(gx * cell + cell * 3 / 4, image.width - 1) * channels;
+            int sum = 0;
+            for (int r = 0; r < 2; r++)
+            {
+                const unsigned char *p[2] = {rows[r] + x0, rows[r] + x1};
+                for (int k = 0; k < 2; k++)
+                    sum += channels >= 3 ? (p[k][0] + 2 * p[k][1] + p[k][2]) >> 2 : p[k][0];
+            }
+            luma[gy * grid_w + gx] = (unsigned char) (sum >> 2);
+        }
+    }
+}
+
+void BackgroundModel::learn()
+{
+    background.assign(luma.begin(), luma.end());
+}
+
+void BackgroundModel::learn(const std::vector<TileRect> &regions)
+{
+    for (const TileRect &region : regions)
+    {
+        const int x1 = std::min((region.x + region.w + cell - 1) / cell, grid_w);
+        const int y1 = std::min((region.y + region.h + cell - 1) / cell, grid_h);
+        for (int gy = region.y / cell; gy < y1; gy++)
+        {
+            for (int gx = region.x / cell; gx < x1; gx++)
+                background[gy * grid_w + gx] = luma[gy * grid_w + gx];
+        }
+    }
+}
+
+float BackgroundModel::update(const ImageBuffer &image, std::vector<TileRect> &regions)
+{
+    regions.clear();
+    if (image.width != img_w || image.height != img_h || background.empty())
+    {
+        img_w = image.width;
+        img_h = image.height;
+        cell = std::max((std::max(img_w, img_h) + options.grid - 1) / std::max(options.grid, 1), 1);
+        grid_w = (img_w + cell - 1) / cell;
+        grid_h = (img_h + cell - 1) / cell;
+        sample(image);
+        background.assign(luma.size(), -255.f);
+        foreground.assign(grid_w * grid_h, 1);
+        // a new stream is all foreground until the detector saw it once
+        return 1.f;
+    }
+
+    sample(image);
+
+    int changed = 0;
+    for (int i = 0; i < grid_w * grid_h; i++)
+    {
+        const float diff = luma[i] - background[i];
+        foreground[i] = std::fabs(diff) > options.pixel_threshold;
+        changed += foreground[i];
+        if (!foreground[i])
+            background[i] += options.alpha * diff;
+    }
+
+    find_regions(img_w, img_h, regions);
+    return (float) changed / (grid_w * grid_h);
+}
+
+void BackgroundModel::find_regions(int img_w, int img_h, std::vector<TileRect> &regions)
+{
+    component.assign(grid_w * grid_h, -1);
+    for (int start = 0; start < grid_w * grid_h; start++)
+    {
+        if (!foreground[start] || component[start] >= 0)
+            continue;
+
+        // 8-connected blob, its bounding box in cells
+        int x0 = start % grid_w, y0 = start / grid_w, x1 = x0, y1 = y0;
+        int cells = 0;
+        component[start] = start;
+        stack.assign(1, start);
+        while (!stack.empty())
+        {
+            const int i = stack.back();
+            stack.pop_back();
+            const int cx = i % grid_w;
+            const int cy = i / grid_w;
+            x0 = std::min(x0, cx);
+            y0 = std::min(y0, cy);
+            x1 = std::max(x1, cx);
+            y1 = std::max(y1, cy);
+            cells++;
+
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int nx = cx + dx;
+                    const int ny = cy + dy;
+                    if (nx < 0 || ny < 0 || nx >= grid_w || ny >= grid_h)
+                        continue;
+                    const int j = ny * grid_w + nx;
+                    if (foreground[j] && component[j] < 0)
+                    {
+                        component[j] = start;
+                        stack.push_back(j);
+                    }
+                }
+            }
+        }
+        if (cells < options.min_cells)
+            continue;
+
+        const int pad_x = (int) ((x1 - x0 + 1) * options.pad) + 1;
+        const int pad_y = (int) ((y1 - y0 + 1) * options.pad) + 1;
+        TileRect region;
+        region.x = std::max(x0 - pad_x, 0) * cell;
+        region.y = std::max(y0 - pad_y, 0) * cell;
+        region.w = std::min((x1 + 1 + pad_x) * cell, img_w) - region.x;
+        region.h = std::min((y1 + 1 + pad_y) * cell, img_h) - region.y;
+        regions.push_back(region);
+    }
+
+    // overlapping crops would detect the same object twice, join them until none overlap
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < regions.size(); j++)
+            {
+                TileRect &a = regions[i];
+                const TileRect &b = regions[j];
+                if (a.x >= b.x + b.w || b.x >= a.x + a.w || a.y >= b.y + b.h || b.y >= a.y + a.h)
+                    continue;
+
+                const int x1 = std::max(a.x + a.w, b.x + b.w);
+                const int y1 = std::max(a.y + a.h, b.y + b.h);
+                a.x = std::min(a.x, b.x);
+                a.y = std::min(a.y, b.y);
+                a.w = x1 - a.x;
+                a.h = y1 - a.y;
+                regions.erase(regions.begin() + j);
+                merged = true;
+                break;
+            }
+        }
+    }
+}
+
+RoiDetector::RoiDetector(std::shared_ptr<Detector> detector, const RoiOptions &options)
+    : detector(std::move(detector)), options(options), background(options)
+{
+}
+
+void RoiDetector::reset()
+{
+    background.reset();
+    previous.clear();
+    since_full = 0;
+    has_full = false;
+}
+
+static inline float box_iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    return iw * ih / (a.w * a.h + b.w * b.h - iw * ih);
+}
+
+// Fraction of the box inside the region
+static inline float covered(const BoxInfo &box, const TileRect &region)
+{
+    const float iw = std::min(box.x1 + box.w, (float) (region.x + region.w)) - std::max(box.x1, (float) region.x);
+    const float ih = std::min(box.y1 + box.h, (float) (region.y + region.h)) - std::max(box.y1, (float) region.y);
+    if (iw <= 0.f || ih <= 0.f || box.w * box.h <= 0.f)
+        return 0.f;
+    return iw * ih / (box.w * box.h);
+}
+
+bool RoiDetector::detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &boxes)
+{
+    num_frames++;
+    const float changed = background.update(image, regions);
+
+    const bool refresh = options.refresh_interval > 0 && since_full + 1 >= options.refresh_interval;
+    if (!has_full || refresh || changed > options.max_fraction)
+    {
+        // also taken when the whole scene moved (lights, camera bumped)
+        detector->detect(image, threshold, nms_threshold, boxes);
+        background.learn();
+        previous = boxes;
+        since_full = 0;
+        has_full = true;
+        num_full_frames++;
+        return true;
+    }
+    since_full++;
+
+    if (regions.empty())
+    {
+        boxes = previous;
+        return false;
+    }
+
+    num_roi_frames++;
+    for (const TileRect &region : regions)
+        roi_pixels += (double) region.w * region.h / ((double) image.width * image.height);
+
+    detector->detect_regions(image, regions, threshold, nms_threshold, fresh);
+    background.learn(regions);
+
+    // boxes mostly inside a region were detected again there, the others stay as they were
+    boxes.clear();
+    for (const BoxInfo &box : previous)
+    {
+        float inside = 0.f;
+        for (const TileRect &region : regions)
+            inside = std::max(inside, covered(box, region));
+        if (inside > 0.5f)
+            continue;
+
+        // a region border cuts it: the crop may have found the object again, the fresh box is the newer one.
+        // Boxes of one pass are never compared, their NMS already kept them apart.
+        bool duplicate = false;
+        if (inside > 0.f)
+        {
+            for (const BoxInfo &detection : fresh)
+                duplicate |= detection.label == box.label && box_iou(detection, box) > nms_threshold;
+        }
+        if (!duplicate)
+            boxes.push_back(box);
+    }
+    boxes.insert(boxes.end(), fresh.begin(), fresh.end());
+    std::stable_sort(boxes.begin(), boxes.end(), [](const BoxInfo &a, const BoxInfo &b) { return a.score > b.score; });
+
+    previous = boxes;
+    return true;
+}
@@ -0,0 +1,101 @@
+//
+// Region-of-interest inference for still cameras
+// The background is a coarse luma grid (about 80 cells on the longer side) of the scene as the detector last
+// saw it. Cells that moved away from it are grouped into blobs and the detector only sees padded crops
+// around them; the boxes of the rest of the frame are carried over. Once a crop went through the detector
+// its cells are learnt, so an object that stops is not detected again and again. Cells nobody looked at
+// follow slow lighting drift through a running average. A quiet frame costs the grid update,
+// a full frame is detected every refresh_interval frames anyway.
+//
+
+#ifndef MotionRoi_H
+#define MotionRoi_H
+
+#include <memory>
+#include <vector>
+#include "Detector.h"
+#include "Tiling.h"
+
+typedef struct RoiOptions {
+    int grid = 80;              // background cells on the longer side of the frame
+    float alpha = 0.05f;        // running average rate of the unchanged cells
+    int pixel_threshold = 20;   // luma change (0-255) marking a cell as foreground
+    int min_cells = 2;          // smaller blobs are sensor noise
+    float pad = 0.25f;          // crop margin around a blob, relative to its size, plus one cell
+    float max_fraction = 0.4f;  // more of the frame changed than this: detect the full frame instead
+    int refresh_interval = 30;  // frames between two full-frame detections, <= 0 never refreshes
+} RoiOptions;
+
+// Changed regions of a frame, one instance per stream
+class BackgroundModel {
+public:
+    explicit BackgroundModel(const RoiOptions &options = RoiOptions());
+
+    void reset();
+
+    // Compare the frame with the background: regions receives the padded, merged bounding boxes of
+    // the changed blobs; returns the fraction of the cells that changed
+    float update(const ImageBuffer &image, std::vector<TileRect> &regions);
+
+    // The detector saw these regions of the last frame, they become background
+    void learn(const std::vector<TileRect> &regions);
+
+    // Same for the whole last frame
+    void learn();
+
+private:
+    void sample(const ImageBuffer &image);
+
+    void find_regions(int img_w, int img_h, std::vector<TileRect> &regions);
+
+    RoiOptions options;
+    int img_w = 0;
+    int img_h = 0;
+    int cell = 1;
+    int grid_w = 0;
+    int grid_h = 0;
+    std::vector<float> background;
+    std::vector<unsigned char> luma;
+    std::vector<unsigned char> foreground;
+    // connected components scratch
+    std::vector<int> component;
+    std::vector<int> stack;
+};
+
+// Synchronous ROI mode around a detector, one instance per stream, not thread-safe;
+// the detector itself may be shared
+class RoiDetector {
+public:
+    RoiDetector(std::shared_ptr<Detector> detector, const RoiOptions &options);
+
+    // Returns whether the detector ran, on crops or on the full frame
+    bool detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &boxes);
+
+    void reset();
+
+    long long frames() const { return num_frames; }
+
+    long long full_frames() const { return num_full_frames; }
+
+    long long roi_frames() const { return num_roi_frames; }
+
+    // Mean fraction of a frame sent through the network as crops
+    double roi_area() const { return num_frames > 0 ? roi_pixels / num_frames : 0.0; }
+
+private:
+    std::shared_ptr<Detector> detector;
+    RoiOptions options;
+    BackgroundModel background;
+    std::vector<TileRect> regions;
+    // boxes of the previous frame, kept where nothing moved
+    std::vector<BoxInfo> previous;
+    std::vector<BoxInfo> fresh;
+    int since_full = 0;
+    bool has_full = false;
+    long long num_frames = 0;
+    long long num_full_frames = 0;
+    long long num_roi_frames = 0;
+    double roi_pixels = 0;
+};
+
+#endif //MotionRoi_H
@@ -7,7 +7,7 @@
 #define NanoDetPlus_H
 
 #include "net.h"
-#include "YOLOv5s.h"
+#include "GenericDetector.h"
 
 typedef struct HeadInfo_
 {
@@ -24,13 +24,15 @@ typedef struct CenterPrior_
 } CenterPrior;
 
 
-class NanoDetPlus{
+// The stock model, equivalent to NanoDetPlus.cfg; other NanoDet exports only need a sidecar for GenericDetector
+class NanoDetPlus : public GenericDetector {
 public:
+    NanoDetPlus(const char *param, const char *bin, bool useGPU, int threads_number);
+#ifdef __ANDROID__
     NanoDetPlus(AAssetManager *mgr, const char *param, const char *bin, bool useGPU, int threads_number);
+#endif
 
-    ~NanoDetPlus();
-
-    std::vector<BoxInfo> detect(JNIEnv *env, jobject image, float score_threshold, float nms_threshold);
+    static ModelConfig default_config();
 /*
     std::vector<std::string> labels{"person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
                                     "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
@@ -42,27 +44,6 @@ public:
                                     "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
                                     "hair drier", "toothbrush"};
 */
-private:
-    //void preprocess(JNIEnv *env, jobject image, ncnn::Mat& in);
-    //void decode_infer(ncnn::Mat& feats, std::vector<CenterPrior>& center_priors, float threshold, std::vector<std::vector<BoxInfo>>& results, float width_ratio, float height_ratio);
-    //BoxInfo disPred2Bbox(const float*& dfl_det, int label, float score, int x, int y, int stride, float width_ratio, float height_ratio);
-
-    //static void nms(std::vector<BoxInfo>& result, float nms_threshold);
-
-    ncnn::Net *Net;
-    // modify these parameters to the same with your config if you want to use your own model
-    int input_size[2] = {320, 320}; // input height and width
-//    int num_class = 80; // number of classes. 80 for COCO
-//    int reg_max = 7; // `reg_max` set in the training config. Default: 7.
-    std::vector<int> strides = { 8, 16, 32, 64 }; // strides of the multi-level feature.
-    ncnn::UnlockedPoolAllocator blob_pool_allocator;
-    ncnn::PoolAllocator workspace_pool_allocator;
-
-public:
-    static NanoDetPlus *detector;
-    static bool hasGPU;
-    static bool toUseGPU;
-
 };
 
 
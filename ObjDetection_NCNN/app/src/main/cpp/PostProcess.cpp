@@ -0,0 +1,192 @@
+//
+// Post-processing shared by the detectors: candidate selection and non-maximum suppression
+//
+
+#include "PostProcess.h"
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+void BoxStore::clear()
+{
+    x1.clear();
+    y1.clear();
+    x2.clear();
+    y2.clear();
+    area.clear();
+}
+
+void BoxStore::reserve(size_t n)
+{
+    x1.reserve(n);
+    y1.reserve(n);
+    x2.reserve(n);
+    y2.reserve(n);
+    area.reserve(n);
+}
+
+void BoxStore::push_back(const BoxInfo &box)
+{
+    x1.push_back(box.x1);
+    y1.push_back(box.y1);
+    x2.push_back(box.x1 + box.w);
+    y2.push_back(box.y1 + box.h);
+    area.push_back(box.w * box.h);
+}
+
+// Whether the candidate overlaps any kept box with IoU > nms_threshold
+// The intersection is clamped at zero instead of branching on disjoint boxes, which yields the same
+// inter / union values as the scalar intersection_area() for boxes with non-negative size
+static bool is_suppressed(const BoxStore &kept, float x1, float y1, float x2, float y2, float area, float nms_threshold)
+{
+    const int n = (int) kept.size();
+    const float *kx1 = kept.x1.data();
+    const float *ky1 = kept.y1.data();
+    const float *kx2 = kept.x2.data();
+    const float *ky2 = kept.y2.data();
+    const float *karea = kept.area.data();
+
+    int j = 0;
+#if __ARM_NEON && __aarch64__
+    const float32x4_t _x1 = vdupq_n_f32(x1);
+    const float32x4_t _y1 = vdupq_n_f32(y1);
+    const float32x4_t _x2 = vdupq_n_f32(x2);
+    const float32x4_t _y2 = vdupq_n_f32(y2);
+    const float32x4_t _area = vdupq_n_f32(area);
+    const float32x4_t _threshold = vdupq_n_f32(nms_threshold);
+    const float32x4_t _zero = vdupq_n_f32(0.f);
+    for (; j + 3 < n; j += 4)
+    {
+        float32x4_t _inter_w = vsubq_f32(vminq_f32(_x2, vld1q_f32(kx2 + j)), vmaxq_f32(_x1, vld1q_f32(kx1 + j)));
+        float32x4_t _inter_h = vsubq_f32(vminq_f32(_y2, vld1q_f32(ky2 + j)), vmaxq_f32(_y1, vld1q_f32(ky1 + j)));
+        float32x4_t _inter = vmulq_f32(vmaxq_f32(_inter_w, _zero), vmaxq_f32(_inter_h, _zero));
+        float32x4_t _union = vsubq_f32(vaddq_f32(_area, vld1q_f32(karea + j)), _inter);
+        uint32x4_t _gt = vcgtq_f32(vdivq_f32(_inter, _union), _threshold);
+        if (vmaxvq_u32(_gt))
+            return true;
+    }
+#elif __SSE2__
+    const __m128 _x1 = _mm_set1_ps(x1);
+    const __m128 _y1 = _mm_set1_ps(y1);
+    const __m128 _x2 = _mm_set1_ps(x2);
+    const __m128 _y2 = _mm_set1_ps(y2);
+    const __m128 _area = _mm_set1_ps(area);
+    const __m128 _threshold = _mm_set1_ps(nms_threshold);
+    const __m128 _zero = _mm_setzero_ps();
+    for (; j + 3 < n; j += 4)
+    {
+        __m128 _inter_w = _mm_sub_ps(_mm_min_ps(_x2, _mm_loadu_ps(kx2 + j)), _mm_max_ps(_x1, _mm_loadu_ps(kx1 + j)));
+        __m128 _inter_h = _mm_sub_ps(_mm_min_ps(_y2, _mm_loadu_ps(ky2 + j)), _mm_max_ps(_y1, _mm_loadu_ps(ky1 + j)));
+        __m128 _inter = _mm_mul_ps(_mm_max_ps(_inter_w, _zero), _mm_max_ps(_inter_h, _zero));
+        __m128 _union = _mm_sub_ps(_mm_add_ps(_area, _mm_loadu_ps(karea + j)), _inter);
+        __m128 _gt = _mm_cmpgt_ps(_mm_div_ps(_inter, _union), _threshold);
+        if (_mm_movemask_ps(_gt))
+            return true;
+    }
+#endif
+    for (; j < n; j++)
+    {
+        float inter_width = std::max(std::min(x2, kx2[j]) - std::max(x1, kx1[j]), 0.f);
+        float inter_height = std::max(std::min(y2, ky2[j]) - std::max(y1, ky1[j]), 0.f);
+        float inter_area = inter_width * inter_height;
+        float union_area = area + karea[j] - inter_area;
+        // float IoU = inter_area / union_area
+        if (inter_area / union_area > nms_threshold)
+            return true;
+    }
+
+    return false;
+}
+
+void NmsEngine::run(const std::vector<BoxInfo> &objects, std::vector<int> &picked, float nms_threshold,
+                    bool agnostic, int max_detections)
+{
+    picked.clear();
+
+    const int n = (int) objects.size();
+    if (n == 0)
+        return;
+
+    int num_labels = 1;
+    if (!agnostic)
+    {
+        for (int i = 0; i < n; i++)
+            num_labels = std::max(num_labels, objects[i].label + 1);
+    }
+
+    // counting sort of the indexes by label, keeping the score order inside every bucket
+    bucket_start.assign(num_labels + 1, 0);
+    for (int i = 0; i < n; i++)
+    {
+        int label = agnostic ? 0 : std::max(objects[i].label, 0);
+        bucket_start[label + 1]++;
+    }
+    for (int l = 0; l < num_labels; l++)
+        bucket_start[l + 1] += bucket_start[l];
+
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        int label = agnostic ? 0 : std::max(objects[i].label, 0);
+        order[bucket_start[label]++] = i;
+    }
+    for (int l = num_labels; l > 0; l--)
+        bucket_start[l] = bucket_start[l - 1];
+    bucket_start[0] = 0;
+
+    for (int l = 0; l < num_labels; l++)
+    {
+        kept.clear();
+
+        for (int k = bucket_start[l]; k < bucket_start[l + 1]; k++)
+        {
+            const BoxInfo &a = objects[order[k]];
+
+            if (is_suppressed(kept, a.x1, a.y1, a.x1 + a.w, a.y1 + a.h, a.w * a.h, nms_threshold))
+                continue;
+
+            kept.push_back(a);
+            picked.push_back(order[k]);
+
+            // no later box of this label can make it into the first max_detections of the merged result
+            if (max_detections > 0 && (int) kept.size() >= max_detections)
+                break;
+        }
+    }
+
+    // back to global score order, as the single-pass loop would have produced
+    if (num_labels > 1)
+        std::sort(picked.begin(), picked.end());
+
+    if (max_detections > 0 && (int) picked.size() > max_detections)
+        picked.resize(max_detections);
+}
+
+static inline bool score_greater(const BoxInfo &a, const BoxInfo &b)
+{
+    return a.score > b.score;
+}
+
+void select_topk_descent(std::vector<BoxInfo> &objects, int topk)
+{
+    if (topk > 0 && (int) objects.size() > topk)
+    {
+        // O(n) selection, only the survivors get sorted
+        std::nth_element(objects.begin(), objects.begin() + topk, objects.end(), score_greater);
+        objects.resize(topk);
+    }
+
+    std::sort(objects.begin(), objects.end(), score_greater);
+}
+
+void nms_sorted_bboxes(const std::vector<BoxInfo> &objects, std::vector<int> &picked, float nms_threshold,
+                       bool agnostic, int max_detections)
+{
+    NmsEngine engine;
+    engine.run(objects, picked, nms_threshold, agnostic, max_detections);
+}
@@ -0,0 +1,53 @@
+//
+// Post-processing shared by the detectors: candidate selection and non-maximum suppression
+//
+
+#ifndef PostProcess_H
+#define PostProcess_H
+
+#include <vector>
+#include "Common.h"
+
+// Structure-of-arrays copy of the boxes kept so far, so the IoU kernel can compare one candidate against 4 boxes per step
+class BoxStore {
+public:
+    void clear();
+
+    void reserve(size_t n);
+
+    void push_back(const BoxInfo &box);
+
+    size_t size() const { return x1.size(); }
+
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> x2;
+    std::vector<float> y2;
+    std::vector<float> area;
+};
+
+// Greedy NMS over proposals sorted by descending score
+// Proposals are bucketed per label first, so boxes of different classes are never compared,
+// and every bucket stops once max_detections boxes are kept.
+// The picked indexes are identical to the classic O(n * picked) loop, truncated to max_detections.
+class NmsEngine {
+public:
+    void run(const std::vector<BoxInfo> &objects, std::vector<int> &picked, float nms_threshold,
+             bool agnostic = false, int max_detections = 0);
+
+private:
+    // proposal indexes grouped by label, ascending inside each group
+    std::vector<int> order;
+    std::vector<int> bucket_start;
+    BoxStore kept;
+};
+
+// Keep the topk highest scoring proposals, sorted by descending score
+// topk <= 0 sorts everything
+void select_topk_descent(std::vector<BoxInfo> &objects, int topk);
+
+// max_detections <= 0 keeps every surviving box
+void nms_sorted_bboxes(const std::vector<BoxInfo> &objects, std::vector<int> &picked, float nms_threshold,
+                       bool agnostic = false, int max_detections = 0);
+
+#endif //PostProcess_H
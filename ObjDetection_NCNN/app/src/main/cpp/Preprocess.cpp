@@ -0,0 +1,406 @@
+//
+// Input preprocessing shared by the detectors
+//
+
+#include "Preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+LetterboxInfo compute_letterbox(int img_w, int img_h, int target_size, int max_stride)
+{
+    LetterboxInfo letterbox;
+    letterbox.img_w = img_w;
+    letterbox.img_h = img_h;
+
+    int w = img_w;
+    int h = img_h;
+    float scale;
+    if (w > h)
+    {
+        scale = (float) target_size / w;
+        w = target_size;
+        h = int(h * scale);
+    }
+    else
+    {
+        scale = (float) target_size / h;
+        h = target_size;
+        w = int(w * scale);
+    }
+
+    letterbox.w = w;
+    letterbox.h = h;
+    letterbox.wpad = (w + max_stride - 1) / max_stride * max_stride - w;
+    letterbox.hpad = (h + max_stride - 1) / max_stride * max_stride - h;
+    letterbox.scale = scale;
+    return letterbox;
+}
+
+// Byte offsets of the 3 output channels inside one source pixel
+static void source_channel_offsets(PixelFormat format, bool to_bgr, int *offsets)
+{
+    // offsets of r, g, b
+    int r = 0, g = 1, b = 2;
+    switch (format)
+    {
+        case PIXEL_FORMAT_BGRA:
+        case PIXEL_FORMAT_BGR:
+            r = 2;
+            b = 0;
+            break;
+        case PIXEL_FORMAT_GRAY:
+            r = g = b = 0;
+            break;
+        default:
+            break;
+    }
+
+    offsets[0] = to_bgr ? b : r;
+    offsets[1] = g;
+    offsets[2] = to_bgr ? r : b;
+}
+
+// Same sample positions as ncnn resize_bilinear (pixel centers aligned, clamped at the borders)
+static void bilinear_coefficients(int srcw, int w, int *ofs0, int *ofs1, float *alpha)
+{
+    const double scale = (double) srcw / w;
+
+    for (int dx = 0; dx < w; dx++)
+    {
+        float fx = (float) ((dx + 0.5) * scale - 0.5);
+        int sx = (int) floorf(fx);
+        fx -= sx;
+
+        if (sx < 0)
+        {
+            sx = 0;
+            fx = 0.f;
+        }
+        if (sx >= srcw - 1)
+        {
+            sx = std::max(srcw - 2, 0);
+            fx = srcw > 1 ? 1.f : 0.f;
+        }
+
+        ofs0[dx] = sx;
+        ofs1[dx] = std::min(sx + 1, srcw - 1);
+        alpha[dx] = fx;
+    }
+}
+
+void LetterboxPreprocessor::prepare_columns(int srcw, int w, int channels)
+{
+    if (column_key[0] == srcw && column_key[1] == w && column_key[2] == channels)
+        return;
+
+    xofs0.resize(w);
+    xofs1.resize(w);
+    alpha.resize(w);
+    bilinear_coefficients(srcw, w, xofs0.data(), xofs1.data(), alpha.data());
+    for (int dx = 0; dx < w; dx++)
+    {
+        xofs0[dx] *= channels;
+        xofs1[dx] *= channels;
+    }
+
+    rows.resize(w * 3 * 2);
+
+    column_key[0] = srcw;
+    column_key[1] = w;
+    column_key[2] = channels;
+}
+
+void LetterboxPreprocessor::resize_row(const unsigned char *src, const int *offsets, float *row) const
+{
+    const int w = (int) alpha.size();
+    float *row0 = row;
+    float *row1 = row + w;
+    float *row2 = row + w * 2;
+
+    for (int dx = 0; dx < w; dx++)
+    {
+        const unsigned char *p0 = src + xofs0[dx];
+        const unsigned char *p1 = src + xofs1[dx];
+        const float a1 = alpha[dx];
+        const float a0 = 1.f - a1;
+
+        row0[dx] = p0[offsets[0]] * a0 + p1[offsets[0]] * a1;
+        row1[dx] = p0[offsets[1]] * a0 + p1[offsets[1]] * a1;
+        row2[dx] = p0[offsets[2]] * a0 + p1[offsets[2]] * a1;
+    }
+}
+
+void LetterboxPreprocessor::fill_border(const LetterboxInfo &letterbox, float pad_value, const float *mean_vals,
+                                        const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator)
+{
+    const int w = letterbox.w;
+    const int h = letterbox.h;
+    const int outw = w + letterbox.wpad;
+    const int outh = h + letterbox.hpad;
+    const int top = letterbox.hpad / 2;
+    const int left = letterbox.wpad / 2;
+
+    // no-op when the shape did not change since the previous frame
+    in_pad.create(outw, outh, 3, 4u, allocator);
+
+    float pad[3];
+    for (int c = 0; c < 3; c++)
+        pad[c] = (pad_value - mean_vals[c]) * norm_vals[c];
+
+    // border rows and columns
+    for (int c = 0; c < 3; c++)
+    {
+        ncnn::Mat plane = in_pad.channel(c);
+        for (int y = 0; y < outh; y++)
+        {
+            float *ptr = plane.row(y);
+            if (y < top || y >= top + h)
+            {
+                std::fill(ptr, ptr + outw, pad[c]);
+            }
+            else
+            {
+                std::fill(ptr, ptr + left, pad[c]);
+                std::fill(ptr + left + w, ptr + outw, pad[c]);
+            }
+        }
+    }
+}
+
+void LetterboxPreprocessor::run(const ImageBuffer &image, const LetterboxInfo &letterbox, bool to_bgr, float pad_value,
+                                const float *mean_vals, const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator)
+{
+    const int w = letterbox.w;
+    const int h = letterbox.h;
+    const int top = letterbox.hpad / 2;
+    const int left = letterbox.wpad / 2;
+
+    fill_border(letterbox, pad_value, mean_vals, norm_vals, in_pad, allocator);
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    const int channels = pixel_format_channels(image.format);
+    const int src_stride = image_row_stride(image);
+    int offsets[3];
+    source_channel_offsets(image.format, to_bgr, offsets);
+
+    prepare_columns(image.width, w, channels);
+
+    // resized rows for the two source rows currently in use
+    float *rows_a = rows.data();
+    float *rows_b = rows.data() + w * 3;
+    int row_a = -1;
+    int row_b = -1;
+
+    const double scale_y = (double) image.height / h;
+    for (int dy = 0; dy < h; dy++)
+    {
+        float fy = (float) ((dy + 0.5) * scale_y - 0.5);
+        int sy = (int) floorf(fy);
+        fy -= sy;
+
+        if (sy < 0)
+        {
+            sy = 0;
+            fy = 0.f;
+        }
+        if (sy >= image.height - 1)
+        {
+            sy = std::max(image.height - 2, 0);
+            fy = image.height > 1 ? 1.f : 0.f;
+        }
+        const int sy1 = std::min(sy + 1, image.height - 1);
+
+        // walking down the image, the previous lower row usually becomes the upper one
+        if (row_a != sy)
+        {
+            if (row_b == sy)
+            {
+                std::swap(rows_a, rows_b);
+                std::swap(row_a, row_b);
+            }
+            else
+            {
+                resize_row(image.data + (size_t) sy * src_stride, offsets, rows_a);
+                row_a = sy;
+            }
+        }
+        if (row_b != sy1)
+        {
+            resize_row(image.data + (size_t) sy1 * src_stride, offsets, rows_b);
+            row_b = sy1;
+        }
+
+        const float b1 = fy;
+        const float b0 = 1.f - fy;
+        for (int c = 0; c < 3; c++)
+        {
+            const float *pa = rows_a + w * c;
+            const float *pb = rows_b + w * c;
+            float *outptr = in_pad.channel(c).row(top + dy) + left;
+
+            const float mean = mean_vals[c];
+            const float norm = norm_vals[c];
+            for (int dx = 0; dx < w; dx++)
+            {
+                outptr[dx] = (pa[dx] * b0 + pb[dx] * b1 - mean) * norm;
+            }
+        }
+    }
+}
+
+void yuv_rotated_size(const YuvImageBuffer &image, int &width, int &height)
+{
+    const bool transposed = image.rotation == 90 || image.rotation == 270;
+    width = transposed ? image.height : image.width;
+    height = transposed ? image.width : image.height;
+}
+
+// Plane offset contributed by a rotated column (is_column) or a rotated row coordinate v
+// Rotated (x, y) reads the sensor pixel (x, y), (y, H-1-x), (W-1-x, H-1-y) or (W-1-y, x) for 0, 90, 180 and 270,
+// so every sample address splits into column_offset(x) + row_offset(y) and both parts can be tabulated.
+// shift is 1 for the 2x2 subsampled chroma planes.
+static inline int rotated_offset(const YuvImageBuffer &image, bool is_column, int v,
+                                 int row_stride, int pixel_stride, int shift)
+{
+    switch (image.rotation)
+    {
+        case 90:
+            return is_column ? ((image.height - 1 - v) >> shift) * row_stride : (v >> shift) * pixel_stride;
+        case 180:
+            return is_column ? ((image.width - 1 - v) >> shift) * pixel_stride : ((image.height - 1 - v) >> shift) * row_stride;
+        case 270:
+            return is_column ? (v >> shift) * row_stride : ((image.width - 1 - v) >> shift) * pixel_stride;
+        default:
+            return is_column ? (v >> shift) * pixel_stride : (v >> shift) * row_stride;
+    }
+}
+
+// Full range BT.601, what YuvImage.compressToJpeg + BitmapFactory produced for camera frames
+static inline void yuv_to_rgb(float y, int u, int v, float &r, float &g, float &b)
+{
+    const float fu = (float) (u - 128);
+    const float fv = (float) (v - 128);
+    r = std::min(std::max(y + 1.402f * fv, 0.f), 255.f);
+    g = std::min(std::max(y - 0.344136f * fu - 0.714136f * fv, 0.f), 255.f);
+    b = std::min(std::max(y + 1.772f * fu, 0.f), 255.f);
+}
+
+void yuv_to_rgba(const YuvImageBuffer &image, unsigned char *rgba, int stride)
+{
+    int w, h;
+    yuv_rotated_size(image, w, h);
+
+    std::vector<int> xofs(w * 2);
+    for (int x = 0; x < w; x++)
+    {
+        xofs[x * 2] = rotated_offset(image, true, x, image.y_row_stride, 1, 0);
+        xofs[x * 2 + 1] = rotated_offset(image, true, x, image.uv_row_stride, image.uv_pixel_stride, 1);
+    }
+
+    for (int y = 0; y < h; y++)
+    {
+        const unsigned char *yrow = image.y + rotated_offset(image, false, y, image.y_row_stride, 1, 0);
+        const int uvrow = rotated_offset(image, false, y, image.uv_row_stride, image.uv_pixel_stride, 1);
+        const unsigned char *urow = image.u + uvrow;
+        const unsigned char *vrow = image.v + uvrow;
+        unsigned char *outptr = rgba + (size_t) y * stride;
+
+        for (int x = 0; x < w; x++)
+        {
+            float r, g, b;
+            yuv_to_rgb(yrow[xofs[x * 2]], urow[xofs[x * 2 + 1]], vrow[xofs[x * 2 + 1]], r, g, b);
+            outptr[0] = (unsigned char) (r + 0.5f);
+            outptr[1] = (unsigned char) (g + 0.5f);
+            outptr[2] = (unsigned char) (b + 0.5f);
+            outptr[3] = 255;
+            outptr += 4;
+        }
+    }
+}
+
+// Per destination coordinate along one rotated axis: the two luma taps, the chroma sample nearest to
+// the bilinear sample position, and the weight of the second luma tap
+static void yuv_axis_table(const YuvImageBuffer &image, bool is_column, int srcw, int w, int *ofs, float *weight)
+{
+    std::vector<int> ofs0(w);
+    std::vector<int> ofs1(w);
+    bilinear_coefficients(srcw, w, ofs0.data(), ofs1.data(), weight);
+
+    for (int d = 0; d < w; d++)
+    {
+        const int nearest = weight[d] < 0.5f ? ofs0[d] : ofs1[d];
+        ofs[d * 3] = rotated_offset(image, is_column, ofs0[d], image.y_row_stride, 1, 0);
+        ofs[d * 3 + 1] = rotated_offset(image, is_column, ofs1[d], image.y_row_stride, 1, 0);
+        ofs[d * 3 + 2] = rotated_offset(image, is_column, nearest, image.uv_row_stride, image.uv_pixel_stride, 1);
+    }
+}
+
+void LetterboxPreprocessor::run(const YuvImageBuffer &image, const LetterboxInfo &letterbox, bool to_bgr, float pad_value,
+                                const float *mean_vals, const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator)
+{
+    const int w = letterbox.w;
+    const int h = letterbox.h;
+    const int top = letterbox.hpad / 2;
+    const int left = letterbox.wpad / 2;
+
+    fill_border(letterbox, pad_value, mean_vals, norm_vals, in_pad, allocator);
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    int srcw, srch;
+    yuv_rotated_size(image, srcw, srch);
+
+    // camera frames keep their layout, the tables only change with it
+    const int key[8] = {image.width, image.height, image.y_row_stride, image.uv_row_stride, image.uv_pixel_stride,
+                        image.rotation, w, h};
+    if (!std::equal(key, key + 8, yuv_key))
+    {
+        yuv_xofs.resize(w * 3);
+        yuv_alpha.resize(w);
+        yuv_yofs.resize(h * 3);
+        yuv_beta.resize(h);
+        yuv_axis_table(image, true, srcw, w, yuv_xofs.data(), yuv_alpha.data());
+        yuv_axis_table(image, false, srch, h, yuv_yofs.data(), yuv_beta.data());
+        std::copy(key, key + 8, yuv_key);
+    }
+
+    // the network wants r, g, b or b, g, r planes
+    const int cr = to_bgr ? 2 : 0;
+    const int cb = to_bgr ? 0 : 2;
+    const float mean[3] = {mean_vals[0], mean_vals[1], mean_vals[2]};
+    const float norm[3] = {norm_vals[0], norm_vals[1], norm_vals[2]};
+    float *outptr[3];
+
+    for (int dy = 0; dy < h; dy++)
+    {
+        const unsigned char *y0 = image.y + yuv_yofs[dy * 3];
+        const unsigned char *y1 = image.y + yuv_yofs[dy * 3 + 1];
+        const unsigned char *urow = image.u + yuv_yofs[dy * 3 + 2];
+        const unsigned char *vrow = image.v + yuv_yofs[dy * 3 + 2];
+        const float b1 = yuv_beta[dy];
+        const float b0 = 1.f - b1;
+
+        for (int c = 0; c < 3; c++)
+            outptr[c] = in_pad.channel(c).row(top + dy) + left;
+
+        for (int dx = 0; dx < w; dx++)
+        {
+            const int *ofs = &yuv_xofs[dx * 3];
+            const float a1 = yuv_alpha[dx];
+            const float a0 = 1.f - a1;
+
+            const float luma = (y0[ofs[0]] * a0 + y0[ofs[1]] * a1) * b0 + (y1[ofs[0]] * a0 + y1[ofs[1]] * a1) * b1;
+
+            float r, g, b;
+            yuv_to_rgb(luma, urow[ofs[2]], vrow[ofs[2]], r, g, b);
+
+            outptr[cr][dx] = (r - mean[cr]) * norm[cr];
+            outptr[1][dx] = (g - mean[1]) * norm[1];
+            outptr[cb][dx] = (b - mean[cb]) * norm[cb];
+        }
+    }
+}
@@ -0,0 +1,61 @@
+//
+// Input preprocessing shared by the detectors
+//
+
+#ifndef Preprocess_H
+#define Preprocess_H
+
+#include <vector>
+#include "mat.h"
+#include "Common.h"
+
+// Scale the longer side to target_size, then pad both sides up to a multiple of max_stride
+// yolov5/utils/datasets.py letterbox
+LetterboxInfo compute_letterbox(int img_w, int img_h, int target_size, int max_stride);
+
+// Size of the frame once rotated upright
+void yuv_rotated_size(const YuvImageBuffer &image, int &width, int &height);
+
+// Full resolution upright RGBA copy of a camera frame, for display
+void yuv_to_rgba(const YuvImageBuffer &image, unsigned char *rgba, int stride);
+
+// Fused letterbox preprocessing: bilinear resize, alpha drop, channel swap, constant padding and
+// (v - mean) * norm in a single pass, written straight into a planar float tensor.
+// Replaces from_pixels_resize + copy_make_border + substract_mean_normalize, which made three passes
+// and allocated a Mat for each. The scratch rows and the tensor are reused while the shape stays the same.
+class LetterboxPreprocessor {
+public:
+    void run(const ImageBuffer &image, const LetterboxInfo &letterbox, bool to_bgr, float pad_value,
+             const float *mean_vals, const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator = 0);
+
+    // Camera frame variant: YUV to RGB conversion and rotation are folded into the same pass,
+    // letterbox describes the rotated frame (see yuv_rotated_size)
+    void run(const YuvImageBuffer &image, const LetterboxInfo &letterbox, bool to_bgr, float pad_value,
+             const float *mean_vals, const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator = 0);
+
+private:
+    // allocates in_pad and fills everything around the resized image
+    static void fill_border(const LetterboxInfo &letterbox, float pad_value, const float *mean_vals,
+                            const float *norm_vals, ncnn::Mat &in_pad, ncnn::Allocator *allocator);
+
+    void prepare_columns(int srcw, int w, int channels);
+
+    void resize_row(const unsigned char *src, const int *offsets, float *row) const;
+
+    // per destination column, byte offsets of the two source pixels and the weight of the right one
+    std::vector<int> xofs0;
+    std::vector<int> xofs1;
+    std::vector<float> alpha;
+    // two horizontally resized source rows, 3 planes of w floats each
+    std::vector<float> rows;
+    int column_key[3] = {0, 0, 0};
+    // camera frames: per destination column / row, plane offsets of the two luma taps and the nearest chroma sample
+    std::vector<int> yuv_xofs;
+    std::vector<float> yuv_alpha;
+    std::vector<int> yuv_yofs;
+    std::vector<float> yuv_beta;
+    // frame layout and letterbox size the tables above were built for
+    int yuv_key[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+};
+
+#endif //Preprocess_H
@@ -0,0 +1,122 @@
+//
+// Vectorized math helpers for the decoders
+// exp_ps follows the cephes polynomial used by ncnn's neon_mathfun.h / sse_mathfun.h, which are not part of the installed ncnn headers
+//
+
+#ifndef SimdMath_H
+#define SimdMath_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define c_exp_hi 88.3762626647949f
+#define c_exp_lo -88.3762626647949f
+
+#define c_cephes_LOG2EF 1.44269504088896341f
+#define c_cephes_exp_C1 0.693359375f
+#define c_cephes_exp_C2 -2.12194440e-4f
+
+#define c_cephes_exp_p0 1.9875691500E-4f
+#define c_cephes_exp_p1 1.3981999507E-3f
+#define c_cephes_exp_p2 8.3334519073E-3f
+#define c_cephes_exp_p3 4.1665795894E-2f
+#define c_cephes_exp_p4 1.6666665459E-1f
+#define c_cephes_exp_p5 5.0000001201E-1f
+
+#if __ARM_NEON
+static inline float32x4_t exp_ps(float32x4_t x)
+{
+    float32x4_t tmp, fx;
+
+    float32x4_t one = vdupq_n_f32(1.f);
+    x = vminq_f32(x, vdupq_n_f32(c_exp_hi));
+    x = vmaxq_f32(x, vdupq_n_f32(c_exp_lo));
+
+    // express exp(x) as exp(g + n*log(2))
+    fx = vmlaq_f32(vdupq_n_f32(0.5f), x, vdupq_n_f32(c_cephes_LOG2EF));
+
+    // perform a floorf
+    tmp = vcvtq_f32_s32(vcvtq_s32_f32(fx));
+
+    // if greater, substract 1
+    uint32x4_t mask = vcgtq_f32(tmp, fx);
+    mask = vandq_u32(mask, vreinterpretq_u32_f32(one));
+
+    fx = vsubq_f32(tmp, vreinterpretq_f32_u32(mask));
+
+    tmp = vmulq_f32(fx, vdupq_n_f32(c_cephes_exp_C1));
+    float32x4_t z = vmulq_f32(fx, vdupq_n_f32(c_cephes_exp_C2));
+    x = vsubq_f32(x, tmp);
+    x = vsubq_f32(x, z);
+
+    float32x4_t y = vdupq_n_f32(c_cephes_exp_p0);
+    y = vmlaq_f32(vdupq_n_f32(c_cephes_exp_p1), y, x);
+    y = vmlaq_f32(vdupq_n_f32(c_cephes_exp_p2), y, x);
+    y = vmlaq_f32(vdupq_n_f32(c_cephes_exp_p3), y, x);
+    y = vmlaq_f32(vdupq_n_f32(c_cephes_exp_p4), y, x);
+    y = vmlaq_f32(vdupq_n_f32(c_cephes_exp_p5), y, x);
+
+    z = vmulq_f32(x, x);
+    y = vmlaq_f32(x, y, z);
+    y = vaddq_f32(y, one);
+
+    // build 2^n
+    int32x4_t mm = vcvtq_s32_f32(fx);
+    mm = vaddq_s32(mm, vdupq_n_s32(0x7f));
+    mm = vshlq_n_s32(mm, 23);
+    float32x4_t pow2n = vreinterpretq_f32_s32(mm);
+
+    y = vmulq_f32(y, pow2n);
+    return y;
+}
+#elif __SSE2__
+static inline __m128 exp_ps(__m128 x)
+{
+    __m128 tmp, fx;
+
+    __m128 one = _mm_set1_ps(1.f);
+    x = _mm_min_ps(x, _mm_set1_ps(c_exp_hi));
+    x = _mm_max_ps(x, _mm_set1_ps(c_exp_lo));
+
+    // express exp(x) as exp(g + n*log(2))
+    fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(c_cephes_LOG2EF)), _mm_set1_ps(0.5f));
+
+    // perform a floorf
+    tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+
+    // if greater, substract 1
+    __m128 mask = _mm_cmpgt_ps(tmp, fx);
+    mask = _mm_and_ps(mask, one);
+    fx = _mm_sub_ps(tmp, mask);
+
+    tmp = _mm_mul_ps(fx, _mm_set1_ps(c_cephes_exp_C1));
+    __m128 z = _mm_mul_ps(fx, _mm_set1_ps(c_cephes_exp_C2));
+    x = _mm_sub_ps(x, tmp);
+    x = _mm_sub_ps(x, z);
+
+    __m128 y = _mm_set1_ps(c_cephes_exp_p0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(c_cephes_exp_p1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(c_cephes_exp_p2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(c_cephes_exp_p3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(c_cephes_exp_p4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(c_cephes_exp_p5));
+
+    z = _mm_mul_ps(x, x);
+    y = _mm_add_ps(_mm_mul_ps(y, z), x);
+    y = _mm_add_ps(y, one);
+
+    // build 2^n
+    __m128i mm = _mm_cvttps_epi32(fx);
+    mm = _mm_add_epi32(mm, _mm_set1_epi32(0x7f));
+    mm = _mm_slli_epi32(mm, 23);
+    __m128 pow2n = _mm_castsi128_ps(mm);
+
+    y = _mm_mul_ps(y, pow2n);
+    return y;
+}
+#endif
+
+#endif //SimdMath_H
@@ -0,0 +1,95 @@
+//
+// Steady-state streaming of frames of one fixed size
+//
+
+#include "StreamSession.h"
+
+#include <cstdio>
+
+StreamSession::StreamSession(std::shared_ptr<Detector> detector, int width, int height, int letterbox_size,
+                             int num_threads)
+    : detector(std::move(detector)), frame_w(width), frame_h(height)
+{
+    this->letterbox_size = letterbox_size > 0 ? letterbox_size : this->detector->current_target_size();
+    ctx.num_threads = num_threads;
+    ctx.keep_extractor = true;
+    ctx.track_memory = true;
+    ctx.blob_allocator.set_counting(true);
+    ctx.workspace_allocator.set_counting(true);
+}
+
+bool StreamSession::detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result)
+{
+    if (image.width != frame_w || image.height != frame_h)
+    {
+        result.clear();
+        return false;
+    }
+    run(image, threshold, nms_threshold, result);
+    return true;
+}
+
+bool StreamSession::detect(const YuvImageBuffer &image, float threshold, float nms_threshold,
+                           std::vector<BoxInfo> &result)
+{
+    int img_w, img_h;
+    yuv_rotated_size(image, img_w, img_h);
+    if (img_w != frame_w || img_h != frame_h)
+    {
+        result.clear();
+        return false;
+    }
+    run(image, threshold, nms_threshold, result);
+    return true;
+}
+
+void StreamSession::warm_up()
+{
+    std::vector<unsigned char> pixels((size_t) frame_w * frame_h * 4, 0);
+    ImageBuffer image = {pixels.data(), frame_w, frame_h, 0, PIXEL_FORMAT_RGBA};
+    std::vector<BoxInfo> boxes;
+    run(image, 1.f, 0.5f, boxes);
+}
+
+template<typename Image>
+void StreamSession::run(const Image &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result)
+{
+    const uint64_t before = ctx.blob_allocator.allocated_bytes() + ctx.workspace_allocator.allocated_bytes();
+
+    detector->begin_frame(ctx);
+    detector->preprocess(image, ctx, letterbox_size);
+    detector->infer_postprocess(ctx, threshold, nms_threshold, result);
+    detector->end_frame(ctx);
+
+    // a steady stream reuses every block the first frame allocated
+    const uint64_t after = ctx.blob_allocator.allocated_bytes() + ctx.workspace_allocator.allocated_bytes();
+    if (frames.fetch_add(1, std::memory_order_relaxed) > 0 && after != before)
+        grown_frames.fetch_add(1, std::memory_order_relaxed);
+    input_bytes.store(ctx.in_pad.total() * ctx.in_pad.elemsize, std::memory_order_relaxed);
+}
+
+StreamFootprint StreamSession::footprint() const
+{
+    StreamFootprint footprint;
+    footprint.frames = frames.load(std::memory_order_relaxed);
+    footprint.pool_bytes = ctx.blob_allocator.allocated_bytes() + ctx.workspace_allocator.allocated_bytes();
+    footprint.peak_blob_bytes = ctx.blob_allocator.peak_bytes();
+    footprint.peak_workspace_bytes = ctx.workspace_allocator.peak_bytes();
+    footprint.input_bytes = input_bytes.load(std::memory_order_relaxed);
+    footprint.peak_bytes = footprint.peak_blob_bytes + footprint.peak_workspace_bytes + footprint.input_bytes;
+    footprint.grown_frames = grown_frames.load(std::memory_order_relaxed);
+    return footprint;
+}
+
+std::string format_footprint(const StreamFootprint &footprint)
+{
+    char json[320];
+    snprintf(json, sizeof(json),
+             "{\"frames\": %llu, \"pool_bytes\": %llu, \"peak_blob_bytes\": %llu, \"peak_workspace_bytes\": %llu, "
+             "\"input_bytes\": %llu, \"peak_bytes\": %llu, \"grown_frames\": %llu}",
+             (unsigned long long) footprint.frames, (unsigned long long) footprint.pool_bytes,
+             (unsigned long long) footprint.peak_blob_bytes, (unsigned long long) footprint.peak_workspace_bytes,
+             (unsigned long long) footprint.input_bytes, (unsigned long long) footprint.peak_bytes,
+             (unsigned long long) footprint.grown_frames);
+    return json;
+}
@@ -0,0 +1,73 @@
+//
+// Steady-state streaming of frames of one fixed size
+// A session owns a DetectContext for the whole stream: the extractor is created on the first frame and only
+// cleared between frames, the letterbox geometry is fixed, and the blob and workspace pools are sized by the
+// first frame (or warm_up()) and then only reused. The pools count their bytes, so the session knows what
+// the stream holds and notices a frame that still had to allocate.
+// ncnn has no way to pre-allocate the blobs of a net for a shape; running one frame of that shape through the
+// context's pools does the same.
+//
+
+#ifndef StreamSession_H
+#define StreamSession_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Detector.h"
+
+typedef struct StreamFootprint {
+    uint64_t frames;                // warm-up included
+    uint64_t pool_bytes;            // blocks the blob and workspace pools allocated, fixed after the first frame
+    uint64_t peak_blob_bytes;       // most blob memory in use at once
+    uint64_t peak_workspace_bytes;  // same for the layers' scratch memory
+    uint64_t input_bytes;           // letterboxed input tensor
+    uint64_t peak_bytes;            // working set: the two peaks and the input, an upper bound as the peaks
+                                    // need not fall on the same layer
+    uint64_t grown_frames;          // frames after the first that still allocated, 0 for a steady stream
+} StreamFootprint;
+
+// One JSON object, what StreamSession.footprint() returns to the app
+std::string format_footprint(const StreamFootprint &footprint);
+
+// One instance per stream, fed by one thread at a time; footprint() may be called from any thread.
+// The detector may be shared, its adaptive mode does not apply to the session.
+class StreamSession {
+public:
+    // Frames are width x height, camera frames once rotated. letterbox_size 0 takes the detector's current
+    // target, num_threads 0 keeps the net's.
+    StreamSession(std::shared_ptr<Detector> detector, int width, int height, int letterbox_size = 0,
+                  int num_threads = 0);
+
+    // False, with no boxes, for a frame of another size
+    bool detect(const ImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result);
+
+    bool detect(const YuvImageBuffer &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result);
+
+    // Blank first frame, so the pools have their final size before the camera delivers
+    void warm_up();
+
+    StreamFootprint footprint() const;
+
+    int width() const { return frame_w; }
+
+    int height() const { return frame_h; }
+
+private:
+    template<typename Image>
+    void run(const Image &image, float threshold, float nms_threshold, std::vector<BoxInfo> &result);
+
+    std::shared_ptr<Detector> detector;
+    // after the detector, its extractor goes before the net
+    DetectContext ctx;
+    int frame_w;
+    int frame_h;
+    int letterbox_size;
+
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> grown_frames{0};
+    std::atomic<uint64_t> input_bytes{0};
+};
+
+#endif //StreamSession_H
@@ -0,0 +1,131 @@
+//
+// Temporal reuse for video and camera streams
+//
+
+#include "TemporalDetector.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+void KeyFrameScheduler::configure(const TemporalOptions &options)
+{
+    this->options = options;
+    this->options.min_interval = std::max(options.min_interval, 1);
+    this->options.max_interval = std::max(options.max_interval, this->options.min_interval);
+    current_interval = this->options.min_interval;
+    since_key = 0;
+    has_key = false;
+}
+
+// Point sampled thumbnail, a few thousand loads whatever the frame size
+bool KeyFrameScheduler::key_frame(const ImageBuffer &image)
+{
+    const int channels = pixel_format_channels(image.format);
+    const int stride = image_row_stride(image);
+    // green (or gray) weighs most in luma, good enough to see the scene change
+    const int c = channels >= 3 ? 1 : 0;
+    for (int y = 0; y < thumb_size; y++)
+    {
+        const unsigned char *row = image.data + (size_t) ((2 * y + 1) * image.height / (2 * thumb_size)) * stride;
+        for (int x = 0; x < thumb_size; x++)
+            thumb[y * thumb_size + x] = row[(size_t) ((2 * x + 1) * image.width / (2 * thumb_size)) * channels + c];
+    }
+    return decide();
+}
+
+// The Y plane is used as is, in sensor orientation: only the change between frames matters
+bool KeyFrameScheduler::key_frame(const YuvImageBuffer &image)
+{
+    for (int y = 0; y < thumb_size; y++)
+    {
+        const unsigned char *row = image.y + (size_t) ((2 * y + 1) * image.height / (2 * thumb_size)) * image.y_row_stride;
+        for (int x = 0; x < thumb_size; x++)
+            thumb[y * thumb_size + x] = row[(2 * x + 1) * image.width / (2 * thumb_size)];
+    }
+    return decide();
+}
+
+bool KeyFrameScheduler::decide()
+{
+    if (!enabled())
+        return true;
+
+    int diff = 0;
+    if (has_key)
+    {
+        for (int i = 0; i < thumb_size * thumb_size; i++)
+            diff += abs((int) thumb[i] - (int) key_thumb[i]);
+    }
+    const float change = (float) diff / (thumb_size * thumb_size);
+
+    const bool scene_moved = change > options.scene_threshold;
+    if (has_key && !scene_moved && since_key + 1 < current_interval)
+    {
+        since_key++;
+        return false;
+    }
+
+    // a scene that changed before its detection was due needs a shorter cadence, a still one a longer
+    if (scene_moved)
+        current_interval = std::max(current_interval / 2, options.min_interval);
+    else if (has_key && change < options.scene_threshold / 4)
+        current_interval = std::min(current_interval + 1, options.max_interval);
+
+    memcpy(key_thumb, thumb, sizeof(thumb));
+    has_key = true;
+    since_key = 0;
+    return true;
+}
+
+void KeyFrameScheduler::adapt(float track_motion)
+{
+    // objects too small to move the thumbnail still shorten the cadence through their tracks
+    if (track_motion * current_interval > options.track_threshold)
+        current_interval = std::max(current_interval / 2, options.min_interval);
+}
+
+TemporalDetector::TemporalDetector(std::shared_ptr<Detector> detector, const TemporalOptions &options)
+    : detector(std::move(detector)), options(options), tracker(options.tracker)
+{
+    scheduler.configure(options);
+}
+
+void TemporalDetector::reset()
+{
+    scheduler.configure(options);
+    tracker.reset();
+}
+
+template<typename Image>
+bool TemporalDetector::run(const Image &image, int img_w, int img_h, float threshold, float nms_threshold,
+                           std::vector<BoxInfo> &boxes, std::vector<int> &track_ids)
+{
+    num_frames++;
+    tracker.predict();
+    if (!scheduler.key_frame(image))
+    {
+        tracker.current(img_w, img_h, boxes, track_ids);
+        return false;
+    }
+
+    num_key_frames++;
+    detector->detect(image, threshold, nms_threshold, boxes);
+    tracker.update(boxes, track_ids);
+    scheduler.adapt(tracker.motion());
+    return true;
+}
+
+bool TemporalDetector::detect(const ImageBuffer &image, float threshold, float nms_threshold,
+                              std::vector<BoxInfo> &boxes, std::vector<int> &track_ids)
+{
+    return run(image, image.width, image.height, threshold, nms_threshold, boxes, track_ids);
+}
+
+bool TemporalDetector::detect(const YuvImageBuffer &image, float threshold, float nms_threshold,
+                              std::vector<BoxInfo> &boxes, std::vector<int> &track_ids)
+{
+    int img_w, img_h;
+    yuv_rotated_size(image, img_w, img_h);
+    return run(image, img_w, img_h, threshold, nms_threshold, boxes, track_ids);
+}
@@ -0,0 +1,87 @@
+//
+// Temporal reuse for video and camera streams
+// The detector runs on key frames only: every interval frames, or sooner when a 32x32 luma thumbnail of
+// the frame moved away from the one of the last key frame. In between, BoxTracker predicts the boxes.
+// The interval grows while the scene stays still and halves when the scene or the tracked objects move.
+//
+
+#ifndef TemporalDetector_H
+#define TemporalDetector_H
+
+#include <memory>
+#include <vector>
+#include "Detector.h"
+#include "Tracker.h"
+
+typedef struct TemporalOptions {
+    int min_interval = 1;       // frames from one detection to the next while things move
+    int max_interval = 8;       // same for a still scene, <= 1 detects every frame
+    float scene_threshold = 6.f;    // mean absolute luma change of the thumbnail (0-255) forcing a detection
+    float track_threshold = 0.25f;  // predicted object shift over one interval, in box sizes, halving it
+    TrackerOptions tracker;
+} TemporalOptions;
+
+// Decides which frames go through the detector
+class KeyFrameScheduler {
+public:
+    void configure(const TemporalOptions &options);
+
+    bool enabled() const { return options.max_interval > 1; }
+
+    // Thumbnail the frame, true when the detector has to run on it
+    bool key_frame(const ImageBuffer &image);
+
+    bool key_frame(const YuvImageBuffer &image);
+
+    // After a key frame: tracker motion in box sizes per frame
+    void adapt(float track_motion);
+
+    int interval() const { return current_interval; }
+
+private:
+    bool decide();
+
+    static const int thumb_size = 32;
+
+    TemporalOptions options;
+    int current_interval = 1;
+    int since_key = 0;
+    bool has_key = false;
+    unsigned char thumb[thumb_size * thumb_size];
+    unsigned char key_thumb[thumb_size * thumb_size];
+};
+
+// Synchronous temporal mode around a detector, for decoded video
+// One instance per stream, not thread-safe; the detector itself may be shared.
+class TemporalDetector {
+public:
+    TemporalDetector(std::shared_ptr<Detector> detector, const TemporalOptions &options);
+
+    // track_ids[i] is the track of boxes[i], returns whether the detector ran on this frame
+    bool detect(const ImageBuffer &image, float threshold, float nms_threshold,
+                std::vector<BoxInfo> &boxes, std::vector<int> &track_ids);
+
+    bool detect(const YuvImageBuffer &image, float threshold, float nms_threshold,
+                std::vector<BoxInfo> &boxes, std::vector<int> &track_ids);
+
+    // Start over, e.g. after a seek
+    void reset();
+
+    long long frames() const { return num_frames; }
+
+    long long key_frames() const { return num_key_frames; }
+
+private:
+    template<typename Image>
+    bool run(const Image &image, int img_w, int img_h, float threshold, float nms_threshold,
+             std::vector<BoxInfo> &boxes, std::vector<int> &track_ids);
+
+    std::shared_ptr<Detector> detector;
+    TemporalOptions options;
+    KeyFrameScheduler scheduler;
+    BoxTracker tracker;
+    long long num_frames = 0;
+    long long num_key_frames = 0;
+};
+
+#endif //TemporalDetector_H
@@ -0,0 +1,175 @@
+//
+// Sliced inference for high-resolution stills
+//
+
+#include "Tiling.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Tile origins along one axis, evenly spread so the overlap never drops below the requested one
+static void tile_origins(int length, int tile, float overlap, std::vector<int> &origins)
+{
+    origins.clear();
+    if (length <= tile)
+    {
+        origins.push_back(0);
+        return;
+    }
+
+    const int step = std::max((int) (tile * (1.f - overlap)), 1);
+    const int count = (length - tile + step - 1) / step + 1;
+    for (int i = 0; i < count; i++)
+        origins.push_back((int) ((long long) (length - tile) * i / (count - 1)));
+}
+
+void compute_tiles(int img_w, int img_h, int tile_size, float overlap, std::vector<TileRect> &tiles)
+{
+    overlap = std::min(std::max(overlap, 0.f), 0.9f);
+
+    std::vector<int> xs;
+    std::vector<int> ys;
+    tile_origins(img_w, tile_size, overlap, xs);
+    tile_origins(img_h, tile_size, overlap, ys);
+
+    tiles.clear();
+    for (int y : ys)
+    {
+        for (int x : xs)
+        {
+            TileRect tile;
+            tile.x = x;
+            tile.y = y;
+            tile.w = std::min(tile_size, img_w - x);
+            tile.h = std::min(tile_size, img_h - y);
+            tiles.push_back(tile);
+        }
+    }
+}
+
+static void align_span(int &origin, int &length, int limit, int align)
+{
+    origin = std::min(std::max(origin, 0), limit);
+    length = std::min((length + align - 1) / align * align, limit);
+    origin = std::min(origin, limit - length);
+}
+
+void align_tile(TileRect &tile, int img_w, int img_h, int align)
+{
+    align = std::max(align, 1);
+    align_span(tile.x, tile.w, img_w, align);
+    align_span(tile.y, tile.h, img_h, align);
+}
+
+ImageBuffer crop_image(const ImageBuffer &image, const TileRect &tile)
+{
+    const int stride = image_row_stride(image);
+
+    ImageBuffer view = image;
+    view.data = image.data + (size_t) tile.y * stride + (size_t) tile.x * pixel_format_channels(image.format);
+    view.width = tile.w;
+    view.height = tile.h;
+    view.stride = stride;
+    return view;
+}
+
+static inline float intersection_over_smaller(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+
+    const float smaller = std::min(a.w * a.h, b.w * b.h);
+    return smaller > 0.f ? iw * ih / smaller : 0.f;
+}
+
+static inline float intersection_over_union(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+
+    const float inter = iw * ih;
+    const float area_union = a.w * a.h + b.w * b.h - inter;
+    return area_union > 0.f ? inter / area_union : 0.f;
+}
+
+TileBoxSource tile_box_source(const BoxInfo &box, const TileRect &tile, int tile_index, int img_w, int img_h)
+{
+    // a detector rarely puts the edge of a truncated object exactly on the border
+    const float margin = std::max(2.f, 0.01f * std::max(tile.w, tile.h));
+
+    TileBoxSource source;
+    source.tile = tile_index;
+    source.cut = (tile.x > 0 && box.x1 <= tile.x + margin)
+                 || (tile.x + tile.w < img_w && box.x1 + box.w >= tile.x + tile.w - margin)
+                 || (tile.y > 0 && box.y1 <= tile.y + margin)
+                 || (tile.y + tile.h < img_h && box.y1 + box.h >= tile.y + tile.h - margin);
+    return source;
+}
+
+void merge_tile_boxes(std::vector<BoxInfo> &boxes, const std::vector<TileBoxSource> &sources, TileMerge merge,
+                      float seam_threshold, float iou_threshold)
+{
+    // label first, then score, so clusters are searched inside one label only
+    const int n = (int) boxes.size();
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&boxes](int a, int b) {
+        return boxes[a].label != boxes[b].label ? boxes[a].label < boxes[b].label : boxes[a].score > boxes[b].score;
+    });
+
+    std::vector<char> merged(n, 0);
+    std::vector<int> cluster_tiles;
+    std::vector<BoxInfo> kept;
+    for (int oi = 0; oi < n; oi++)
+    {
+        const int i = order[oi];
+        if (merged[i])
+            continue;
+
+        // matching against the original best box keeps clusters from chaining across the image
+        const BoxInfo &leader = boxes[i];
+        float x0 = leader.x1;
+        float y0 = leader.y1;
+        float x1 = leader.x1 + leader.w;
+        float y1 = leader.y1 + leader.h;
+        cluster_tiles.assign(1, sources[i].tile);
+        for (int oj = oi + 1; oj < n && boxes[order[oj]].label == leader.label; oj++)
+        {
+            const int j = order[oj];
+            // two boxes of one tile are two objects, that tile's NMS kept both
+            if (merged[j] || std::find(cluster_tiles.begin(), cluster_tiles.end(), sources[j].tile) != cluster_tiles.end())
+                continue;
+
+            const bool seam = sources[i].cut || sources[j].cut;
+            const bool match = seam ? intersection_over_smaller(leader, boxes[j]) > seam_threshold
+                                    : intersection_over_union(leader, boxes[j]) > iou_threshold;
+            if (!match)
+                continue;
+
+            merged[j] = 1;
+            cluster_tiles.push_back(sources[j].tile);
+            if (merge == TILE_MERGE_UNION && seam)
+            {
+                x0 = std::min(x0, boxes[j].x1);
+                y0 = std::min(y0, boxes[j].y1);
+                x1 = std::max(x1, boxes[j].x1 + boxes[j].w);
+                y1 = std::max(y1, boxes[j].y1 + boxes[j].h);
+            }
+        }
+
+        BoxInfo box = leader;
+        box.x1 = x0;
+        box.y1 = y0;
+        box.w = x1 - x0;
+        box.h = y1 - y0;
+        kept.push_back(box);
+    }
+
+    std::stable_sort(kept.begin(), kept.end(), [](const BoxInfo &a, const BoxInfo &b) { return a.score > b.score; });
+    boxes.swap(kept);
+}
@@ -0,0 +1,61 @@
+//
+// Sliced inference for high-resolution stills
+// The image is cut into overlapping tiles at the model's native size, so small objects keep their pixels
+// instead of being squeezed into a single 640 / 320 letterbox. Tiles are zero-copy views of the image,
+// so the memory used is the contexts of the workers whatever the resolution.
+//
+
+#ifndef Tiling_H
+#define Tiling_H
+
+#include <vector>
+#include "Common.h"
+
+enum TileMerge {
+    TILE_MERGE_NMS = 0,         // keep the best box of every cluster
+    TILE_MERGE_UNION,           // grow the best box to enclose the seam-cut boxes of its cluster
+};
+
+typedef struct TileOptions {
+    int tile_size = 0;          // tile side in image pixels, 0 uses the model's target size (no downscaling)
+    float overlap = 0.2f;       // fraction of a tile shared with each neighbour
+    int max_tiles = 64;         // tiles grow until the grid fits, bounds the work on very large images
+    bool global_pass = true;    // also run the whole image, for objects larger than a tile
+    TileMerge merge = TILE_MERGE_NMS;
+    float merge_threshold = 0.5f;   // intersection over the smaller box for a pair where a seam cuts one of them
+    int num_workers = 0;        // extractors running tiles in parallel, as detect_batch
+} TileOptions;
+
+typedef struct TileRect {
+    int x;
+    int y;
+    int w;
+    int h;
+} TileRect;
+
+// Grid of tile_size tiles overlapping by overlap, the last row and column end on the image border
+void compute_tiles(int img_w, int img_h, int tile_size, float overlap, std::vector<TileRect> &tiles);
+
+// Grow the tile to multiples of align, shifted back inside the image where it would cross the border
+void align_tile(TileRect &tile, int img_w, int img_h, int align);
+
+// Zero-copy view of a tile
+ImageBuffer crop_image(const ImageBuffer &image, const TileRect &tile);
+
+// Where a box of a tiled detection comes from
+typedef struct TileBoxSource {
+    int tile;                   // index of its tile, the global pass counts as one
+    bool cut;                   // touches a border of its tile inside the image, the object may go on past it
+} TileBoxSource;
+
+// Source of a box of tile tile_index, box in image coordinates
+TileBoxSource tile_box_source(const BoxInfo &box, const TileRect &tile, int tile_index, int img_w, int img_h);
+
+// Fuse the duplicates the tile overlaps produce, per label; sources[i] belongs to boxes[i].
+// Only boxes of different tiles are fused, each tile already ran its own NMS: a pair matches with an
+// intersection over the smaller box above seam_threshold when one of them is cut by a seam, with an IoU above
+// iou_threshold otherwise, and a cluster takes at most one box of every tile. Sorted by descending score on return.
+void merge_tile_boxes(std::vector<BoxInfo> &boxes, const std::vector<TileBoxSource> &sources, TileMerge merge,
+                      float seam_threshold, float iou_threshold);
+
+#endif //Tiling_H
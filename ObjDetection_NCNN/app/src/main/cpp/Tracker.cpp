@@ -0,0 +1,214 @@
+//
+// Box tracker for the frames the detector skips
+//
+
+#include "Tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+// DeepSORT noise weights, relative to the box size
+static const float std_weight_position = 1.f / 20;
+static const float std_weight_velocity = 1.f / 160;
+
+static inline float box_iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+
+    const float inter = iw * ih;
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+BoxTracker::BoxTracker(const TrackerOptions &options)
+    : options(options)
+{
+}
+
+void BoxTracker::reset()
+{
+    tracks.clear();
+    next_id = 0;
+}
+
+void BoxTracker::init_filter(Filter &f, float z, float size)
+{
+    const float sp = 2 * std_weight_position * size;
+    const float sv = 10 * std_weight_velocity * size;
+    f.pos = z;
+    f.vel = 0.f;
+    f.p00 = sp * sp;
+    f.p01 = 0.f;
+    f.p11 = sv * sv;
+}
+
+void BoxTracker::predict_filter(Filter &f, float size)
+{
+    const float qp = std_weight_position * size;
+    const float qv = std_weight_velocity * size;
+
+    // x = F x, P = F P F' + Q with F = [1 1; 0 1]
+    f.pos += f.vel;
+    f.p00 += 2 * f.p01 + f.p11 + qp * qp;
+    f.p01 += f.p11;
+    f.p11 += qv * qv;
+}
+
+void BoxTracker::update_filter(Filter &f, float z, float size)
+{
+    const float r = std_weight_position * size;
+
+    const float s = f.p00 + r * r;
+    const float k0 = f.p00 / s;
+    const float k1 = f.p01 / s;
+    const float y = z - f.pos;
+
+    f.pos += k0 * y;
+    f.vel += k1 * y;
+    // P = (I - K H) P
+    f.p11 -= k1 * f.p01;
+    f.p00 *= 1.f - k0;
+    f.p01 *= 1.f - k0;
+}
+
+BoxInfo BoxTracker::track_box(const Track &track)
+{
+    const float w = std::max(track.f[2].pos, 1.f);
+    const float h = std::max(track.f[3].pos, 1.f);
+
+    BoxInfo box;
+    box.x1 = track.f[0].pos - w / 2;
+    box.y1 = track.f[1].pos - h / 2;
+    box.w = w;
+    box.h = h;
+    box.score = track.score;
+    box.label = track.label;
+    return box;
+}
+
+void BoxTracker::predict()
+{
+    for (Track &track : tracks)
+    {
+        const float size = std::max(track.f[2].pos, track.f[3].pos);
+        for (int k = 0; k < 4; k++)
+            predict_filter(track.f[k], size);
+    }
+}
+
+void BoxTracker::update(const std::vector<BoxInfo> &detections, std::vector<int> &track_ids)
+{
+    const int num_tracks = (int) tracks.size();
+    const int num_detections = (int) detections.size();
+
+    matches.clear();
+    for (int t = 0; t < num_tracks; t++)
+    {
+        const BoxInfo predicted = track_box(tracks[t]);
+        for (int d = 0; d < num_detections; d++)
+        {
+            if (detections[d].label != predicted.label)
+                continue;
+
+            const float iou = box_iou(predicted, detections[d]);
+            if (iou >= options.match_iou)
+                matches.push_back({iou, t, d});
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) { return a.iou > b.iou; });
+
+    track_used.assign(num_tracks, 0);
+    detection_used.assign(num_detections, 0);
+    track_ids.assign(num_detections, -1);
+    for (const Match &match : matches)
+    {
+        if (track_used[match.track] || detection_used[match.detection])
+            continue;
+
+        track_used[match.track] = 1;
+        detection_used[match.detection] = 1;
+
+        Track &track = tracks[match.track];
+        const BoxInfo &box = detections[match.detection];
+        const float z[4] = {box.x1 + box.w / 2, box.y1 + box.h / 2, box.w, box.h};
+        const float size = std::max(box.w, box.h);
+        for (int k = 0; k < 4; k++)
+            update_filter(track.f[k], z[k], size);
+        track.score = box.score;
+        track.misses = 0;
+        track_ids[match.detection] = track.id;
+    }
+
+    for (int t = 0; t < num_tracks; t++)
+    {
+        if (!track_used[t])
+            tracks[t].misses++;
+    }
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                [this](const Track &track) { return track.misses > options.max_misses; }),
+                 tracks.end());
+
+    for (int d = 0; d < num_detections; d++)
+    {
+        if (detection_used[d])
+            continue;
+
+        const BoxInfo &box = detections[d];
+        const float z[4] = {box.x1 + box.w / 2, box.y1 + box.h / 2, box.w, box.h};
+        const float size = std::max(box.w, box.h);
+
+        Track track;
+        track.id = next_id++;
+        track.label = box.label;
+        track.score = box.score;
+        track.misses = 0;
+        for (int k = 0; k < 4; k++)
+            init_filter(track.f[k], z[k], size);
+        tracks.push_back(track);
+        track_ids[d] = track.id;
+    }
+}
+
+void BoxTracker::current(int img_w, int img_h, std::vector<BoxInfo> &boxes, std::vector<int> &track_ids) const
+{
+    boxes.clear();
+    track_ids.clear();
+    for (const Track &track : tracks)
+    {
+        if (track.misses > 0)
+            continue;
+
+        BoxInfo box = track_box(track);
+        const float x0 = std::max(box.x1, 0.f);
+        const float y0 = std::max(box.y1, 0.f);
+        const float x1 = std::min(box.x1 + box.w, (float) img_w);
+        const float y1 = std::min(box.y1 + box.h, (float) img_h);
+        if (x1 - x0 < 1.f || y1 - y0 < 1.f)
+            continue;
+
+        box.x1 = x0;
+        box.y1 = y0;
+        box.w = x1 - x0;
+        box.h = y1 - y0;
+        boxes.push_back(box);
+        track_ids.push_back(track.id);
+    }
+}
+
+float BoxTracker::motion() const
+{
+    float sum = 0.f;
+    int count = 0;
+    for (const Track &track : tracks)
+    {
+        if (track.misses > 0)
+            continue;
+
+        const float size = std::max(std::max(track.f[2].pos, track.f[3].pos), 1.f);
+        sum += std::sqrt(track.f[0].vel * track.f[0].vel + track.f[1].vel * track.f[1].vel) / size;
+        count++;
+    }
+    return count > 0 ? sum / count : 0.f;
+}
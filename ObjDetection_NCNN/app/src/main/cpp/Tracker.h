@@ -0,0 +1,78 @@
+//
+// Box tracker for the frames the detector skips
+// Every track runs a constant velocity Kalman filter on its center and size (one 2-state filter per
+// coordinate, noise scaled with the box size as in SORT / DeepSORT), detections of a key frame are
+// assigned to tracks greedily by IoU. Track ids stay the same for as long as an object keeps being detected.
+//
+
+#ifndef Tracker_H
+#define Tracker_H
+
+#include <vector>
+#include "Common.h"
+
+typedef struct TrackerOptions {
+    float match_iou = 0.3f;     // smallest IoU between a predicted track and a detection of the same label
+    int max_misses = 1;         // key frames a track survives without being detected
+} TrackerOptions;
+
+class BoxTracker {
+public:
+    explicit BoxTracker(const TrackerOptions &options = TrackerOptions());
+
+    void reset();
+
+    // Advance every track by one frame
+    void predict();
+
+    // Correct the tracks with the detections of a key frame, track_ids[i] is the track of detections[i]
+    void update(const std::vector<BoxInfo> &detections, std::vector<int> &track_ids);
+
+    // Predicted boxes of the tracks detected on the last key frame, clipped to the image
+    void current(int img_w, int img_h, std::vector<BoxInfo> &boxes, std::vector<int> &track_ids) const;
+
+    // Mean speed of the tracks in box sizes per frame
+    float motion() const;
+
+private:
+    // position and velocity of one coordinate, with their covariance
+    struct Filter {
+        float pos;
+        float vel;
+        float p00;
+        float p01;
+        float p11;
+    };
+
+    struct Track {
+        int id;
+        int label;
+        float score;
+        int misses;
+        Filter f[4];            // center x, center y, width, height
+    };
+
+    static void init_filter(Filter &f, float z, float size);
+
+    static void predict_filter(Filter &f, float size);
+
+    static void update_filter(Filter &f, float z, float size);
+
+    static BoxInfo track_box(const Track &track);
+
+    TrackerOptions options;
+    std::vector<Track> tracks;
+    int next_id = 0;
+
+    // association scratch, kept between key frames
+    struct Match {
+        float iou;
+        int track;
+        int detection;
+    };
+    std::vector<Match> matches;
+    std::vector<char> track_used;
+    std::vector<char> detection_used;
+};
+
+#endif //Tracker_H
@@ -0,0 +1,61 @@
+//
+// Small helpers shared by the host benchmarks
+//
+
+#ifndef BenchUtils_H
+#define BenchUtils_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Common.h"
+
+static inline double get_current_time()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+}
+
+// Run fn `loops` times after a short warm-up and print min / max / avg in milliseconds
+template<typename Func>
+static double benchmark(const char *name, int loops, Func &&fn)
+{
+    for (int i = 0; i < 3; i++)
+        fn();
+
+    double time_min = 1e300;
+    double time_max = 0;
+    double time_avg = 0;
+    for (int i = 0; i < loops; i++)
+    {
+        double start = get_current_time();
+        fn();
+        double end = get_current_time();
+
+        double time = end - start;
+        time_min = std::min(time_min, time);
+        time_max = std::max(time_max, time);
+        time_avg += time;
+    }
+    time_avg /= loops;
+
+    fprintf(stderr, "%-32s  min = %8.3f  max = %8.3f  avg = %8.3f\n", name, time_min, time_max, time_avg);
+    return time_avg;
+}
+
+static inline bool same_boxes(const std::vector<BoxInfo> &a, const std::vector<BoxInfo> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].label != b[i].label || memcmp(&a[i].x1, &b[i].x1, sizeof(float) * 5) != 0)
+            return false;
+    }
+    return true;
+}
+
+#endif //BenchUtils_H
@@ -0,0 +1,112 @@
+//
+// Stand-in detector finding bright rectangles in the letterboxed input
+// A rectangle has to be at least 3 px on both sides of the input, like a real detector loses objects that
+// the letterbox shrinks below its smallest stride. A box cut by the input border is less confident,
+// as a truncated object is. Each call of infer() can also wait, to stand in for the cost of a network:
+// infer_ms for a target_size x target_size input, in proportion to the input area with scale_with_input.
+//
+
+#ifndef RectDetector_H
+#define RectDetector_H
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Detector.h"
+
+class RectDetector : public Detector {
+public:
+    explicit RectDetector(double infer_ms = 0.0, bool scale_with_input = false)
+        : infer_ms(infer_ms), scale_with_input(scale_with_input)
+    {
+        target_size = 320;
+        max_stride = 32;
+        to_bgr = false;
+        pad_value = 0.f;
+    }
+
+    void infer(DetectContext &ctx) const override
+    {
+        double ms = infer_ms;
+        if (scale_with_input)
+            ms = ms * ctx.in_pad.w * ctx.in_pad.h / (target_size * target_size);
+        if (ms > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds((long long) (ms * 1000)));
+
+        ctx.outputs.resize(1);
+        ctx.outputs[0] = ctx.in_pad.channel(0).clone();
+    }
+
+protected:
+    void decode(DetectContext &ctx, float threshold) const override
+    {
+        const ncnn::Mat &plane = ctx.outputs[0];
+        const int w = plane.w;
+        const int h = plane.h;
+        const int x_begin = ctx.letterbox.wpad / 2;
+        const int y_begin = ctx.letterbox.hpad / 2;
+        const int x_end = x_begin + ctx.letterbox.w;
+        const int y_end = y_begin + ctx.letterbox.h;
+
+        std::vector<char> seen(w * h, 0);
+        std::vector<int> stack;
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                if (seen[y * w + x] || plane.row(y)[x] < 128.f)
+                    continue;
+
+                // bounding box of the bright component
+                int x0 = x, y0 = y, x1 = x, y1 = y;
+                seen[y * w + x] = 1;
+                stack.assign(1, y * w + x);
+                while (!stack.empty())
+                {
+                    const int i = stack.back();
+                    stack.pop_back();
+                    const int cx = i % w;
+                    const int cy = i / w;
+                    x0 = std::min(x0, cx);
+                    y0 = std::min(y0, cy);
+                    x1 = std::max(x1, cx);
+                    y1 = std::max(y1, cy);
+
+                    const int nx[4] = {cx - 1, cx + 1, cx, cx};
+                    const int ny[4] = {cy, cy, cy - 1, cy + 1};
+                    for (int k = 0; k < 4; k++)
+                    {
+                        if (nx[k] < 0 || ny[k] < 0 || nx[k] >= w || ny[k] >= h)
+                            continue;
+                        const int j = ny[k] * w + nx[k];
+                        if (!seen[j] && plane.row(ny[k])[nx[k]] >= 128.f)
+                        {
+                            seen[j] = 1;
+                            stack.push_back(j);
+                        }
+                    }
+                }
+
+                if (x1 - x0 + 1 < 3 || y1 - y0 + 1 < 3)
+                    continue;
+
+                const bool cut = x0 <= x_begin || y0 <= y_begin || x1 >= x_end - 1 || y1 >= y_end - 1;
+                BoxInfo box;
+                box.x1 = (float) x0;
+                box.y1 = (float) y0;
+                box.w = (float) (x1 - x0 + 1);
+                box.h = (float) (y1 - y0 + 1);
+                box.score = cut ? 0.6f : 0.9f;
+                box.label = 0;
+                if (box.score >= threshold)
+                    ctx.proposals.push_back(box);
+            }
+        }
+    }
+
+private:
+    double infer_ms;
+    bool scale_with_input;
+};
+
+#endif //RectDetector_H
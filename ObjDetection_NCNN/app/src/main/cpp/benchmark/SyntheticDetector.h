@@ -0,0 +1,76 @@
+//
+// Stand-in for a network when benchmarking the scheduling around it on a host without model files
+// infer() waits a fixed time, like the CPU does while a Vulkan queue runs the model, and hands
+// NanoDet-Plus shaped outputs to the real decoder. With scale_with_input the wait grows with the
+// input area like a real network, relative to a target_size x target_size input.
+//
+
+#ifndef SyntheticDetector_H
+#define SyntheticDetector_H
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include "Decoder.h"
+#include "Detector.h"
+
+class SyntheticDetector : public Detector {
+public:
+    SyntheticDetector(double infer_ms, std::mt19937 &rng, bool scale_with_input = false)
+        : infer_ms(infer_ms), scale_with_input(scale_with_input)
+    {
+        target_size = 320;
+        max_stride = 64;
+        to_bgr = true;
+        pad_value = 0.f;
+
+        std::normal_distribution<float> background(-6.f, 1.5f);
+        std::normal_distribution<float> distance(0.f, 3.f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        for (int s = 0; s < 4; s++)
+        {
+            int grid = 320 / strides[s];
+            preds[s].create(grid, grid, num_class + 32);
+            for (int q = 0; q < preds[s].c; q++)
+            {
+                float *ptr = preds[s].channel(q);
+                for (int i = 0; i < grid * grid; i++)
+                    ptr[i] = q < num_class ? (uniform(rng) < 0.002f ? 2.f : background(rng)) : distance(rng);
+            }
+        }
+    }
+
+    void infer(DetectContext &ctx) const override
+    {
+        double ms = infer_ms * slowdown.load();
+        if (scale_with_input)
+            ms = ms * ctx.in_pad.w * ctx.in_pad.h / (target_size * target_size);
+        std::this_thread::sleep_for(std::chrono::microseconds((long long) (ms * 1000)));
+
+        ctx.outputs.resize(4);
+        for (int s = 0; s < 4; s++)
+            ctx.outputs[s] = preds[s];
+    }
+
+    // thermal throttling: every infer() takes factor times longer
+    void set_slowdown(double factor) { slowdown = factor; }
+
+protected:
+    void decode(DetectContext &ctx, float threshold) const override
+    {
+        for (int s = 0; s < 4; s++)
+            generate_proposals_nanodet(ctx.outputs[s], strides[s], num_class, threshold, ctx.proposals);
+    }
+
+private:
+    const int num_class = 80;
+    const int strides[4] = {8, 16, 32, 64};
+    double infer_ms;
+    bool scale_with_input;
+    std::atomic<double> slowdown{1.0};
+    ncnn::Mat preds[4];
+};
+
+#endif //SyntheticDetector_H
@@ -0,0 +1,91 @@
+//
+// Adaptive input resolution under thermal throttling
+// A synthetic network whose cost follows the input area is slowed down 2x halfway through a camera
+// stream; the fixed resolution falls behind the frame budget, the adaptive mode steps down the ladder
+// and comes back up once the device recovers
+//
+
+#include "BenchUtils.h"
+#include "SyntheticDetector.h"
+
+struct PhaseStats {
+    int frames = 0;
+    int within_budget = 0;
+    double total_ms = 0.0;
+    int min_size = 1 << 30;
+    int max_size = 0;
+};
+
+int main(int argc, char **argv)
+{
+    int frames_per_phase = argc > 1 ? atoi(argv[1]) : 40;
+
+    const float budget_ms = 25.f;
+    const double infer_ms = 30.0;       // at a full 320 x 320 input, a 16:9 frame letterboxes to 320 x 192
+
+    std::mt19937 rng(20240602);
+    std::uniform_int_distribution<int> noise(0, 255);
+
+    const int width = 1280;
+    const int height = 720;
+    std::vector<unsigned char> rgba((size_t) width * height * 4);
+    for (auto &v : rgba)
+        v = (unsigned char) noise(rng);
+
+    ImageBuffer image;
+    image.data = rgba.data();
+    image.width = width;
+    image.height = height;
+    image.stride = 0;
+    image.format = PIXEL_FORMAT_RGBA;
+
+    const char *phase_names[3] = {"nominal", "throttled x2", "recovered"};
+    const double slowdowns[3] = {1.0, 2.0, 1.0};
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        SyntheticDetector detector(infer_ms, rng, true);
+        if (mode == 1)
+        {
+            AdaptiveOptions options;
+            options.target_ms = budget_ms;
+            options.window = 4;
+            detector.set_adaptive(options);
+
+            double start = get_current_time();
+            detector.warm_up(width, height);
+            fprintf(stderr, "adaptive, warm-up %.1f ms\n", get_current_time() - start);
+        }
+        else
+        {
+            fprintf(stderr, "fixed size\n");
+        }
+
+        std::vector<BoxInfo> result;
+        for (int phase = 0; phase < 3; phase++)
+        {
+            detector.set_slowdown(slowdowns[phase]);
+
+            PhaseStats stats;
+            for (int i = 0; i < frames_per_phase; i++)
+            {
+                int size = detector.current_target_size();
+                double start = get_current_time();
+                detector.detect(image, 0.4f, 0.6f, result);
+                double ms = get_current_time() - start;
+
+                stats.frames++;
+                stats.within_budget += ms <= budget_ms;
+                stats.total_ms += ms;
+                stats.min_size = std::min(stats.min_size, size);
+                stats.max_size = std::max(stats.max_size, size);
+            }
+
+            fprintf(stderr, "  %-13s %6.2f ms/frame, %3d%% within %.0f ms, size %d..%d\n", phase_names[phase],
+                    stats.total_ms / stats.frames, stats.within_budget * 100 / stats.frames, budget_ms,
+                    stats.min_size, stats.max_size);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+//
+// Steady-state heap allocations of detect() on RGBA and camera frames
+// Build the core with -DOBJDET_COUNT_ALLOCATIONS=ON; the network is replaced by SyntheticDetector
+// (no ncnn extractor), so every allocation counted here comes from the detector itself
+//
+
+#include "AllocCounter.h"
+#include "BenchUtils.h"
+#include "SyntheticDetector.h"
+
+int main(int argc, char **argv)
+{
+    int num_frames = argc > 1 ? atoi(argv[1]) : 30;
+
+    if (!alloc_counter_enabled())
+    {
+        fprintf(stderr, "built without OBJDET_COUNT_ALLOCATIONS, nothing to count\n");
+        return 0;
+    }
+
+    std::mt19937 rng(20240602);
+    std::uniform_int_distribution<int> noise(0, 255);
+
+    const int width = 1280;
+    const int height = 720;
+    std::vector<unsigned char> rgba((size_t) width * height * 4);
+    std::vector<unsigned char> nv21((size_t) width * height * 3 / 2);
+    for (auto &v : rgba)
+        v = (unsigned char) noise(rng);
+    for (auto &v : nv21)
+        v = (unsigned char) noise(rng);
+
+    ImageBuffer image;
+    image.data = rgba.data();
+    image.width = width;
+    image.height = height;
+    image.stride = 0;
+    image.format = PIXEL_FORMAT_RGBA;
+
+    YuvImageBuffer yuv;
+    yuv.y = nv21.data();
+    yuv.v = yuv.y + (size_t) width * height;
+    yuv.u = yuv.v + 1;
+    yuv.width = width;
+    yuv.height = height;
+    yuv.y_row_stride = width;
+    yuv.uv_row_stride = width;
+    yuv.uv_pixel_stride = 2;
+    yuv.rotation = 90;
+
+    SyntheticDetector detector(0.0, rng);
+    std::vector<BoxInfo> result;
+
+    // first frames size the context, the tables and the proposal buffers
+    long long warmup = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        AllocScope scope;
+        detector.detect(image, 0.4f, 0.6f, result);
+        detector.detect(yuv, 0.4f, 0.6f, result);
+        warmup += scope.count();
+    }
+
+    long long rgba_allocs = 0;
+    long long yuv_allocs = 0;
+    for (int i = 0; i < num_frames; i++)
+    {
+        AllocScope rgba_scope;
+        detector.detect(image, 0.4f, 0.6f, result);
+        rgba_allocs += rgba_scope.count();
+
+        AllocScope yuv_scope;
+        detector.detect(yuv, 0.4f, 0.6f, result);
+        yuv_allocs += yuv_scope.count();
+    }
+
+    fprintf(stderr, "warm-up: %lld allocations\n", warmup);
+    fprintf(stderr, "steady state, %d frames: rgba %lld, yuv %lld allocations\n", num_frames, rgba_allocs, yuv_allocs);
+    if (rgba_allocs != 0 || yuv_allocs != 0)
+    {
+        fprintf(stderr, "detect() allocates in steady state\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+//
+// Batched detection: sequential detect() vs detect_batch() with an extractor pool
+// Usage: bench_batch [num_images] [nanodet.param nanodet.bin]
+// Without model files the network is replaced by SyntheticDetector
+//
+
+#include <memory>
+#include "BenchUtils.h"
+#include "NanoDetPlus.h"
+#include "SyntheticDetector.h"
+
+int main(int argc, char **argv)
+{
+    int num_images = argc > 1 ? atoi(argv[1]) : 48;
+
+    std::mt19937 rng(20240602);
+    std::uniform_int_distribution<int> noise(0, 255);
+
+    std::unique_ptr<Detector> detector;
+    if (argc > 3)
+    {
+        NanoDetPlus *model = new NanoDetPlus(argv[2], argv[3], false, 0);
+        detector.reset(model);
+        if (model->load_error() != LOAD_OK)
+        {
+            fprintf(stderr, "%s: %s\n", argv[2], load_error_string(model->load_error()));
+            return -1;
+        }
+    }
+    else
+        detector.reset(new SyntheticDetector(5.0, rng));
+
+    // gallery-like mix of landscape and portrait photos
+    const int sizes[4][2] = {{1920, 1080}, {1080, 1920}, {1280, 720}, {640, 480}};
+    std::vector<std::vector<unsigned char>> pixels(num_images);
+    std::vector<ImageBuffer> images(num_images);
+    for (int i = 0; i < num_images; i++)
+    {
+        const int *size = sizes[rng() % 4];
+        pixels[i].resize((size_t) size[0] * size[1] * 4);
+        for (auto &v : pixels[i])
+            v = (unsigned char) noise(rng);
+
+        images[i].data = pixels[i].data();
+        images[i].width = size[0];
+        images[i].height = size[1];
+        images[i].stride = 0;
+        images[i].format = PIXEL_FORMAT_RGBA;
+    }
+
+    std::vector<std::vector<BoxInfo>> sequential(num_images);
+    auto run_sequential = [&]() {
+        for (int i = 0; i < num_images; i++)
+            sequential[i] = detector->detect(images[i], 0.4f, 0.6f);
+    };
+
+    std::vector<std::vector<BoxInfo>> batched;
+    run_sequential();
+    detector->detect_batch(images, 0.4f, 0.6f, batched);
+    for (int i = 0; i < num_images; i++)
+    {
+        if (!same_boxes(sequential[i], batched[i]))
+        {
+            fprintf(stderr, "image %d differs between detect() and detect_batch()\n", i);
+            return -1;
+        }
+    }
+
+    fprintf(stderr, "%d images\n", num_images);
+    double time_sequential = benchmark("  sequential detect()", 3, run_sequential);
+    fprintf(stderr, "  %.2f images/s\n", num_images * 1000.0 / time_sequential);
+
+    const int worker_counts[3] = {1, 2, 4};
+    for (int workers : worker_counts)
+    {
+        char name[64];
+        sprintf(name, "  detect_batch(), %d workers", workers);
+        double time_batch = benchmark(name, 3, [&]() {
+            detector->detect_batch(images, 0.4f, 0.6f, batched, workers);
+        });
+        fprintf(stderr, "  %.2f images/s, speedup x%.2f\n", num_images * 1000.0 / time_batch, time_sequential / time_batch);
+    }
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+//
+// Layer profiling: whether the wrapped layers compute the same and how much the timing costs
+// Usage: bench_layer_profile [runs]
+// A small chain of stand-in layers, one per forward entry point ncnn calls: a convolution-like layer writing a
+// new blob, an in-place activation, a two-input sum and a two-output split. The chain runs through a plain copy
+// and through a profiled one; outputs must match bit for bit, every layer must be counted once per run, and
+// the report has to list the slowest layer first. Then times the chain plain, wrapped with timing off and on.
+//
+
+#include <cmath>
+#include "BenchUtils.h"
+#include "LayerProfiler.h"
+
+// Weighted sum of 3 x 3 neighbourhoods into out_c channels, the slow layer of the chain
+class StandInConv : public ncnn::Layer {
+public:
+    explicit StandInConv(int out_c)
+        : out_c(out_c)
+    {
+        one_blob_only = true;
+        support_inplace = false;
+    }
+
+    int forward(const ncnn::Mat &bottom_blob, ncnn::Mat &top_blob, const ncnn::Option &opt) const override
+    {
+        const int w = bottom_blob.w;
+        const int h = bottom_blob.h;
+        top_blob.create(w, h, out_c, 4u, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+        for (int q = 0; q < out_c; q++)
+        {
+            float *out = top_blob.channel(q);
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    float sum = 0.f;
+                    for (int p = 0; p < bottom_blob.c; p++)
+                    {
+                        const float *in = bottom_blob.channel(p);
+                        for (int dy = -1; dy <= 1; dy++)
+                        {
+                            const int yy = std::min(std::max(y + dy, 0), h - 1);
+                            for (int dx = -1; dx <= 1; dx++)
+                            {
+                                const int xx = std::min(std::max(x + dx, 0), w - 1);
+                                sum += in[yy * w + xx] * (0.01f * (q + 1) + 0.001f * (p + dy + 2 * dx));
+                            }
+                        }
+                    }
+                    out[y * w + x] = sum;
+                }
+            }
+        }
+        return 0;
+    }
+
+private:
+    int out_c;
+};
+
+class StandInActivation : public ncnn::Layer {
+public:
+    StandInActivation()
+    {
+        one_blob_only = true;
+        support_inplace = true;
+    }
+
+    int forward_inplace(ncnn::Mat &bottom_top_blob, const ncnn::Option &opt) const override
+    {
+        float *data = bottom_top_blob;
+        const size_t n = bottom_top_blob.total();
+        for (size_t i = 0; i < n; i++)
+            data[i] = data[i] / (1.f + std::exp(-data[i]));
+        return 0;
+    }
+};
+
+class StandInSum : public ncnn::Layer {
+public:
+    StandInSum()
+    {
+        one_blob_only = false;
+        support_inplace = false;
+    }
+
+    int forward(const std::vector<ncnn::Mat> &bottom_blobs, std::vector<ncnn::Mat> &top_blobs,
+                const ncnn::Option &opt) const override
+    {
+        const ncnn::Mat &a = bottom_blobs[0];
+        const ncnn::Mat &b = bottom_blobs[1];
+        top_blobs[0].create(a.w, a.h, a.c, 4u, opt.blob_allocator);
+        const size_t n = a.total();
+        for (size_t i = 0; i < n; i++)
+            ((float *) top_blobs[0])[i] = ((const float *) a)[i] + ((const float *) b)[i];
+        return 0;
+    }
+};
+
+// Halves the values in place and keeps a copy of the first channel as a second output
+class StandInSplit : public ncnn::Layer {
+public:
+    StandInSplit()
+    {
+        one_blob_only = false;
+        support_inplace = true;
+    }
+
+    int forward_inplace(std::vector<ncnn::Mat> &bottom_top_blobs, const ncnn::Option &opt) const override
+    {
+        ncnn::Mat &blob = bottom_top_blobs[0];
+        const size_t n = blob.total();
+        for (size_t i = 0; i < n; i++)
+            ((float *) blob)[i] *= 0.5f;
+        bottom_top_blobs[1] = blob.channel(0).clone(opt.blob_allocator);
+        return 0;
+    }
+};
+
+static std::vector<ncnn::Layer *> make_chain()
+{
+    std::vector<ncnn::Layer *> layers = {new StandInConv(16), new StandInActivation(), new StandInConv(16),
+                                         new StandInSum(), new StandInSplit()};
+    const char *types[] = {"Convolution", "Swish", "Convolution", "BinaryOp", "Split"};
+    const char *names[] = {"conv_0", "act_0", "conv_1", "add_0", "split_0"};
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        layers[i]->type = types[i];
+        layers[i]->name = names[i];
+    }
+    return layers;
+}
+
+// conv -> swish -> conv, + the first conv's output, then split; the way Net::forward_layer calls each kind
+static std::vector<ncnn::Mat> run_chain(const std::vector<ncnn::Layer *> &layers, const ncnn::Mat &input,
+                                        const ncnn::Option &opt)
+{
+    ncnn::Mat conv0, conv1;
+    layers[0]->forward(input, conv0, opt);
+    ncnn::Mat act = conv0.clone();
+    layers[1]->forward_inplace(act, opt);
+    layers[2]->forward(act, conv1, opt);
+    std::vector<ncnn::Mat> sum(1);
+    layers[3]->forward(std::vector<ncnn::Mat>{conv0, conv1}, sum, opt);
+    std::vector<ncnn::Mat> split = {sum[0], ncnn::Mat()};
+    layers[4]->forward_inplace(split, opt);
+    return split;
+}
+
+static bool same_mat(const ncnn::Mat &a, const ncnn::Mat &b)
+{
+    return a.w == b.w && a.h == b.h && a.c == b.c && a.total() == b.total()
+           && memcmp((const float *) a, (const float *) b, a.total() * sizeof(float)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const int runs = argc > 1 ? atoi(argv[1]) : 50;
+
+    ncnn::Mat input(40, 30, 3);
+    std::mt19937 rng(20240812);
+    std::uniform_real_distribution<float> value(-1.f, 1.f);
+    for (size_t i = 0; i < input.total(); i++)
+        ((float *) input)[i] = value(rng);
+    ncnn::Option opt;
+
+    std::vector<ncnn::Layer *> plain = make_chain();
+    std::vector<ncnn::Layer *> wrapped = make_chain();
+    LayerProfiler profiler;
+    if (!profiler.attach(wrapped) || profiler.attach(wrapped))
+    {
+        fprintf(stderr, "attach should work once\n");
+        return -1;
+    }
+    if (wrapped[1]->type != "Swish" || wrapped[3]->one_blob_only || !wrapped[4]->support_inplace)
+    {
+        fprintf(stderr, "wrappers lost the layer flags\n");
+        return -1;
+    }
+
+    const std::vector<ncnn::Mat> reference = run_chain(plain, input, opt);
+    run_chain(wrapped, input, opt);
+    if (!profiler.profile().empty())
+    {
+        fprintf(stderr, "layers counted with the timing off\n");
+        return -1;
+    }
+
+    profiler.set_enabled(true);
+    for (int i = 0; i < runs; i++)
+    {
+        const std::vector<ncnn::Mat> outputs = run_chain(wrapped, input, opt);
+        if (!same_mat(reference[0], outputs[0]) || !same_mat(reference[1], outputs[1]))
+        {
+            fprintf(stderr, "profiled outputs differ\n");
+            return -1;
+        }
+    }
+
+    const std::vector<LayerProfile> profile = profiler.profile();
+    if (profile.size() != 5)
+    {
+        fprintf(stderr, "%d layers profiled, expected 5\n", (int) profile.size());
+        return -1;
+    }
+    for (size_t i = 0; i < profile.size(); i++)
+    {
+        const LayerProfile &layer = profile[i];
+        if (layer.count != (uint64_t) runs || (i > 0 && layer.total_ms > profile[i - 1].total_ms)
+            || layer.max_ms < layer.mean_ms)
+        {
+            fprintf(stderr, "%s: %llu runs, %.3f ms, not in order\n", layer.name.c_str(), (unsigned long long) layer.count,
+                    layer.total_ms);
+            return -1;
+        }
+        if (layer.name == "add_0" && (layer.w != 40 || layer.h != 30 || layer.c != 16 || layer.bytes != 40 * 30 * 16 * 4))
+        {
+            fprintf(stderr, "add_0 output %dx%dx%d, %d bytes\n", layer.w, layer.h, layer.c, (int) layer.bytes);
+            return -1;
+        }
+        // both outputs of the split count
+        if (layer.name == "split_0" && layer.bytes != 40 * 30 * 17 * 4)
+        {
+            fprintf(stderr, "split_0 wrote %d bytes\n", (int) layer.bytes);
+            return -1;
+        }
+    }
+    if (profile[0].type != "Convolution" || profile[1].type != "Convolution")
+    {
+        fprintf(stderr, "the convolutions should be the slowest, %s is first\n", profile[0].name.c_str());
+        return -1;
+    }
+    const std::string report = format_layer_report(profile);
+    const std::string folded = format_folded_stacks(profile, "chain");
+    if (report.find("conv_1") == std::string::npos || folded.compare(0, 18, "chain;Convolution;") != 0)
+    {
+        fprintf(stderr, "report:\n%s\nfolded:\n%s", report.c_str(), folded.c_str());
+        return -1;
+    }
+    fprintf(stderr, "%s\n%s\n", report.c_str(), folded.c_str());
+
+    profiler.reset();
+    if (!profiler.profile().empty())
+    {
+        fprintf(stderr, "counts left after reset\n");
+        return -1;
+    }
+
+    const double plain_ms = benchmark("plain layers", runs, [&]() { run_chain(plain, input, opt); });
+    profiler.set_enabled(false);
+    const double off_ms = benchmark("wrapped, timing off", runs, [&]() { run_chain(wrapped, input, opt); });
+    profiler.set_enabled(true);
+    const double on_ms = benchmark("wrapped, timing on", runs, [&]() { run_chain(wrapped, input, opt); });
+    fprintf(stderr, "wrappers cost %.1f us per run off, %.1f us on\n", (off_ms - plain_ms) * 1000, (on_ms - plain_ms) * 1000);
+
+    for (ncnn::Layer *layer : plain)
+        delete layer;
+    for (ncnn::Layer *layer : wrapped)
+        delete layer;
+    return 0;
+}
@@ -0,0 +1,79 @@
+//
+// Model sidecars: the shipped .cfg files must describe the stock models exactly like their built-in
+// configs, and a GenericDetector configured from them must decode like the fixed-class decoders
+// Usage: bench_model_config [assets dir]
+//
+
+#include <cmath>
+#include "BenchUtils.h"
+#include "Decoder.h"
+#include "ModelConfig.h"
+#include "NanoDetPlus.h"
+#include "YOLOv5s.h"
+
+static bool same_config(const ModelConfig &a, const ModelConfig &b)
+{
+    if (a.head != b.head || a.input_blob != b.input_blob || a.target_size != b.target_size
+        || a.max_stride != b.max_stride || a.to_bgr != b.to_bgr || a.pad_value != b.pad_value
+        || a.num_class != b.num_class || a.outputs.size() != b.outputs.size())
+        return false;
+    for (int c = 0; c < 3; c++)
+    {
+        // the files spell 1/255 with 9 decimals
+        if (a.mean_vals[c] != b.mean_vals[c] || std::fabs(a.norm_vals[c] - b.norm_vals[c]) > 1e-9f)
+            return false;
+    }
+    for (size_t i = 0; i < a.outputs.size(); i++)
+    {
+        if (a.outputs[i].blob != b.outputs[i].blob || a.outputs[i].stride != b.outputs[i].stride
+            || a.outputs[i].anchors != b.outputs[i].anchors)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string assets = argc > 1 ? argv[1] : OBJDET_ASSETS_DIR;
+
+    const char *names[2] = {"YOLOv5s", "NanoDetPlus"};
+    const ModelConfig defaults[2] = {YOLOv5s::default_config(), NanoDetPlus::default_config()};
+    for (int m = 0; m < 2; m++)
+    {
+        ModelConfig config;
+        std::string error;
+        std::string path = assets + "/" + names[m] + ".cfg";
+        if (!load_model_config(path.c_str(), config, &error))
+        {
+            fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+            return -1;
+        }
+        if (!same_config(config, defaults[m]))
+        {
+            fprintf(stderr, "%s does not match %s::default_config()\n", path.c_str(), names[m]);
+            return -1;
+        }
+        fprintf(stderr, "%s.cfg matches the built-in config, %zu outputs\n", names[m], config.outputs.size());
+    }
+
+    // malformed sidecars are rejected with the line
+    const char *bad[4] = {
+            "head = yolo\nnum_class = 80\n",
+            "head = yolo\noutput = out0 8 10 13 16\noutput = out1 16 30\n",
+            "head = gfl\noutput = 231 8 1 2\n",
+            "head = gfl\ntarget_sise = 320\noutput = 231 8\n",
+    };
+    for (const char *text : bad)
+    {
+        ModelConfig config;
+        std::string error;
+        if (parse_model_config(text, config, &error))
+        {
+            fprintf(stderr, "accepted a malformed sidecar:\n%s", text);
+            return -1;
+        }
+        fprintf(stderr, "rejected: %s\n", error.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+//
+// NanoDet-Plus proposal decoding: reference per-cell Softmax layer vs fused DFL decoder
+// Synthetic high-density prediction tensors, i.e. crowded scenes where many cells pass the threshold
+//
+
+#include <cfloat>
+#include <cmath>
+#include "BenchUtils.h"
+#include "Decoder.h"
+#include "layer.h"
+
+static inline float sigmoid(float x)
+{
+    return 1.0f / (1.0f + expf(-x));
+}
+
+// The decoder NanoDetPlus.cpp used before generate_proposals_nanodet
+static void generate_proposals_reference(const ncnn::Mat &pred, int stride, int num_class, float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    int num_grid_x = pred.w;
+    int num_grid_y = pred.h;
+
+    const int reg_max_1 = (pred.c - num_class) / 4;
+
+    for (int i = 0; i < num_grid_y; i++)
+    {
+        for (int j = 0; j < num_grid_x; j++)
+        {
+            int label = -1;
+            float score = -FLT_MAX;
+            for (int k = 0; k < num_class; k++)
+            {
+                float s = pred.channel(k).row(i)[j];
+                if (s > score)
+                {
+                    label = k;
+                    score = s;
+                }
+            }
+
+            score = sigmoid(score);
+
+            if (score >= prob_threshold)
+            {
+                ncnn::Mat bbox_pred(reg_max_1, 4);
+                for (int k = 0; k < reg_max_1 * 4; k++)
+                {
+                    bbox_pred[k] = pred.channel(num_class + k).row(i)[j];
+                }
+                {
+                    ncnn::Layer *softmax = ncnn::create_layer("Softmax");
+
+                    ncnn::ParamDict pd;
+                    pd.set(0, 1); // axis
+                    pd.set(1, 1);
+                    softmax->load_param(pd);
+
+                    ncnn::Option opt;
+                    opt.num_threads = 1;
+                    opt.use_packing_layout = false;
+
+                    softmax->create_pipeline(opt);
+
+                    softmax->forward_inplace(bbox_pred, opt);
+
+                    softmax->destroy_pipeline(opt);
+
+                    delete softmax;
+                }
+
+                float pred_ltrb[4];
+                for (int k = 0; k < 4; k++)
+                {
+                    float dis = 0.f;
+                    const float *dis_after_sm = bbox_pred.row(k);
+                    for (int l = 0; l < reg_max_1; l++)
+                    {
+                        dis += l * dis_after_sm[l];
+                    }
+
+                    pred_ltrb[k] = dis * stride;
+                }
+
+                float pb_cx = j * stride;
+                float pb_cy = i * stride;
+
+                float x0 = pb_cx - pred_ltrb[0];
+                float y0 = pb_cy - pred_ltrb[1];
+                float x1 = pb_cx + pred_ltrb[2];
+                float y1 = pb_cy + pred_ltrb[3];
+
+                BoxInfo obj;
+                obj.x1 = x0;
+                obj.y1 = y0;
+                obj.w = x1 - x0;
+                obj.h = y1 - y0;
+                obj.label = label;
+                obj.score = score;
+
+                objects.push_back(obj);
+            }
+        }
+    }
+}
+
+static ncnn::Mat make_pred(int grid, int num_class, int reg_max_1, float positive_ratio, std::mt19937 &rng)
+{
+    ncnn::Mat pred(grid, grid, num_class + 4 * reg_max_1);
+
+    std::normal_distribution<float> background(-6.f, 1.5f);
+    std::normal_distribution<float> foreground(1.f, 1.f);
+    std::normal_distribution<float> distance(0.f, 3.f);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::uniform_int_distribution<int> label(0, num_class - 1);
+
+    for (int i = 0; i < grid; i++)
+    {
+        for (int j = 0; j < grid; j++)
+        {
+            bool positive = uniform(rng) < positive_ratio;
+            int hot = label(rng);
+            for (int k = 0; k < num_class; k++)
+                pred.channel(k).row(i)[j] = (positive && k == hot) ? foreground(rng) : background(rng);
+            for (int k = 0; k < 4 * reg_max_1; k++)
+                pred.channel(num_class + k).row(i)[j] = distance(rng);
+        }
+    }
+
+    return pred;
+}
+
+static float max_box_difference(const std::vector<BoxInfo> &a, const std::vector<BoxInfo> &b)
+{
+    if (a.size() != b.size())
+        return FLT_MAX;
+
+    float diff = 0.f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].label != b[i].label || a[i].score != b[i].score)
+            return FLT_MAX;
+        diff = std::max(diff, std::fabs(a[i].x1 - b[i].x1));
+        diff = std::max(diff, std::fabs(a[i].y1 - b[i].y1));
+        diff = std::max(diff, std::fabs(a[i].w - b[i].w));
+        diff = std::max(diff, std::fabs(a[i].h - b[i].h));
+    }
+    return diff;
+}
+
+int main(int argc, char **argv)
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 20;
+
+    const int num_class = 80;
+    const int reg_max_1 = 8;
+    const int strides[4] = {8, 16, 32, 64};
+    const float threshold = 0.4f;
+
+    std::mt19937 rng(20231002);
+
+    const int input_sizes[2] = {320, 640};
+    const float densities[3] = {0.05f, 0.3f, 0.8f};
+    for (int input_size : input_sizes)
+    {
+        for (float density : densities)
+        {
+            ncnn::Mat preds[4];
+            for (int s = 0; s < 4; s++)
+                preds[s] = make_pred(input_size / strides[s], num_class, reg_max_1, density, rng);
+
+            std::vector<BoxInfo> reference;
+            std::vector<BoxInfo> fused;
+
+            auto run_reference = [&]() {
+                reference.clear();
+                for (int s = 0; s < 4; s++)
+                    generate_proposals_reference(preds[s], strides[s], num_class, threshold, reference);
+            };
+            auto run_fused = [&]() {
+                fused.clear();
+                for (int s = 0; s < 4; s++)
+                    generate_proposals_nanodet(preds[s], strides[s], num_class, threshold, fused);
+            };
+
+            std::vector<BoxInfo> generic;
+            GflDecoder generic_decoder = select_nanodet_decoder(0);
+            auto run_generic = [&]() {
+                generic.clear();
+                for (int s = 0; s < 4; s++)
+                    generic_decoder(preds[s], strides[s], num_class, threshold, generic);
+            };
+
+            run_reference();
+            run_fused();
+            run_generic();
+            if (!same_boxes(fused, generic))
+            {
+                fprintf(stderr, "input %d density %.2f: generic and specialized decoders disagree\n", input_size, density);
+                return -1;
+            }
+
+            // softmax rounding differs from the ncnn layer, distances are scaled by the stride
+            float diff = max_box_difference(reference, fused);
+            if (diff > 1e-3f * strides[3])
+            {
+                fprintf(stderr, "input %d density %.2f: decoders disagree (max difference %g)\n", input_size, density, diff);
+                return -1;
+            }
+
+            fprintf(stderr, "input %d, density %.2f, %zu proposals, max box difference %g\n", input_size, density, reference.size(), diff);
+            double time_reference = benchmark("  softmax layer per cell", loops, run_reference);
+            double time_generic = benchmark("  fused dfl, generic class loop", loops, run_generic);
+            double time_fused = benchmark("  fused dfl, 80 classes", loops, run_fused);
+            fprintf(stderr, "  speedup x%.2f (generic x%.2f)\n", time_reference / time_fused, time_reference / time_generic);
+        }
+    }
+
+    return 0;
+}
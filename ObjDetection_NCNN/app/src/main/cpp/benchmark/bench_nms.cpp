@@ -0,0 +1,154 @@
+//
+// NMS: reference array-of-structs loop vs per-class bucketed SIMD NmsEngine
+// The golden sets are seeded clusters of jittered boxes, from a few hundred up to crowded 20k proposal frames
+//
+
+#include "BenchUtils.h"
+#include "PostProcess.h"
+
+// The NMS YOLOv5s.cpp and NanoDetPlus.cpp used before NmsEngine
+static inline float intersection_area(const BoxInfo &a, const BoxInfo &b)
+{
+    if (a.x1 > b.x1 + b.w || a.x1 + a.w < b.x1 || a.y1 > b.y1 + b.h || a.y1 + a.h < b.y1)
+    {
+        // no intersection
+        return 0.f;
+    }
+
+    float inter_width = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    float inter_height = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+
+    return inter_width * inter_height;
+}
+
+static void nms_sorted_bboxes_reference(const std::vector<BoxInfo> &faceobjects, std::vector<int> &picked, float nms_threshold, bool agnostic = false)
+{
+    picked.clear();
+
+    const int n = faceobjects.size();
+
+    std::vector<float> areas(n);
+    for (int i = 0; i < n; i++)
+    {
+        areas[i] = faceobjects[i].w * faceobjects[i].h;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        const BoxInfo &a = faceobjects[i];
+
+        int keep = 1;
+        for (int j : picked)
+        {
+            const BoxInfo &b = faceobjects[j];
+
+            if (!agnostic && a.label != b.label)
+                continue;
+
+            // intersection over union
+            float inter_area = intersection_area(a, b);
+            float union_area = areas[i] + areas[j] - inter_area;
+            // float IoU = inter_area / union_area
+            if (inter_area / union_area > nms_threshold)
+                keep = 0;
+        }
+
+        if (keep)
+            picked.push_back(i);
+    }
+}
+
+// Proposals sorted by descending score, clustered around objects like real head outputs
+static std::vector<BoxInfo> make_proposals(int count, int num_objects, int num_class, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> position(0.f, 640.f);
+    std::uniform_real_distribution<float> extent(8.f, 320.f);
+    std::normal_distribution<float> jitter(0.f, 0.08f);
+    std::uniform_real_distribution<float> score(0.25f, 1.f);
+    std::uniform_int_distribution<int> label(0, num_class - 1);
+    std::uniform_int_distribution<int> pick(0, num_objects - 1);
+
+    std::vector<BoxInfo> objects(num_objects);
+    for (BoxInfo &o : objects)
+    {
+        o.w = extent(rng);
+        o.h = extent(rng);
+        o.x1 = position(rng) - o.w * 0.5f;
+        o.y1 = position(rng) - o.h * 0.5f;
+        o.label = label(rng);
+    }
+
+    std::vector<BoxInfo> proposals(count);
+    for (BoxInfo &p : proposals)
+    {
+        const BoxInfo &o = objects[pick(rng)];
+        p.w = o.w * (1.f + jitter(rng));
+        p.h = o.h * (1.f + jitter(rng));
+        p.x1 = o.x1 + o.w * jitter(rng);
+        p.y1 = o.y1 + o.h * jitter(rng);
+        p.label = o.label;
+        p.score = score(rng);
+    }
+
+    std::sort(proposals.begin(), proposals.end(), [](const BoxInfo &a, const BoxInfo &b) { return a.score > b.score; });
+    return proposals;
+}
+
+int main(int argc, char **argv)
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 20;
+
+    std::mt19937 rng(20240114);
+
+    const int counts[5] = {100, 1000, 5000, 10000, 20000};
+    const float thresholds[2] = {0.45f, 0.6f};
+    const int max_detections[2] = {0, 100};
+
+    NmsEngine engine;
+    for (int count : counts)
+    {
+        std::vector<BoxInfo> proposals = make_proposals(count, std::max(count / 20, 5), 80, rng);
+
+        // golden check over every mode before timing anything
+        for (float threshold : thresholds)
+        {
+            for (int agnostic = 0; agnostic < 2; agnostic++)
+            {
+                std::vector<int> reference;
+                nms_sorted_bboxes_reference(proposals, reference, threshold, agnostic);
+
+                for (int max_det : max_detections)
+                {
+                    std::vector<int> expected = reference;
+                    if (max_det > 0 && (int) expected.size() > max_det)
+                        expected.resize(max_det);
+
+                    std::vector<int> picked;
+                    engine.run(proposals, picked, threshold, agnostic, max_det);
+                    if (picked != expected)
+                    {
+                        fprintf(stderr, "%d proposals, threshold %.2f, agnostic %d, max_det %d: picked differs\n",
+                                count, threshold, agnostic, max_det);
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        std::vector<int> picked;
+        fprintf(stderr, "%d proposals\n", count);
+        double time_reference = benchmark("  reference", loops, [&]() {
+            nms_sorted_bboxes_reference(proposals, picked, 0.45f);
+        });
+        fprintf(stderr, "  %zu picked\n", picked.size());
+        double time_engine = benchmark("  bucketed simd", loops, [&]() {
+            engine.run(proposals, picked, 0.45f);
+        });
+        benchmark("  bucketed simd, max_det 100", loops, [&]() {
+            engine.run(proposals, picked, 0.45f, false, 100);
+        });
+        fprintf(stderr, "  speedup x%.2f\n", time_reference / time_engine);
+    }
+
+    return 0;
+}
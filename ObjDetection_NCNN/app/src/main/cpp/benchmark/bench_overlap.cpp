@@ -0,0 +1,131 @@
+//
+// Overlapped per-head decode and the coarse-strides-only mode
+// Usage: bench_overlap [loops] [backbone_ms] [head_ms]
+// A NanoDet-Plus shaped stand-in at 640 x 640: extracting the first head waits backbone_ms, every head then
+// waits head_ms more, like the CPU does while a Vulkan queue runs the layers; the outputs go through the real
+// GFL decoder. The serial path decodes after the last extract, the overlapped one decodes each head on the
+// context's worker while the next is extracted, and min_stride 16 drops the stride-8 head altogether.
+//
+
+#include "BenchUtils.h"
+#include "Decoder.h"
+#include "Detector.h"
+
+class HeadedDetector : public Detector {
+public:
+    HeadedDetector(double backbone_ms, double head_ms, std::mt19937 &rng) : backbone_ms(backbone_ms), head_ms(head_ms)
+    {
+        target_size = 640;
+        max_stride = 64;
+        decoder = select_nanodet_decoder(num_class);
+
+        std::normal_distribution<float> background(-6.f, 1.5f);
+        std::normal_distribution<float> distance(0.f, 3.f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        for (int s = 0; s < 4; s++)
+        {
+            const int grid = 640 / strides[s];
+            preds[s].create(grid, grid, num_class + 32);
+            for (int q = 0; q < preds[s].c; q++)
+            {
+                float *ptr = preds[s].channel(q);
+                for (int i = 0; i < grid * grid; i++)
+                    ptr[i] = q < num_class ? (uniform(rng) < 0.002f ? 2.f : background(rng)) : distance(rng);
+            }
+        }
+    }
+
+    void infer(DetectContext &ctx) const override
+    {
+        ctx.outputs.resize(4);
+        bool backbone = false;
+        for (int s = 0; s < 4; s++)
+            extract(ctx, s, backbone);
+    }
+
+    void decode_head(const DetectContext &ctx, int i, float threshold, std::vector<BoxInfo> &proposals) const override
+    {
+        decoder(ctx.outputs[i], strides[i], num_class, threshold, proposals);
+    }
+
+protected:
+    void decode(DetectContext &ctx, float threshold) const override
+    {
+        for (int s = 0; s < 4; s++)
+        {
+            if (!ctx.outputs[s].empty())
+                decode_head(ctx, s, threshold, ctx.proposals);
+        }
+    }
+
+    bool infer_decode(DetectContext &ctx, float threshold) const override
+    {
+        ctx.outputs.resize(4);
+        bool backbone = false;
+        infer_heads(ctx, threshold, [this, &ctx, &backbone](int s) { return extract(ctx, s, backbone); });
+        return true;
+    }
+
+private:
+    // like ncnn, the shared layers run with the first head extracted and a skipped head costs nothing
+    bool extract(DetectContext &ctx, int s, bool &backbone) const
+    {
+        if (strides[s] < min_stride && s < 3)
+        {
+            ctx.outputs[s].release();
+            return false;
+        }
+        double ms = head_ms;
+        if (!backbone)
+            ms += backbone_ms;
+        backbone = true;
+        std::this_thread::sleep_for(std::chrono::microseconds((long long) (ms * 1000)));
+        ctx.outputs[s] = preds[s];
+        return true;
+    }
+
+    const int num_class = 80;
+    const int strides[4] = {8, 16, 32, 64};
+    double backbone_ms;
+    double head_ms;
+    GflDecoder decoder;
+    ncnn::Mat preds[4];
+};
+
+int main(int argc, char **argv)
+{
+    const int loops = argc > 1 ? atoi(argv[1]) : 50;
+    const double backbone_ms = argc > 2 ? atof(argv[2]) : 6.0;
+    const double head_ms = argc > 3 ? atof(argv[3]) : 1.0;
+
+    std::mt19937 rng(20240710);
+    HeadedDetector detector(backbone_ms, head_ms, rng);
+
+    std::vector<unsigned char> pixels(640 * 640 * 4, 0);
+    ImageBuffer image = {pixels.data(), 640, 640, 0, PIXEL_FORMAT_RGBA};
+    const float threshold = 0.4f;
+    const float nms_threshold = 0.5f;
+
+    // reference: both stages one after the other
+    detector.set_decode_overlap(false);
+    std::vector<BoxInfo> serial = detector.detect(image, threshold, nms_threshold);
+    const double serial_ms = benchmark("serial decode", loops, [&]() { detector.detect(image, threshold, nms_threshold); });
+
+    detector.set_decode_overlap(true);
+    std::vector<BoxInfo> overlapped = detector.detect(image, threshold, nms_threshold);
+    if (!same_boxes(serial, overlapped))
+    {
+        fprintf(stderr, "overlapped decode: %d boxes, serial %d\n", (int) overlapped.size(), (int) serial.size());
+        return -1;
+    }
+    const double overlapped_ms = benchmark("overlapped decode", loops, [&]() { detector.detect(image, threshold, nms_threshold); });
+
+    // large objects only: every box comes from a stride-16 or coarser cell
+    detector.set_min_stride(16);
+    std::vector<BoxInfo> coarse = detector.detect(image, threshold, nms_threshold);
+    const double coarse_ms = benchmark("min_stride 16", loops, [&]() { detector.detect(image, threshold, nms_threshold); });
+
+    fprintf(stderr, "%d boxes, overlapped %.2fx, coarse %.2fx (%d boxes)\n", (int) serial.size(),
+            serial_ms / overlapped_ms, serial_ms / coarse_ms, (int) coarse.size());
+    return 0;
+}
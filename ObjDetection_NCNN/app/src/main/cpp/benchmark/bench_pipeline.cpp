@@ -0,0 +1,85 @@
+//
+// Detection pipeline: sequential detect() vs DetectPipeline with overlapping stages
+// The network is replaced by SyntheticDetector, so only the scheduling is measured
+//
+
+#include "BenchUtils.h"
+#include "DetectPipeline.h"
+#include "SyntheticDetector.h"
+
+int main(int argc, char **argv)
+{
+    int num_frames = argc > 1 ? atoi(argv[1]) : 60;
+
+    std::mt19937 rng(20240511);
+    std::uniform_int_distribution<int> noise(0, 255);
+
+    // 1280x720 camera frames in NV21
+    const int width = 1280;
+    const int height = 720;
+    std::vector<std::vector<unsigned char>> frames(4);
+    for (auto &frame : frames)
+    {
+        frame.resize((size_t) width * height * 3 / 2);
+        for (auto &v : frame)
+            v = (unsigned char) noise(rng);
+    }
+
+    auto make_yuv = [&](int i) {
+        YuvImageBuffer yuv;
+        yuv.y = frames[i % frames.size()].data();
+        yuv.v = yuv.y + (size_t) width * height;
+        yuv.u = yuv.v + 1;
+        yuv.width = width;
+        yuv.height = height;
+        yuv.y_row_stride = width;
+        yuv.uv_row_stride = width;
+        yuv.uv_pixel_stride = 2;
+        yuv.rotation = 90;
+        return yuv;
+    };
+
+    const double infer_times[3] = {2.0, 5.0, 10.0};
+    for (double infer_ms : infer_times)
+    {
+        auto detector = std::make_shared<SyntheticDetector>(infer_ms, rng);
+
+        std::vector<std::vector<BoxInfo>> sequential(num_frames);
+        double start = get_current_time();
+        for (int i = 0; i < num_frames; i++)
+            sequential[i] = detector->detect(make_yuv(i), 0.4f, 0.6f);
+        double time_sequential = get_current_time() - start;
+
+        std::vector<std::vector<BoxInfo>> pipelined(num_frames);
+        PipelineOptions options;
+        options.depth = 4;
+        options.drop_policy = BLOCK;
+        options.callback = [&](DetectResult &result) {
+            pipelined[result.frame_id].swap(result.boxes);
+        };
+        start = get_current_time();
+        {
+            DetectPipeline pipeline(detector, options);
+            for (int i = 0; i < num_frames; i++)
+                pipeline.submit(make_yuv(i), 0.4f, 0.6f);
+            pipeline.flush();
+        }
+        double time_pipelined = get_current_time() - start;
+
+        for (int i = 0; i < num_frames; i++)
+        {
+            if (!same_boxes(sequential[i], pipelined[i]))
+            {
+                fprintf(stderr, "infer %.0f ms: frame %d differs between sequential and pipelined runs\n", infer_ms, i);
+                return -1;
+            }
+        }
+
+        fprintf(stderr, "infer %4.1f ms, %d frames\n", infer_ms, num_frames);
+        fprintf(stderr, "  sequential   %8.2f frames/s\n", num_frames * 1000.0 / time_sequential);
+        fprintf(stderr, "  pipelined    %8.2f frames/s\n", num_frames * 1000.0 / time_pipelined);
+        fprintf(stderr, "  speedup x%.2f\n", time_sequential / time_pipelined);
+    }
+
+    return 0;
+}
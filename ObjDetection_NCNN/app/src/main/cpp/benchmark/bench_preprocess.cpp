@@ -0,0 +1,201 @@
+//
+// Preprocessing: from_pixels_resize + copy_make_border + substract_mean_normalize vs the fused letterbox kernel
+// RGBA frames like the ones coming from an Android Bitmap, then YUV_420_888 camera frames:
+// yuv_to_rgba + letterbox vs the direct YUV letterbox with the rotation folded in
+//
+
+#include <cmath>
+#include "BenchUtils.h"
+#include "Preprocess.h"
+
+// The three passes YOLOv5s.cpp and NanoDetPlus.cpp used before LetterboxPreprocessor
+static void preprocess_reference(const ImageBuffer &image, const LetterboxInfo &letterbox, bool to_bgr, float pad_value,
+                                 const float *mean_vals, const float *norm_vals, ncnn::Mat &in_pad)
+{
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(image.data, pixel_convert_type(image.format, to_bgr),
+                                                 image.width, image.height, image_row_stride(image), letterbox.w, letterbox.h);
+
+    int wpad = letterbox.wpad;
+    int hpad = letterbox.hpad;
+    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, pad_value);
+
+    in_pad.substract_mean_normalize(mean_vals, norm_vals);
+}
+
+static float max_difference(const ncnn::Mat &a, const ncnn::Mat &b)
+{
+    if (a.w != b.w || a.h != b.h || a.c != b.c)
+        return 1e30f;
+
+    float diff = 0.f;
+    for (int q = 0; q < a.c; q++)
+    {
+        const float *pa = a.channel(q);
+        const float *pb = b.channel(q);
+        for (int i = 0; i < a.w * a.h; i++)
+            diff = std::max(diff, std::fabs(pa[i] - pb[i]));
+    }
+    return diff;
+}
+
+int main(int argc, char **argv)
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 20;
+
+    std::mt19937 rng(20240420);
+    std::uniform_int_distribution<int> noise(-12, 12);
+
+    struct Model {
+        const char *name;
+        int target_size;
+        bool to_bgr;
+        float pad_value;
+        float mean[3];
+        float norm[3];
+    };
+    const Model models[2] = {
+            {"yolov5s",      640, false, 114.f, {0.f,     0.f,     0.f},      {1 / 255.f, 1 / 255.f, 1 / 255.f}},
+            {"nanodet-plus", 320, true,  0.f,   {103.53f, 116.28f, 123.675f}, {0.017429f, 0.017507f, 0.017125f}},
+    };
+
+    const int sizes[4][2] = {{640, 480}, {1280, 720}, {1920, 1080}, {4000, 3000}};
+    for (const auto &size : sizes)
+    {
+        const int width = size[0];
+        const int height = size[1];
+
+        // smooth gradients plus noise, stride padded like Bitmap rows can be
+        const int stride = width * 4 + 64;
+        std::vector<unsigned char> pixels((size_t) stride * height);
+        for (int y = 0; y < height; y++)
+        {
+            unsigned char *row = pixels.data() + (size_t) y * stride;
+            for (int x = 0; x < width; x++)
+            {
+                row[x * 4 + 0] = (unsigned char) std::min(std::max(x * 255 / width + noise(rng), 0), 255);
+                row[x * 4 + 1] = (unsigned char) std::min(std::max(y * 255 / height + noise(rng), 0), 255);
+                row[x * 4 + 2] = (unsigned char) std::min(std::max((x + y) * 127 / (width + height) + noise(rng), 0), 255);
+                row[x * 4 + 3] = 255;
+            }
+        }
+
+        ImageBuffer image;
+        image.data = pixels.data();
+        image.width = width;
+        image.height = height;
+        image.stride = stride;
+        image.format = PIXEL_FORMAT_RGBA;
+
+        for (const Model &model : models)
+        {
+            LetterboxInfo letterbox = compute_letterbox(width, height, model.target_size, 64);
+
+            ncnn::Mat reference;
+            ncnn::Mat fused;
+            LetterboxPreprocessor preprocessor;
+
+            preprocess_reference(image, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, reference);
+            preprocessor.run(image, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, fused);
+
+            // ncnn resizes in fixed point and rounds to 8 bit, allow two intensity levels
+            float diff = max_difference(reference, fused);
+            float tolerance = 2.f * std::max(model.norm[0], std::max(model.norm[1], model.norm[2]));
+            if (diff > tolerance)
+            {
+                fprintf(stderr, "%dx%d %s: outputs disagree (max difference %g)\n", width, height, model.name, diff);
+                return -1;
+            }
+
+            fprintf(stderr, "%dx%d -> %dx%d %s, max difference %g\n", width, height, fused.w, fused.h, model.name, diff);
+            double time_reference = benchmark("  resize + border + normalize", loops, [&]() {
+                preprocess_reference(image, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, reference);
+            });
+            double time_fused = benchmark("  fused letterbox", loops, [&]() {
+                preprocessor.run(image, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, fused);
+            });
+            fprintf(stderr, "  speedup x%.2f\n", time_reference / time_fused);
+        }
+    }
+
+    const int camera_sizes[2][2] = {{640, 480}, {1280, 720}};
+    const int rotations[4] = {0, 90, 180, 270};
+    for (const auto &size : camera_sizes)
+    {
+        const int width = size[0];
+        const int height = size[1];
+
+        // NV21 layout: luma plane followed by interleaved v, u
+        std::vector<unsigned char> nv21((size_t) width * height + (size_t) width * (height / 2));
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                nv21[(size_t) y * width + x] = (unsigned char) std::min(std::max((x + y) * 255 / (width + height) + noise(rng), 0), 255);
+        unsigned char *vu = nv21.data() + (size_t) width * height;
+        for (int y = 0; y < height / 2; y++)
+        {
+            for (int x = 0; x < width / 2; x++)
+            {
+                vu[(size_t) y * width + x * 2] = (unsigned char) (96 + x * 64 / (width / 2));
+                vu[(size_t) y * width + x * 2 + 1] = (unsigned char) (160 - y * 64 / (height / 2));
+            }
+        }
+
+        for (int rotation : rotations)
+        {
+            YuvImageBuffer frame;
+            frame.y = nv21.data();
+            frame.v = vu;
+            frame.u = vu + 1;
+            frame.width = width;
+            frame.height = height;
+            frame.y_row_stride = width;
+            frame.uv_row_stride = width;
+            frame.uv_pixel_stride = 2;
+            frame.rotation = rotation;
+
+            int rotated_w, rotated_h;
+            yuv_rotated_size(frame, rotated_w, rotated_h);
+            std::vector<unsigned char> rgba((size_t) rotated_w * rotated_h * 4);
+
+            ImageBuffer image;
+            image.data = rgba.data();
+            image.width = rotated_w;
+            image.height = rotated_h;
+            image.stride = rotated_w * 4;
+            image.format = PIXEL_FORMAT_RGBA;
+
+            const Model &model = models[1];
+            LetterboxInfo letterbox = compute_letterbox(rotated_w, rotated_h, model.target_size, 64);
+
+            ncnn::Mat reference;
+            ncnn::Mat direct;
+            LetterboxPreprocessor preprocessor;
+
+            auto run_reference = [&]() {
+                yuv_to_rgba(frame, rgba.data(), rotated_w * 4);
+                preprocessor.run(image, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, reference);
+            };
+            auto run_direct = [&]() {
+                preprocessor.run(frame, letterbox, model.to_bgr, model.pad_value, model.mean, model.norm, direct);
+            };
+
+            run_reference();
+            run_direct();
+
+            // chroma is sampled at the nearest position instead of being interpolated after conversion
+            float diff = max_difference(reference, direct);
+            float tolerance = 6.f * std::max(model.norm[0], std::max(model.norm[1], model.norm[2]));
+            if (diff > tolerance)
+            {
+                fprintf(stderr, "yuv %dx%d rotation %d: outputs disagree (max difference %g)\n", width, height, rotation, diff);
+                return -1;
+            }
+
+            fprintf(stderr, "yuv %dx%d rotation %d -> %dx%d, max difference %g\n", width, height, rotation, direct.w, direct.h, diff);
+            double time_reference = benchmark("  yuv_to_rgba + letterbox", loops, run_reference);
+            double time_direct = benchmark("  direct yuv letterbox", loops, run_direct);
+            fprintf(stderr, "  speedup x%.2f\n", time_reference / time_direct);
+        }
+    }
+
+    return 0;
+}
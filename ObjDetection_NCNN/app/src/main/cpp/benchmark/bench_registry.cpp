@@ -0,0 +1,105 @@
+//
+// Concurrent detection on one shared detector, with the registry entry hot-swapped meanwhile
+// Several camera streams call detect() from their own threads; every result must match the
+// single-threaded one, whether it ran on the old or the new instance
+//
+
+#include <atomic>
+#include <thread>
+#include "BenchUtils.h"
+#include "DetectorRegistry.h"
+#include "SyntheticDetector.h"
+
+int main(int argc, char **argv)
+{
+    int num_frames = argc > 1 ? atoi(argv[1]) : 48;
+
+    std::mt19937 rng(20240602);
+    std::uniform_int_distribution<int> noise(0, 255);
+
+    const int width = 1280;
+    const int height = 720;
+    std::vector<std::vector<unsigned char>> pixels(8);
+    for (auto &frame : pixels)
+    {
+        frame.resize((size_t) width * height * 4);
+        for (auto &v : frame)
+            v = (unsigned char) noise(rng);
+    }
+    auto make_image = [&](int i) {
+        ImageBuffer image;
+        image.data = pixels[i % pixels.size()].data();
+        image.width = width;
+        image.height = height;
+        image.stride = 0;
+        image.format = PIXEL_FORMAT_RGBA;
+        return image;
+    };
+
+    // both instances are built from the same seed, so they produce the same boxes
+    std::mt19937 rng_a(7), rng_b(7);
+    auto detector_a = std::make_shared<SyntheticDetector>(5.0, rng_a);
+    auto detector_b = std::make_shared<SyntheticDetector>(5.0, rng_b);
+
+    std::vector<std::vector<BoxInfo>> reference(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++)
+        reference[i] = detector_a->detect(make_image(i), 0.4f, 0.6f);
+
+    DetectorRegistry registry;
+    registry.put("synthetic", detector_a);
+
+    const int thread_counts[3] = {1, 2, 4};
+    for (int num_threads : thread_counts)
+    {
+        std::atomic<int> next(0);
+        std::atomic<int> mismatches(0);
+        std::atomic<bool> done(false);
+
+        // swaps the entry back and forth while the streams detect
+        int swaps = 0;
+        std::thread swapper([&]() {
+            while (!done.load())
+            {
+                registry.put("synthetic", swaps % 2 ? detector_a : detector_b);
+                swaps++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(3));
+            }
+        });
+
+        double start = get_current_time();
+        std::vector<std::thread> streams;
+        for (int t = 0; t < num_threads; t++)
+        {
+            streams.emplace_back([&]() {
+                for (;;)
+                {
+                    int i = next.fetch_add(1);
+                    if (i >= num_frames)
+                        break;
+
+                    std::shared_ptr<Detector> detector = registry.get("synthetic");
+                    std::vector<BoxInfo> boxes = detector->detect(make_image(i), 0.4f, 0.6f);
+                    if (!same_boxes(boxes, reference[i % pixels.size()]))
+                        mismatches++;
+                }
+            });
+        }
+        for (auto &stream : streams)
+            stream.join();
+        double time = get_current_time() - start;
+
+        done = true;
+        swapper.join();
+
+        if (mismatches.load())
+        {
+            fprintf(stderr, "%d threads: %d frames differ from the single-threaded result\n", num_threads, mismatches.load());
+            return -1;
+        }
+
+        fprintf(stderr, "%d threads, %d frames, %d swaps: %8.2f frames/s\n", num_threads, num_frames, swaps,
+                num_frames * 1000.0 / time);
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// ROI inference on a still camera: detect() on every frame vs RoiDetector
+// Usage: bench_roi [num_frames] [infer_ms]
+// Parked objects never move, two objects walk through the scene and stop for a while,
+// with sensor noise on every frame; RectDetector stands in for the network, its cost follows the input area.
+//
+
+#include "BenchUtils.h"
+#include "MotionRoi.h"
+#include "RectDetector.h"
+
+static const int width = 1280;
+static const int height = 720;
+
+static float iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    return iw * ih / (a.w * a.h + b.w * b.h - iw * ih);
+}
+
+static void draw(std::vector<unsigned char> &pixels, const BoxInfo &box)
+{
+    for (int r = 0; r < (int) box.h; r++)
+        memset(pixels.data() + ((size_t) (box.y1 + r) * width + (size_t) box.x1) * 4, 255, (size_t) box.w * 4);
+}
+
+static BoxInfo make_box(float x, float y, float w, float h)
+{
+    BoxInfo box;
+    box.x1 = x;
+    box.y1 = y;
+    box.w = w;
+    box.h = h;
+    box.score = 1.f;
+    box.label = 0;
+    return box;
+}
+
+// Walkers cross the frame during the first and third quarter of the clip, the scene is quiet otherwise
+static void render(int frame, int num_frames, const std::vector<unsigned char> &background, std::mt19937 &rng,
+                   std::vector<unsigned char> &pixels, std::vector<BoxInfo> &truth)
+{
+    pixels = background;
+    std::uniform_int_distribution<int> noise(0, 6);
+    for (size_t i = 0; i < pixels.size(); i += 4 * 7)
+        pixels[i] = (unsigned char) (pixels[i] + noise(rng));
+
+    truth.clear();
+    truth.push_back(make_box(100, 500, 120, 60));
+    truth.push_back(make_box(900, 80, 80, 80));
+    truth.push_back(make_box(1100, 560, 60, 100));
+
+    const int quarter = num_frames / 4;
+    const int walk = frame < quarter ? frame : frame < 2 * quarter ? quarter : frame < 3 * quarter ? frame - quarter : 2 * quarter;
+    truth.push_back(make_box((float) (40 + walk * 1000 / (2 * quarter)), 300.f, 40.f, 90.f));
+    truth.push_back(make_box(600.f, (float) (620 - walk * 450 / (2 * quarter)), 50.f, 50.f));
+
+    for (const BoxInfo &box : truth)
+        draw(pixels, box);
+}
+
+static int recall(const std::vector<BoxInfo> &truth, const std::vector<BoxInfo> &boxes)
+{
+    int found = 0;
+    for (const BoxInfo &object : truth)
+    {
+        for (const BoxInfo &box : boxes)
+        {
+            if (iou(object, box) >= 0.5f)
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+int main(int argc, char **argv)
+{
+    const int num_frames = argc > 1 ? atoi(argv[1]) : 240;
+    const double infer_ms = argc > 2 ? atof(argv[2]) : 10.0;
+
+    std::mt19937 rng(20240625);
+    std::uniform_int_distribution<int> texture(0, 90);
+    std::vector<unsigned char> background((size_t) width * height * 4);
+    for (auto &v : background)
+        v = (unsigned char) texture(rng);
+
+    auto detector = std::make_shared<RectDetector>(infer_ms, true);
+
+    ImageBuffer image;
+    image.width = width;
+    image.height = height;
+    image.stride = 0;
+    image.format = PIXEL_FORMAT_RGBA;
+
+    std::vector<unsigned char> pixels;
+    std::vector<BoxInfo> truth;
+    std::vector<BoxInfo> boxes;
+
+    int every_found = 0;
+    int total = 0;
+    double every_ms = 0;
+    std::mt19937 every_rng(1);
+    for (int f = 0; f < num_frames; f++)
+    {
+        render(f, num_frames, background, every_rng, pixels, truth);
+        image.data = pixels.data();
+        const double start = get_current_time();
+        detector->detect(image, 0.5f, 0.5f, boxes);
+        every_ms += get_current_time() - start;
+        every_found += recall(truth, boxes);
+        total += (int) truth.size();
+    }
+
+    RoiOptions options;
+    RoiDetector roi(detector, options);
+    int roi_found = 0;
+    double roi_ms = 0;
+    double idle_ms = 0;
+    int idle_frames = 0;
+    std::mt19937 roi_rng(1);
+    for (int f = 0; f < num_frames; f++)
+    {
+        render(f, num_frames, background, roi_rng, pixels, truth);
+        image.data = pixels.data();
+        const double start = get_current_time();
+        const bool ran = roi.detect(image, 0.5f, 0.5f, boxes);
+        const double ms = get_current_time() - start;
+        roi_ms += ms;
+        if (!ran)
+        {
+            idle_ms += ms;
+            idle_frames++;
+        }
+        roi_found += recall(truth, boxes);
+    }
+
+    fprintf(stderr, "every frame  %6.2f ms/frame  recall %5.1f%%\n", every_ms / num_frames, 100.0 * every_found / total);
+    fprintf(stderr, "roi          %6.2f ms/frame  recall %5.1f%%  full %lld  crops %lld  idle %d frames (%.3f ms)  crop area %.1f%%\n",
+            roi_ms / num_frames, 100.0 * roi_found / total, roi.full_frames(), roi.roi_frames(), idle_frames,
+            idle_frames ? idle_ms / idle_frames : 0.0, 100.0 * roi.roi_area());
+
+    if (roi_found < every_found * 98 / 100)
+    {
+        fprintf(stderr, "roi mode loses objects\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// CPU clusters and scheduling plans
+// Usage: bench_scheduling [frames] [work_ms]
+// Prints the clusters read from cpufreq, checks every candidate plan survives format/parse and splits the
+// cores between inference and pre/post-processing, then times the candidates with autotune_scheduling on a
+// stand-in whose inference spins on the calling thread, and a pipeline with the tuned plan against the
+// powersave pinning it replaces. On a single-cluster host the plans can only differ in thread count.
+//
+
+#include "BenchUtils.h"
+#include "CpuTopology.h"
+#include "DetectPipeline.h"
+#include "RectDetector.h"
+
+// CPU-bound inference: work_ms of spinning, so a faster core finishes sooner
+class BusyDetector : public RectDetector {
+public:
+    explicit BusyDetector(double work_ms) : work_ms(work_ms) {}
+
+    void infer(DetectContext &ctx) const override
+    {
+        const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds((long long) (work_ms * 1000));
+        volatile unsigned int sink = 0;
+        while (std::chrono::steady_clock::now() < end)
+        {
+            for (int i = 0; i < 1000; i++)
+                sink = sink * 1664525u + 1013904223u;
+        }
+        RectDetector::infer(ctx);
+    }
+
+private:
+    double work_ms;
+};
+
+static bool same_plan(const SchedulingPlan &a, const SchedulingPlan &b)
+{
+    return a.infer_clusters == b.infer_clusters && a.infer_threads == b.infer_threads && a.pin_aux == b.pin_aux;
+}
+
+static double run_pipeline(const std::shared_ptr<Detector> &detector, const ImageBuffer &image, int frames,
+                           std::vector<BoxInfo> &last)
+{
+    PipelineOptions options;
+    options.drop_policy = BLOCK;
+    DetectPipeline pipeline(detector, options);
+
+    DetectResult result;
+    const double start = get_current_time();
+    for (int f = 0; f < frames; f++)
+    {
+        pipeline.submit(image, 0.5f, 0.5f);
+        while (pipeline.poll(result))
+            last = result.boxes;
+    }
+    pipeline.flush();
+    while (pipeline.poll(result))
+        last = result.boxes;
+    const double ms = get_current_time() - start;
+    pipeline.stop();
+    return ms / frames;
+}
+
+int main(int argc, char **argv)
+{
+    const int frames = argc > 1 ? atoi(argv[1]) : 100;
+    const double work_ms = argc > 2 ? atof(argv[2]) : 4.0;
+
+    const std::vector<CpuCluster> &clusters = cpu_clusters();
+    fprintf(stderr, "%d cores, layout %s\n", ncnn::get_cpu_count(), cpu_layout().c_str());
+    for (size_t i = 0; i < clusters.size(); i++)
+    {
+        fprintf(stderr, "  cluster %zu  %7d kHz  cpus", i, clusters[i].max_freq_khz);
+        for (int cpu : clusters[i].cpus)
+            fprintf(stderr, " %d", cpu);
+        fprintf(stderr, "\n");
+    }
+
+    std::vector<SchedulingPlan> candidates;
+    candidate_plans(candidates);
+    const int count = ncnn::get_cpu_count();
+    for (const SchedulingPlan &plan : candidates)
+    {
+        SchedulingPlan parsed;
+        if (!parse_plan(format_plan(plan), parsed) || !same_plan(plan, parsed))
+        {
+            fprintf(stderr, "plan %s does not survive parse_plan\n", format_plan(plan).c_str());
+            return -1;
+        }
+
+        ncnn::CpuSet infer, aux;
+        plan_cpusets(plan, infer, aux);
+        int shared = 0;
+        int covered = 0;
+        for (int cpu = 0; cpu < count; cpu++)
+        {
+            shared += infer.is_enabled(cpu) && aux.is_enabled(cpu);
+            covered += infer.is_enabled(cpu) || aux.is_enabled(cpu);
+        }
+        // cores are only shared when inference took all of them
+        if (infer.num_enabled() == 0 || (shared > 0 && infer.num_enabled() != count) || covered != count)
+        {
+            fprintf(stderr, "plan %s: %d inference cores, %d shared, %d of %d covered\n", format_plan(plan).c_str(),
+                    infer.num_enabled(), shared, covered, count);
+            return -1;
+        }
+    }
+
+    std::mt19937 rng(20240701);
+    std::uniform_int_distribution<int> noise(0, 100);
+    const int width = 640;
+    const int height = 480;
+    std::vector<unsigned char> pixels((size_t) width * height * 4);
+    for (auto &v : pixels)
+        v = (unsigned char) noise(rng);
+    for (int r = 0; r < 60; r++)
+        memset(pixels.data() + ((size_t) (100 + r) * width + 200) * 4, 255, 80 * 4);
+    ImageBuffer image = {pixels.data(), width, height, 0, PIXEL_FORMAT_RGBA};
+
+    // reference: no plan, the pipeline pins its stages with powersave
+    auto detector = std::make_shared<BusyDetector>(work_ms);
+    std::vector<BoxInfo> reference = detector->detect(image, 0.5f, 0.5f);
+    std::vector<BoxInfo> pipeline_boxes;
+    const double powersave_ms = run_pipeline(detector, image, frames, pipeline_boxes);
+    if (reference.empty() || !same_boxes(reference, pipeline_boxes))
+    {
+        fprintf(stderr, "pipeline boxes differ from detect()\n");
+        return -1;
+    }
+
+    std::vector<double> median_ms;
+    const double start = get_current_time();
+    const SchedulingPlan best = detector->autotune_scheduling(width, height, 8, &median_ms);
+    const double tune_ms = get_current_time() - start;
+    for (size_t i = 0; i < candidates.size(); i++)
+        fprintf(stderr, "  %-28s %7.2f ms%s\n", format_plan(candidates[i]).c_str(), median_ms[i],
+                same_plan(candidates[i], best) ? "  <- best" : "");
+    fprintf(stderr, "auto-tune took %.0f ms\n", tune_ms);
+
+    if (!same_boxes(reference, detector->detect(image, 0.5f, 0.5f)))
+    {
+        fprintf(stderr, "boxes differ under the tuned plan\n");
+        return -1;
+    }
+    const double tuned_ms = run_pipeline(detector, image, frames, pipeline_boxes);
+    if (!same_boxes(reference, pipeline_boxes))
+    {
+        fprintf(stderr, "pipeline boxes differ under the tuned plan\n");
+        return -1;
+    }
+
+    fprintf(stderr, "pipeline, powersave pinning  %7.2f ms/frame\n", powersave_ms);
+    fprintf(stderr, "pipeline, tuned plan         %7.2f ms/frame\n", tuned_ms);
+    return 0;
+}
@@ -0,0 +1,177 @@
+//
+// Runtime stats: what they cost per frame and whether they count right
+// Usage: bench_stats [frames] [infer_ms]
+// A stand-in whose infer() allocates its output from the context's blob pool, like an extractor does.
+// Checks that enabling the stats changes no box, that every stage of every detect() and pipeline frame
+// is counted, also with four threads detecting while a fifth takes snapshots, and that the trace holds
+// one event per stage and frame. Then times detect() with the stats on, on with tracing, and off.
+//
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "BenchUtils.h"
+#include "DetectPipeline.h"
+#include "RectDetector.h"
+
+class PooledRectDetector : public RectDetector {
+public:
+    explicit PooledRectDetector(double infer_ms) : RectDetector(infer_ms) {}
+
+    void infer(DetectContext &ctx) const override
+    {
+        RectDetector::infer(ctx);
+        ncnn::Mat plane = ctx.outputs[0];
+        ctx.outputs[0].release();
+        ctx.outputs[0].create(plane.w, plane.h, 1, 4u, &ctx.blob_allocator);
+        memcpy(ctx.outputs[0].data, plane.data, (size_t) plane.w * plane.h * 4);
+    }
+};
+
+static bool check_counts(const char *name, const StatsSnapshot &stats, uint64_t frames)
+{
+    bool ok = stats.frames == frames;
+    for (int s = 0; s < STAGE_COUNT; s++)
+        ok = ok && stats.stages[s].count == frames;
+    if (!ok)
+        fprintf(stderr, "%s: %llu frames, %llu preprocess, %llu nms, %llu total, expected %llu\n", name,
+                (unsigned long long) stats.frames, (unsigned long long) stats.stages[STAGE_PREPROCESS].count,
+                (unsigned long long) stats.stages[STAGE_NMS].count, (unsigned long long) stats.stages[STAGE_FRAME].count,
+                (unsigned long long) frames);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const int frames = argc > 1 ? atoi(argv[1]) : 200;
+    const double infer_ms = argc > 2 ? atof(argv[2]) : 0.0;
+
+    std::mt19937 rng(20240805);
+    std::uniform_int_distribution<int> noise(0, 100);
+    const int width = 640;
+    const int height = 480;
+    std::vector<unsigned char> pixels((size_t) width * height * 4);
+    for (auto &v : pixels)
+        v = (unsigned char) noise(rng);
+    for (int r = 0; r < 80; r++)
+    {
+        memset(pixels.data() + ((size_t) (60 + r) * width + 100) * 4, 255, 120 * 4);
+        memset(pixels.data() + ((size_t) (260 + r) * width + 400) * 4, 255, 60 * 4);
+    }
+    ImageBuffer image = {pixels.data(), width, height, 0, PIXEL_FORMAT_RGBA};
+
+    auto detector = std::make_shared<PooledRectDetector>(infer_ms);
+    const std::vector<BoxInfo> reference = detector->detect(image, 0.5f, 0.5f);
+    benchmark("detect, stats off", frames, [&]() { detector->detect(image, 0.5f, 0.5f); });
+    if (detector->get_stats().frames != 0)
+    {
+        fprintf(stderr, "frames counted with the stats off\n");
+        return -1;
+    }
+
+    // detect(): every stage once per frame, the same boxes
+    detector->set_stats_enabled(true);
+    for (int i = 0; i < frames; i++)
+    {
+        if (!same_boxes(reference, detector->detect(image, 0.5f, 0.5f)))
+        {
+            fprintf(stderr, "boxes differ with the stats on\n");
+            return -1;
+        }
+    }
+    StatsSnapshot stats = detector->get_stats();
+    if (!check_counts("detect", stats, frames))
+        return -1;
+    if (stats.max_proposals < reference.size() || std::abs(stats.mean_kept - reference.size()) > 1e-6)
+    {
+        fprintf(stderr, "%.1f boxes kept of at most %llu proposals, expected %d\n", stats.mean_kept,
+                (unsigned long long) stats.max_proposals, (int) reference.size());
+        return -1;
+    }
+    // the output blob comes back from the pool once the first frame has released it
+    if (stats.blob_hits == 0)
+    {
+        fprintf(stderr, "no blob pool hit in %d frames (%llu misses)\n", frames, (unsigned long long) stats.blob_misses);
+        return -1;
+    }
+    fprintf(stderr, "%s\n", format_stats(stats).c_str());
+
+    // pipeline frames go through begin_frame / end_frame
+    detector->reset_stats();
+    {
+        PipelineOptions options;
+        options.drop_policy = BLOCK;
+        DetectPipeline pipeline(detector, options);
+        DetectResult result;
+        for (int i = 0; i < frames; i++)
+        {
+            pipeline.submit(image, 0.5f, 0.5f);
+            while (pipeline.poll(result))
+            {
+            }
+        }
+        pipeline.flush();
+        pipeline.stop();
+    }
+    if (!check_counts("pipeline", detector->get_stats(), frames))
+        return -1;
+
+    // four threads detecting while another one reads snapshots
+    detector->reset_stats();
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        while (!done.load())
+        {
+            StatsSnapshot snapshot = detector->get_stats();
+            if (snapshot.stages[STAGE_FRAME].count > (uint64_t) frames)
+                fprintf(stderr, "snapshot ahead of the detections\n");
+        }
+    });
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++)
+        workers.emplace_back([&]() {
+            for (int i = 0; i < frames / 4; i++)
+                detector->detect(image, 0.5f, 0.5f);
+        });
+    for (auto &worker : workers)
+        worker.join();
+    done = true;
+    reader.join();
+    if (!check_counts("4 threads", detector->get_stats(), frames / 4 * 4))
+        return -1;
+
+    const double on_ms = benchmark("detect, stats on", frames, [&]() { detector->detect(image, 0.5f, 0.5f); });
+
+    // one trace event per stage and frame
+    detector->set_stats_enabled(true, 16384);
+    detector->reset_stats();
+    const double trace_ms = benchmark("detect, stats and trace", frames, [&]() { detector->detect(image, 0.5f, 0.5f); });
+    const char *trace_path = "bench_stats_trace.json";
+    if (!detector->write_trace(trace_path))
+    {
+        fprintf(stderr, "cannot write %s\n", trace_path);
+        return -1;
+    }
+    std::ifstream file(trace_path);
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string trace = text.str();
+    int events = 0;
+    for (size_t pos = trace.find("\"ph\": \"X\""); pos != std::string::npos; pos = trace.find("\"ph\": \"X\"", pos + 1))
+        events++;
+    // benchmark() runs 3 warm-up frames before the timed ones
+    if (events != (frames + 3) * STAGE_COUNT)
+    {
+        fprintf(stderr, "%d trace events, expected %d\n", events, (frames + 3) * STAGE_COUNT);
+        return -1;
+    }
+    remove(trace_path);
+
+    // timed again now the process is warm, the first round also paid for the page faults
+    detector->set_stats_enabled(false);
+    const double off_ms = benchmark("detect, stats off", frames, [&]() { detector->detect(image, 0.5f, 0.5f); });
+    fprintf(stderr, "stats cost %.1f us per frame, %.1f us with the trace\n", (on_ms - off_ms) * 1000,
+            (trace_ms - off_ms) * 1000);
+    return 0;
+}
@@ -0,0 +1,181 @@
+//
+// Streaming session: same boxes as detect(), memory fixed after the first frame
+// Usage: bench_stream [frames] [infer_ms]
+// A stand-in whose infer() goes through the detector's extractor and takes its output from the blob pool and a
+// scratch buffer from the workspace pool, like the layers of a net do. Checks that a session finds the boxes
+// detect() finds, that its pools stop growing once warmed up, that the footprint adds up and that a frame of
+// another size is turned away. A second stand-in alternates between two sets of scratch blocks, more than
+// ncnn's pool caches before it drops some: a pool left dropping misses on every frame, the session must stop
+// growing once both sets went through it.
+// Then times detect() against the session.
+//
+
+#include "BenchUtils.h"
+#include "RectDetector.h"
+#include "StreamSession.h"
+
+// ncnn's pools drop a cached block on a miss once they hold this many
+static const int ncnn_drop_threshold = 10;
+
+// Scratch blocks of growing size from the first one on, all alive at once and freed together
+static void use_scratch(ncnn::Allocator *allocator, int first, int blocks)
+{
+    std::vector<ncnn::Mat> scratch(blocks);
+    for (int i = 0; i < blocks; i++)
+    {
+        scratch[i].create(1024 * (first + i + 1), 4u, allocator);
+        memset(scratch[i].data, i, scratch[i].total() * 4);
+    }
+}
+
+class ExtractingRectDetector : public RectDetector {
+public:
+    explicit ExtractingRectDetector(double infer_ms, int extra_scratch = 0)
+        : RectDetector(infer_ms), extra_scratch(extra_scratch) {}
+
+    void infer(DetectContext &ctx) const override
+    {
+        run_extractor(ctx, [&ctx, this](ncnn::Extractor &ex) {
+            RectDetector::infer(ctx);
+            ncnn::Mat plane = ctx.outputs[0];
+            ncnn::Mat scratch(plane.w, plane.h, 4, 4u, &ctx.workspace_allocator);
+            ctx.outputs[0].release();
+            ctx.outputs[0].create(plane.w, plane.h, 1, 4u, &ctx.blob_allocator);
+            memcpy(scratch.data, plane.data, (size_t) plane.w * plane.h * 4);
+            memcpy(ctx.outputs[0].data, scratch.data, (size_t) plane.w * plane.h * 4);
+            // even and odd frames take different sizes
+            const int set = frame.fetch_add(1, std::memory_order_relaxed) % 2;
+            use_scratch(&ctx.workspace_allocator, set * extra_scratch, extra_scratch);
+        });
+    }
+
+private:
+    int extra_scratch;
+    mutable std::atomic<int> frame{0};
+};
+
+int main(int argc, char **argv)
+{
+    const int frames = argc > 1 ? atoi(argv[1]) : 200;
+    const double infer_ms = argc > 2 ? atof(argv[2]) : 0.0;
+
+    std::mt19937 rng(20240815);
+    std::uniform_int_distribution<int> noise(0, 100);
+    const int width = 640;
+    const int height = 480;
+    std::vector<unsigned char> pixels((size_t) width * height * 4);
+    for (auto &v : pixels)
+        v = (unsigned char) noise(rng);
+    for (int r = 0; r < 80; r++)
+    {
+        memset(pixels.data() + ((size_t) (60 + r) * width + 100) * 4, 255, 120 * 4);
+        memset(pixels.data() + ((size_t) (260 + r) * width + 400) * 4, 255, 60 * 4);
+    }
+    ImageBuffer image = {pixels.data(), width, height, 0, PIXEL_FORMAT_RGBA};
+
+    auto detector = std::make_shared<ExtractingRectDetector>(infer_ms);
+    const std::vector<BoxInfo> reference = detector->detect(image, 0.5f, 0.5f);
+    if (reference.empty())
+    {
+        fprintf(stderr, "no box in the test frame\n");
+        return -1;
+    }
+
+    StreamSession session(detector, width, height);
+    session.warm_up();
+    const StreamFootprint warm = session.footprint();
+    if (warm.pool_bytes == 0 || warm.peak_blob_bytes == 0 || warm.peak_workspace_bytes == 0 || warm.input_bytes == 0)
+    {
+        fprintf(stderr, "warm-up footprint: %s\n", format_footprint(warm).c_str());
+        return -1;
+    }
+
+    std::vector<BoxInfo> boxes;
+    for (int i = 0; i < frames; i++)
+    {
+        if (!session.detect(image, 0.5f, 0.5f, boxes) || !same_boxes(reference, boxes))
+        {
+            fprintf(stderr, "session boxes differ from detect() at frame %d\n", i);
+            return -1;
+        }
+    }
+    const StreamFootprint steady = session.footprint();
+    if (steady.frames != (uint64_t) frames + 1 || steady.grown_frames != 0 || steady.pool_bytes != warm.pool_bytes
+        || steady.peak_bytes != steady.peak_blob_bytes + steady.peak_workspace_bytes + steady.input_bytes)
+    {
+        fprintf(stderr, "pools grew after the first frame: %s, warm %llu bytes\n", format_footprint(steady).c_str(),
+                (unsigned long long) warm.pool_bytes);
+        return -1;
+    }
+    fprintf(stderr, "%s\n", format_footprint(steady).c_str());
+
+    // another size would change the letterbox, the session turns it away
+    std::vector<unsigned char> small((size_t) 320 * 240 * 4, 0);
+    ImageBuffer small_image = {small.data(), 320, 240, 0, PIXEL_FORMAT_RGBA};
+    if (session.detect(small_image, 0.5f, 0.5f, boxes) || !boxes.empty() || session.footprint().frames != steady.frames)
+    {
+        fprintf(stderr, "frame of another size accepted\n");
+        return -1;
+    }
+
+    // two sets of more blocks than ncnn's pool caches: left at the default it drops blocks of one set while
+    // serving the other, and allocates them again on the next frame
+    const int blocks = ncnn_drop_threshold + 2;
+    CountingPool<ncnn::PoolAllocator> dropping;
+    dropping.set_size_drop_threshold(ncnn_drop_threshold);
+    dropping.set_counting(true);
+    for (int i = 0; i < 10; i++)
+        use_scratch(&dropping, (i % 2) * blocks, blocks);
+    uint64_t dropping_hits, dropping_misses;
+    dropping.take_counts(dropping_hits, dropping_misses);
+    if (dropping_misses <= (uint64_t) 2 * blocks)
+    {
+        fprintf(stderr, "the pool kept both sets of %d blocks, the scene does not make it drop\n", blocks);
+        return -1;
+    }
+
+    // a session's pools keep both sets after the warm-up and one frame
+    auto deep_detector = std::make_shared<ExtractingRectDetector>(infer_ms, blocks);
+    StreamSession deep_session(deep_detector, width, height);
+    deep_session.warm_up();
+    deep_session.detect(image, 0.5f, 0.5f, boxes);
+    const StreamFootprint deep_warm = deep_session.footprint();
+    deep_detector->set_stats_enabled(true);
+    for (int i = 0; i < 20; i++)
+    {
+        if (!deep_session.detect(image, 0.5f, 0.5f, boxes) || !same_boxes(reference, boxes))
+        {
+            fprintf(stderr, "session boxes differ from detect() with %d scratch blocks\n", blocks);
+            return -1;
+        }
+    }
+    const StatsSnapshot deep_stats = deep_detector->get_stats();
+    const StreamFootprint deep = deep_session.footprint();
+    if (deep.grown_frames != deep_warm.grown_frames || deep.pool_bytes != deep_warm.pool_bytes || deep_stats.workspace_misses != 0
+        || deep_stats.workspace_hits < (uint64_t) 20 * blocks)
+    {
+        fprintf(stderr, "pools dropped blocks with %d scratch blocks: %s, %s\n", blocks, format_footprint(deep).c_str(),
+                format_stats(deep_stats).c_str());
+        return -1;
+    }
+    fprintf(stderr, "%d scratch blocks: left dropping, the pool missed %llu of %llu; session %s\n", blocks,
+            (unsigned long long) dropping_misses, (unsigned long long) (dropping_hits + dropping_misses),
+            format_footprint(deep).c_str());
+
+    // stats go on recording session frames
+    detector->set_stats_enabled(true);
+    for (int i = 0; i < 10; i++)
+        session.detect(image, 0.5f, 0.5f, boxes);
+    if (detector->get_stats().frames != 10 || detector->get_stats().blob_misses != 0)
+    {
+        fprintf(stderr, "%s\n", format_stats(detector->get_stats()).c_str());
+        return -1;
+    }
+    detector->set_stats_enabled(false);
+
+    const double detect_ms = benchmark("detect()", frames, [&]() { detector->detect(image, 0.5f, 0.5f, boxes); });
+    const double session_ms = benchmark("stream session", frames, [&]() { session.detect(image, 0.5f, 0.5f, boxes); });
+    fprintf(stderr, "session saves %.1f us per frame, %llu frames grew the pools\n", (detect_ms - session_ms) * 1000,
+            (unsigned long long) session.footprint().grown_frames);
+    return session.footprint().grown_frames == 0 ? 0 : -1;
+}
@@ -0,0 +1,192 @@
+//
+// Temporal reuse on a fixed-camera video: detect() on every frame vs TemporalDetector
+// Usage: bench_temporal [num_frames] [infer_ms]
+// Objects drift slowly, speed up in the middle of the clip, and the lighting changes once;
+// RectDetector stands in for the network.
+//
+
+#include <cmath>
+#include "BenchUtils.h"
+#include "RectDetector.h"
+#include "TemporalDetector.h"
+
+static const int width = 640;
+static const int height = 480;
+static const int num_objects = 6;
+
+static float iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    return iw * ih / (a.w * a.h + b.w * b.h - iw * ih);
+}
+
+// Objects bounce around the frame, fast between 40% and 60% of the clip
+static void render(int frame, int num_frames, const std::vector<unsigned char> &background,
+                   std::vector<unsigned char> &pixels, std::vector<BoxInfo> &truth)
+{
+    pixels = background;
+    // lights go up for the last quarter
+    if (frame >= num_frames * 3 / 4)
+    {
+        for (auto &v : pixels)
+            v = (unsigned char) std::min(v + 20, 120);
+    }
+
+    const int fast_begin = num_frames * 2 / 5;
+    const int fast_end = num_frames * 3 / 5;
+    const float t = (float) std::min(frame, fast_begin) + 6.f * (std::min(std::max(frame, fast_begin), fast_end) - fast_begin)
+                    + (float) (std::max(frame, fast_end) - fast_end);
+
+    truth.resize(num_objects);
+    for (int i = 0; i < num_objects; i++)
+    {
+        const int size = 36 + 8 * i;
+        const float range_x = (float) (width - size);
+        const float range_y = (float) (height - size);
+        // triangle waves, a different speed and phase for every object
+        float x = std::fmod(60.f * i + t * (0.6f + 0.15f * i), 2 * range_x);
+        float y = std::fmod(45.f * i + t * (0.4f + 0.1f * i), 2 * range_y);
+        x = x > range_x ? 2 * range_x - x : x;
+        y = y > range_y ? 2 * range_y - y : y;
+
+        truth[i].x1 = std::floor(x);
+        truth[i].y1 = std::floor(y);
+        truth[i].w = (float) size;
+        truth[i].h = (float) size;
+        truth[i].score = 1.f;
+        truth[i].label = 0;
+        for (int r = 0; r < size; r++)
+            memset(pixels.data() + ((size_t) (truth[i].y1 + r) * width + (size_t) truth[i].x1) * 4, 255, (size_t) size * 4);
+    }
+}
+
+struct Score {
+    double iou_sum = 0;
+    int matched = 0;
+    int total = 0;
+    int id_switches = 0;
+};
+
+// Objects overlapping each other are skipped, the stand-in detector sees them as one
+static void score_frame(const std::vector<BoxInfo> &truth, const std::vector<BoxInfo> &boxes,
+                        const std::vector<int> *track_ids, std::vector<int> &last_ids, Score &score)
+{
+    for (int i = 0; i < (int) truth.size(); i++)
+    {
+        bool overlapped = false;
+        for (int j = 0; j < (int) truth.size(); j++)
+            overlapped |= j != i && iou(truth[i], truth[j]) > 0.f;
+        if (overlapped)
+            continue;
+
+        float best = 0.f;
+        int best_box = -1;
+        for (int b = 0; b < (int) boxes.size(); b++)
+        {
+            const float v = iou(truth[i], boxes[b]);
+            if (v > best)
+            {
+                best = v;
+                best_box = b;
+            }
+        }
+
+        score.total++;
+        score.iou_sum += best;
+        if (best >= 0.5f)
+        {
+            score.matched++;
+            if (track_ids)
+            {
+                const int id = (*track_ids)[best_box];
+                if (last_ids[i] >= 0 && last_ids[i] != id)
+                    score.id_switches++;
+                last_ids[i] = id;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int num_frames = argc > 1 ? atoi(argv[1]) : 400;
+    const double infer_ms = argc > 2 ? atof(argv[2]) : 8.0;
+
+    std::mt19937 rng(20240620);
+    std::uniform_int_distribution<int> noise(0, 100);
+    std::vector<unsigned char> background((size_t) width * height * 4);
+    for (auto &v : background)
+        v = (unsigned char) noise(rng);
+
+    auto detector = std::make_shared<RectDetector>(infer_ms);
+
+    ImageBuffer image;
+    image.width = width;
+    image.height = height;
+    image.stride = 0;
+    image.format = PIXEL_FORMAT_RGBA;
+
+    std::vector<unsigned char> pixels;
+    std::vector<BoxInfo> truth;
+    std::vector<BoxInfo> boxes;
+    std::vector<int> track_ids;
+    std::vector<int> last_ids(num_objects, -1);
+
+    // every frame through the network
+    Score every;
+    double every_ms = 0;
+    for (int f = 0; f < num_frames; f++)
+    {
+        render(f, num_frames, background, pixels, truth);
+        image.data = pixels.data();
+        const double start = get_current_time();
+        detector->detect(image, 0.5f, 0.5f, boxes);
+        every_ms += get_current_time() - start;
+        score_frame(truth, boxes, nullptr, last_ids, every);
+    }
+
+    // key frames only, per segment of the clip to show the cadence follow the motion
+    TemporalOptions options;
+    TemporalDetector temporal(detector, options);
+    Score reuse;
+    double reuse_ms = 0;
+    const int segments[5] = {0, num_frames * 2 / 5, num_frames * 3 / 5, num_frames * 3 / 4, num_frames};
+    const char *segment_names[4] = {"slow", "fast", "slow", "lights up"};
+    int segment = 0;
+    long long segment_keys = temporal.key_frames();
+    std::fill(last_ids.begin(), last_ids.end(), -1);
+    for (int f = 0; f < num_frames; f++)
+    {
+        render(f, num_frames, background, pixels, truth);
+        image.data = pixels.data();
+        const double start = get_current_time();
+        temporal.detect(image, 0.5f, 0.5f, boxes, track_ids);
+        reuse_ms += get_current_time() - start;
+        score_frame(truth, boxes, &track_ids, last_ids, reuse);
+
+        if (f + 1 == segments[segment + 1])
+        {
+            fprintf(stderr, "  %-10s frames %3d-%3d  key frames %3lld\n", segment_names[segment], segments[segment], f,
+                    temporal.key_frames() - segment_keys);
+            segment_keys = temporal.key_frames();
+            segment++;
+        }
+    }
+
+    fprintf(stderr, "every frame   %6.2f ms/frame  recall %5.1f%%  mean IoU %.3f\n",
+            every_ms / num_frames, 100.0 * every.matched / every.total, every.iou_sum / every.total);
+    fprintf(stderr, "key frames    %6.2f ms/frame  recall %5.1f%%  mean IoU %.3f  detected %lld / %d frames  id switches %d\n",
+            reuse_ms / num_frames, 100.0 * reuse.matched / reuse.total, reuse.iou_sum / reuse.total,
+            temporal.key_frames(), num_frames, reuse.id_switches);
+
+    if (reuse.matched < every.matched * 95 / 100)
+    {
+        fprintf(stderr, "tracked boxes lose too many objects\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+//
+// Tiled detection of small objects on a high-resolution still: detect() vs detect_tiled()
+// Usage: bench_tiled [width height]
+// RectDetector stands in for the network. A crowd of two overlapping objects inside one tile must keep both boxes
+// through the tile merge.
+//
+
+#include <memory>
+#include "BenchUtils.h"
+#include "RectDetector.h"
+
+static float iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    return iw * ih / (a.w * a.h + b.w * b.h - iw * ih);
+}
+
+// Ground truth objects found with IoU >= 0.5, and boxes matching none of them
+static void score_boxes(const std::vector<BoxInfo> &truth, const std::vector<BoxInfo> &boxes, int &found, int &extra)
+{
+    std::vector<char> used(boxes.size(), 0);
+    found = 0;
+    for (const BoxInfo &object : truth)
+    {
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            if (!used[i] && iou(object, boxes[i]) >= 0.5f)
+            {
+                used[i] = 1;
+                found++;
+                break;
+            }
+        }
+    }
+    extra = (int) std::count(used.begin(), used.end(), 0);
+}
+
+int main(int argc, char **argv)
+{
+    const int width = argc > 2 ? atoi(argv[1]) : 4000;
+    const int height = argc > 2 ? atoi(argv[2]) : 3000;
+
+    std::mt19937 rng(20240615);
+
+    // black photo with small objects scattered over it and a few large ones spanning several tiles
+    std::vector<unsigned char> pixels((size_t) width * height * 4, 0);
+    std::vector<BoxInfo> truth;
+    auto add_object = [&](int w, int h) {
+        BoxInfo object;
+        object.x1 = (float) (rng() % (width - w));
+        object.y1 = (float) (rng() % (height - h));
+        object.w = (float) w;
+        object.h = (float) h;
+        object.score = 1.f;
+        object.label = 0;
+        for (const BoxInfo &other : truth)
+        {
+            // keep a gap so two objects never touch
+            if (object.x1 < other.x1 + other.w + 8 && other.x1 < object.x1 + object.w + 8 &&
+                object.y1 < other.y1 + other.h + 8 && other.y1 < object.y1 + object.h + 8)
+                return;
+        }
+        for (int y = (int) object.y1; y < (int) (object.y1 + object.h); y++)
+            memset(pixels.data() + ((size_t) y * width + (int) object.x1) * 4, 255, (size_t) w * 4);
+        truth.push_back(object);
+    };
+
+    // crowd: a hollow box with a solid one inside, same label, both inside a single tile and no other one.
+    // Every tile keeps both (IoU 0.16), the merge must not fuse them either.
+    const int ring = 200;
+    const int ring_edge = 12;
+    const int inner = 80;
+    BoxInfo ring_box = {0.f, 0.f, (float) ring, (float) ring, 1.f, 0};
+    BoxInfo inner_box = {0.f, 0.f, (float) inner, (float) inner, 1.f, 0};
+    {
+        // the grid detect_tiled() uses for RectDetector's 320 input and the default options
+        const TileOptions defaults;
+        int tile_size = 320;
+        std::vector<TileRect> tiles;
+        compute_tiles(width, height, tile_size, defaults.overlap, tiles);
+        while ((int) tiles.size() > defaults.max_tiles)
+        {
+            tile_size = tile_size * 5 / 4;
+            compute_tiles(width, height, tile_size, defaults.overlap, tiles);
+        }
+        const TileRect &home = tiles[tiles.size() / 2];
+        auto inside = [](int x, int y, const TileRect &t) {
+            return x >= t.x && y >= t.y && x + ring <= t.x + t.w && y + ring <= t.y + t.h;
+        };
+        auto touches = [](int x, int y, const TileRect &t) {
+            return x < t.x + t.w && t.x < x + ring && y < t.y + t.h && t.y < y + ring;
+        };
+        bool placed = false;
+        for (int y = home.y; y + ring <= home.y + home.h && !placed; y += 8)
+        {
+            for (int x = home.x; x + ring <= home.x + home.w && !placed; x += 8)
+            {
+                placed = inside(x, y, home);
+                for (const TileRect &tile : tiles)
+                    placed = placed && (&tile == &home || !touches(x, y, tile));
+                if (placed)
+                {
+                    ring_box.x1 = (float) x;
+                    ring_box.y1 = (float) y;
+                }
+            }
+        }
+        if (!placed)
+        {
+            fprintf(stderr, "no tile has room for the crowd scene\n");
+            return -1;
+        }
+    }
+    inner_box.x1 = ring_box.x1 + (ring - inner) / 2;
+    inner_box.y1 = ring_box.y1 + (ring - inner) / 2;
+    for (int y = (int) ring_box.y1; y < (int) ring_box.y1 + ring; y++)
+    {
+        unsigned char *row = pixels.data() + ((size_t) y * width + (int) ring_box.x1) * 4;
+        const bool edge_row = y < (int) ring_box.y1 + ring_edge || y >= (int) ring_box.y1 + ring - ring_edge;
+        memset(row, 255, (size_t) (edge_row ? ring : ring_edge) * 4);
+        memset(row + (ring - ring_edge) * 4, 255, (size_t) ring_edge * 4);
+    }
+    for (int y = (int) inner_box.y1; y < (int) inner_box.y1 + inner; y++)
+        memset(pixels.data() + ((size_t) y * width + (int) inner_box.x1) * 4, 255, (size_t) inner * 4);
+    truth.push_back(ring_box);
+    truth.push_back(inner_box);
+
+    for (int i = 0; i < 4; i++)
+        add_object(width / 4 + (int) (rng() % 200), height / 4 + (int) (rng() % 200));
+    for (int i = 0; i < 200; i++)
+        add_object(16 + (int) (rng() % 24), 16 + (int) (rng() % 24));
+
+    ImageBuffer image;
+    image.data = pixels.data();
+    image.width = width;
+    image.height = height;
+    image.stride = 0;
+    image.format = PIXEL_FORMAT_RGBA;
+
+    RectDetector detector;
+    fprintf(stderr, "%dx%d photo, %d objects\n", width, height, (int) truth.size());
+
+    std::vector<BoxInfo> plain;
+    std::vector<BoxInfo> tiled_nms;
+    std::vector<BoxInfo> tiled_union;
+    TileOptions nms_options;
+    nms_options.merge = TILE_MERGE_NMS;
+    TileOptions union_options;
+    union_options.merge = TILE_MERGE_UNION;
+
+    const double plain_ms = benchmark("detect", 5, [&]() { detector.detect(image, 0.5f, 0.5f, plain); });
+    const double nms_ms = benchmark("detect_tiled nms merge", 5, [&]() {
+        detector.detect_tiled(image, 0.5f, 0.5f, nms_options, tiled_nms);
+    });
+    const double union_ms = benchmark("detect_tiled union merge", 5, [&]() {
+        detector.detect_tiled(image, 0.5f, 0.5f, union_options, tiled_union);
+    });
+
+    int found, extra;
+    score_boxes(truth, plain, found, extra);
+    fprintf(stderr, "detect                    recall %5.1f%%  unmatched boxes %d  %.1f ms\n",
+            100.f * found / truth.size(), extra, plain_ms);
+    score_boxes(truth, tiled_nms, found, extra);
+    fprintf(stderr, "detect_tiled nms merge    recall %5.1f%%  unmatched boxes %d  %.1f ms\n",
+            100.f * found / truth.size(), extra, nms_ms);
+    const int nms_found = found;
+    score_boxes(truth, tiled_union, found, extra);
+    fprintf(stderr, "detect_tiled union merge  recall %5.1f%%  unmatched boxes %d  %.1f ms\n",
+            100.f * found / truth.size(), extra, union_ms);
+
+    if (found < nms_found || found < (int) truth.size() * 9 / 10)
+    {
+        fprintf(stderr, "tiled detection misses objects\n");
+        return -1;
+    }
+
+    // both objects of the crowd scene survive either merge
+    for (const std::vector<BoxInfo> *boxes : {&tiled_nms, &tiled_union})
+    {
+        int crowd_found, crowd_extra;
+        score_boxes({ring_box, inner_box}, *boxes, crowd_found, crowd_extra);
+        if (crowd_found != 2)
+        {
+            fprintf(stderr, "%s merge lost an object nested in another one\n", boxes == &tiled_nms ? "nms" : "union");
+            return -1;
+        }
+    }
+
+    return 0;
+}
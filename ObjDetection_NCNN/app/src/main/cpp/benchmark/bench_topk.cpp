@@ -0,0 +1,106 @@
+//
+// Candidate selection: recursive OpenMP-sections quicksort of every proposal vs bounded top-K selection
+//
+
+#include "BenchUtils.h"
+#include "PostProcess.h"
+
+// The sort YOLOv5s.cpp and NanoDetPlus.cpp used before select_topk_descent
+static void qsort_descent_inplace(std::vector<BoxInfo> &faceobjects, int left, int right)
+{
+    int i = left;
+    int j = right;
+    float p = faceobjects[(left + right) / 2].score;
+
+    while (i <= j)
+    {
+        while (faceobjects[i].score > p)
+            i++;
+
+        while (faceobjects[j].score < p)
+            j--;
+
+        if (i <= j)
+        {
+            // swap
+            std::swap(faceobjects[i], faceobjects[j]);
+
+            i++;
+            j--;
+        }
+    }
+
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            if (left < j) qsort_descent_inplace(faceobjects, left, j);
+        }
+        #pragma omp section
+        {
+            if (i < right) qsort_descent_inplace(faceobjects, i, right);
+        }
+    }
+}
+
+static void qsort_descent_inplace(std::vector<BoxInfo> &faceobjects)
+{
+    if (faceobjects.empty())
+        return;
+
+    qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
+}
+
+int main(int argc, char **argv)
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 20;
+    int topk = argc > 2 ? atoi(argv[2]) : 1000;
+
+    std::mt19937 rng(20240302);
+    std::uniform_real_distribution<float> score(0.25f, 1.f);
+
+    const int counts[7] = {100, 500, 1000, 2000, 5000, 10000, 50000};
+    for (int count : counts)
+    {
+        std::vector<BoxInfo> proposals(count);
+        for (int i = 0; i < count; i++)
+        {
+            proposals[i].x1 = (float) i;
+            proposals[i].y1 = 0.f;
+            proposals[i].w = 1.f;
+            proposals[i].h = 1.f;
+            proposals[i].score = score(rng);
+            proposals[i].label = i % 80;
+        }
+
+        std::vector<BoxInfo> sorted = proposals;
+        qsort_descent_inplace(sorted);
+        std::vector<BoxInfo> selected = proposals;
+        select_topk_descent(selected, topk);
+
+        // the selection must be exactly the head of the full sort
+        size_t expected = std::min((size_t) count, (size_t) topk);
+        bool same = selected.size() == expected;
+        for (size_t i = 0; same && i < expected; i++)
+            same = selected[i].score == sorted[i].score;
+        if (!same)
+        {
+            fprintf(stderr, "%d proposals: top-%d selection differs from the sorted head\n", count, topk);
+            return -1;
+        }
+
+        std::vector<BoxInfo> work;
+        fprintf(stderr, "%d proposals, top-%d\n", count, topk);
+        double time_qsort = benchmark("  omp sections qsort", loops, [&]() {
+            work = proposals;
+            qsort_descent_inplace(work);
+        });
+        double time_topk = benchmark("  top-k selection", loops, [&]() {
+            work = proposals;
+            select_topk_descent(work, topk);
+        });
+        fprintf(stderr, "  speedup x%.2f\n", time_qsort / time_topk);
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+//
+// YOLOv5 proposal decoding: reference per-cell argmax decoder vs threshold-first vectorized decoder
+// Synthetic 640x640 head outputs, mostly background with a sprinkle of confident cells
+//
+
+#include <cfloat>
+#include <cmath>
+#include "BenchUtils.h"
+#include "Decoder.h"
+
+static inline float sigmoid(float x)
+{
+    return static_cast<float>(1.f / (1.f + expf(-x)));
+}
+
+// The decoder YOLOv5s.cpp used before generate_proposals_yolov5
+static void generate_proposals_reference(const ncnn::Mat &anchors, int stride, const ncnn::Mat &feat_blob, float prob_threshold, std::vector<BoxInfo> &objects)
+{
+    const int num_grid_x = feat_blob.w;
+    const int num_grid_y = feat_blob.h;
+
+    const int num_anchors = anchors.w / 2;
+
+    const int num_class = feat_blob.c / num_anchors - 5;
+
+    const int feat_offset = num_class + 5;
+
+    for (int q = 0; q < num_anchors; q++)
+    {
+        const float anchor_w = anchors[q * 2];
+        const float anchor_h = anchors[q * 2 + 1];
+
+        for (int i = 0; i < num_grid_y; i++)
+        {
+            for (int j = 0; j < num_grid_x; j++)
+            {
+                int class_index = 0;
+                float class_score = -FLT_MAX;
+                for (int k = 0; k < num_class; k++)
+                {
+                    float score = feat_blob.channel(q * feat_offset + 5 + k).row(i)[j];
+                    if (score > class_score)
+                    {
+                        class_index = k;
+                        class_score = score;
+                    }
+                }
+
+                float box_score = feat_blob.channel(q * feat_offset + 4).row(i)[j];
+
+                float confidence = sigmoid(box_score) * sigmoid(class_score);
+
+                if (confidence >= prob_threshold)
+                {
+                    float dx = sigmoid(feat_blob.channel(q * feat_offset + 0).row(i)[j]);
+                    float dy = sigmoid(feat_blob.channel(q * feat_offset + 1).row(i)[j]);
+                    float dw = sigmoid(feat_blob.channel(q * feat_offset + 2).row(i)[j]);
+                    float dh = sigmoid(feat_blob.channel(q * feat_offset + 3).row(i)[j]);
+
+                    float pb_cx = (dx * 2.f - 0.5f + j) * stride;
+                    float pb_cy = (dy * 2.f - 0.5f + i) * stride;
+
+                    float pb_w = pow(dw * 2.f, 2) * anchor_w;
+                    float pb_h = pow(dh * 2.f, 2) * anchor_h;
+
+                    float x0 = pb_cx - pb_w * 0.5f;
+                    float y0 = pb_cy - pb_h * 0.5f;
+                    float x1 = pb_cx + pb_w * 0.5f;
+                    float y1 = pb_cy + pb_h * 0.5f;
+
+                    BoxInfo obj;
+                    obj.x1 = x0;
+                    obj.y1 = y0;
+                    obj.w = x1 - x0;
+                    obj.h = y1 - y0;
+                    obj.label = class_index;
+                    obj.score = confidence;
+
+                    objects.push_back(obj);
+                }
+            }
+        }
+    }
+}
+
+static ncnn::Mat make_head(int grid, int num_class, float positive_ratio, std::mt19937 &rng)
+{
+    const int num_anchors = 3;
+    const int feat_offset = num_class + 5;
+
+    ncnn::Mat feat(grid, grid, num_anchors * feat_offset);
+
+    std::normal_distribution<float> background(-7.f, 2.f);
+    std::normal_distribution<float> foreground(1.5f, 1.5f);
+    std::normal_distribution<float> coord(0.f, 1.f);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    std::uniform_int_distribution<int> label(0, num_class - 1);
+
+    for (int q = 0; q < num_anchors; q++)
+    {
+        for (int i = 0; i < grid; i++)
+        {
+            for (int j = 0; j < grid; j++)
+            {
+                bool positive = uniform(rng) < positive_ratio;
+                for (int k = 0; k < 4; k++)
+                    feat.channel(q * feat_offset + k).row(i)[j] = coord(rng);
+                feat.channel(q * feat_offset + 4).row(i)[j] = positive ? foreground(rng) : background(rng);
+
+                int hot = label(rng);
+                for (int k = 0; k < num_class; k++)
+                    feat.channel(q * feat_offset + 5 + k).row(i)[j] = (positive && k == hot) ? foreground(rng) : background(rng);
+            }
+        }
+    }
+
+    return feat;
+}
+
+int main(int argc, char **argv)
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 50;
+
+    const int num_class = 80;
+    const int strides[3] = {8, 16, 32};
+    const float anchor_values[3][6] = {
+            {10.f,  13.f, 16.f,  30.f,  33.f,  23.f},
+            {30.f,  61.f, 62.f,  45.f,  59.f,  119.f},
+            {116.f, 90.f, 156.f, 198.f, 373.f, 326.f},
+    };
+
+    std::mt19937 rng(20230611);
+
+    ncnn::Mat feats[3];
+    ncnn::Mat anchors[3];
+    for (int s = 0; s < 3; s++)
+    {
+        feats[s] = make_head(640 / strides[s], num_class, 0.01f, rng);
+        anchors[s].create(6);
+        for (int k = 0; k < 6; k++)
+            anchors[s][k] = anchor_values[s][k];
+    }
+
+    const float thresholds[3] = {0.25f, 0.3f, 0.5f};
+    for (float threshold : thresholds)
+    {
+        std::vector<BoxInfo> reference;
+        std::vector<BoxInfo> optimized;
+
+        auto run_reference = [&]() {
+            reference.clear();
+            for (int s = 0; s < 3; s++)
+                generate_proposals_reference(anchors[s], strides[s], feats[s], threshold, reference);
+        };
+        auto run_optimized = [&]() {
+            optimized.clear();
+            for (int s = 0; s < 3; s++)
+                generate_proposals_yolov5(anchors[s], strides[s], feats[s], threshold, optimized);
+        };
+        // class count taken from the blob at run time, what a model with an unusual class count gets
+        std::vector<BoxInfo> generic;
+        YoloDecoder generic_decoder = select_yolov5_decoder(0);
+        auto run_generic = [&]() {
+            generic.clear();
+            for (int s = 0; s < 3; s++)
+                generic_decoder(anchors[s], strides[s], feats[s], threshold, generic);
+        };
+
+        run_reference();
+        run_optimized();
+        run_generic();
+        if (!same_boxes(reference, optimized) || !same_boxes(reference, generic))
+        {
+            fprintf(stderr, "threshold %.2f: decoders disagree (%zu vs %zu boxes)\n", threshold, reference.size(), optimized.size());
+            return -1;
+        }
+
+        fprintf(stderr, "threshold %.2f, %zu proposals\n", threshold, reference.size());
+        double time_reference = benchmark("  reference", loops, run_reference);
+        double time_generic = benchmark("  threshold-first, generic class loop", loops, run_generic);
+        double time_optimized = benchmark("  threshold-first, 80 classes", loops, run_optimized);
+        fprintf(stderr, "  speedup x%.2f (generic x%.2f)\n", time_reference / time_optimized, time_reference / time_generic);
+    }
+
+    return 0;
+}
@@ -3,91 +3,981 @@
 #include <ncnn/gpu.h>
 #include <android/asset_manager_jni.h>
 #include <android/log.h>
+#include <android/bitmap.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "NanoDetPlus.h"
 #include "YOLOv5s.h"
+#include "DetectPipeline.h"
+#include "DetectorRegistry.h"
+#include "MotionRoi.h"
+#include "StreamSession.h"
+#include "TemporalDetector.h"
 
+// Loaded models by class name, init() hot-swaps an entry while other threads keep detecting
+static DetectorRegistry registry;
+
+// Camera pipeline, swapped under pipeline_mutex and used outside of it
+static std::mutex pipeline_mutex;
+static std::shared_ptr<DetectPipeline> pipeline;
+
+// Finish the frames in flight, the pipeline must be gone before its detector is deleted
+static void stop_pipeline() {
+    std::shared_ptr<DetectPipeline> old;
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        old.swap(pipeline);
+    }
+    if (old)
+        old->stop();
+}
+
+// Video temporal mode, one stream at a time; detect() runs on the decoding thread under temporal_mutex
+static std::mutex temporal_mutex;
+static std::unique_ptr<TemporalDetector> temporal;
+
+static void stop_temporal() {
+    std::lock_guard<std::mutex> lock(temporal_mutex);
+    temporal.reset();
+}
+
+// Still-camera ROI mode, same rules
+static std::mutex roi_mutex;
+static std::unique_ptr<RoiDetector> roi;
+
+static void stop_roi() {
+    std::lock_guard<std::mutex> lock(roi_mutex);
+    roi.reset();
+}
+
+// Fixed-size camera stream, same rules
+static std::mutex stream_mutex;
+static std::unique_ptr<StreamSession> stream;
+
+static void stop_stream() {
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    stream.reset();
+}
+
+// Inflated copies of compressed weight assets go here, set by the app before it loads a model
+static std::mutex cache_dir_mutex;
+static std::string cache_dir;
+
+// <name>.param.bin when the assets have one (ncnn2mem), <name>.param otherwise; nullptr and the
+// LoadError in error when the model does not load
+static std::shared_ptr<GenericDetector> load_detector(AAssetManager *mgr, const std::string &name, const ModelConfig &config,
+                                                      bool useGPU, int threads_number, int &error) {
+    std::string param = name + ".param.bin";
+    AAsset *asset = AAssetManager_open(mgr, param.c_str(), AASSET_MODE_UNKNOWN);
+    if (asset)
+        AAsset_close(asset);
+    else
+        param = name + ".param";
+
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(cache_dir_mutex);
+        dir = cache_dir;
+    }
+    auto detector = std::make_shared<GenericDetector>(mgr, config, param.c_str(), (name + ".bin").c_str(), useGPU,
+                                                      threads_number, dir.c_str());
+    error = detector->load_error();
+    if (error != LOAD_OK) {
+        __android_log_print(ANDROID_LOG_ERROR, "objdetection", "%s: %s", name.c_str(), load_error_string(error));
+        return nullptr;
+    }
+    return detector;
+}
+
+// Same model ids as MainActivity
+static std::shared_ptr<Detector> model_detector(jint model) {
+    if (model == 1)
+        return registry.get("NanoDetPlus");
+    if (model == 2)
+        return registry.get("YOLOv5s");
+    return nullptr;
+}
+
+// Classes and constructors of the result objects, looked up once in JNI_OnLoad
+static struct {
+    jclass box_cls;
+    jmethodID box_init;
+    jclass box_array_cls;
+    jclass result_cls;
+    jmethodID result_init;
+} java;
+
+static jclass find_global_class(JNIEnv *env, const char *name) {
+    jclass local = env->FindClass(name);
+    if (local == nullptr) {
+        env->ExceptionClear();
+        return nullptr;
+    }
+    auto global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+static std::shared_ptr<DetectPipeline> current_pipeline() {
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    return pipeline;
+}
+
+// Expose the pixels of an ARGB_8888 Bitmap to the platform-neutral detectors
+// The pixels stay locked until unlock_bitmap is called
+static bool lock_bitmap(JNIEnv *env, jobject bitmap, ImageBuffer &image) {
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS)
+        return false;
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888)
+        return false;
+
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS || pixels == nullptr)
+        return false;
+
+    image.data = (const unsigned char *) pixels;
+    image.width = (int) info.width;
+    image.height = (int) info.height;
+    image.stride = (int) info.stride;
+    image.format = PIXEL_FORMAT_RGBA;
+    return true;
+}
+
+static void unlock_bitmap(JNIEnv *env, jobject bitmap) {
+    AndroidBitmap_unlockPixels(env, bitmap);
+}
+
+// Wrap the direct ByteBuffers of ImageProxy.planes, valid until the ImageProxy is closed
+static bool wrap_yuv_planes(JNIEnv *env, jobject y, jobject u, jobject v, jint width, jint height, jint y_row_stride,
+                            jint uv_row_stride, jint uv_pixel_stride, jint rotation, YuvImageBuffer &image) {
+    image.y = (const unsigned char *) env->GetDirectBufferAddress(y);
+    image.u = (const unsigned char *) env->GetDirectBufferAddress(u);
+    image.v = (const unsigned char *) env->GetDirectBufferAddress(v);
+    if (image.y == nullptr || image.u == nullptr || image.v == nullptr)
+        return false;
+    if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270)
+        return false;
+
+    image.width = width;
+    image.height = height;
+    image.y_row_stride = y_row_stride;
+    image.uv_row_stride = uv_row_stride;
+    image.uv_pixel_stride = uv_pixel_stride;
+    image.rotation = rotation;
+    return true;
+}
+
+static jobjectArray to_box_array(JNIEnv *env, const std::vector<BoxInfo> &result) {
+    jobjectArray ret = env->NewObjectArray(result.size(), java.box_cls, nullptr);
+    int i = 0;
+    for (auto &box:result) {
+        jobject obj = env->NewObject(java.box_cls, java.box_init, box.x1, box.y1, box.w, box.h, box.label, box.score);
+        env->SetObjectArrayElement(ret, i++, obj);
+        env->DeleteLocalRef(obj);
+    }
+    return ret;
+}
+
+// Copy the boxes into caller-owned direct buffers in native byte order (see BoxBuffer.kt):
+// x1, y1, w, h, score per box in boxes and the label in labels. Boxes come sorted by score,
+// the ones that don't fit are dropped. Returns the number written, -1 if a buffer is not direct.
+static jint write_boxes(JNIEnv *env, const std::vector<BoxInfo> &result, jobject boxes, jobject labels) {
+    auto box_data = (float *) env->GetDirectBufferAddress(boxes);
+    auto label_data = (int *) env->GetDirectBufferAddress(labels);
+    if (box_data == nullptr || label_data == nullptr)
+        return -1;
+
+    size_t capacity = std::min((size_t) env->GetDirectBufferCapacity(boxes) / 5, (size_t) env->GetDirectBufferCapacity(labels));
+    size_t count = std::min(result.size(), capacity);
+    for (size_t i = 0; i < count; i++) {
+        const BoxInfo &box = result[i];
+        box_data[i * 5] = box.x1;
+        box_data[i * 5 + 1] = box.y1;
+        box_data[i * 5 + 2] = box.w;
+        box_data[i * 5 + 3] = box.h;
+        box_data[i * 5 + 4] = box.score;
+        label_data[i] = box.label;
+    }
+    return (jint) count;
+}
+
+// Lock every bitmap of the array, the ones locked so far are released again on failure
+static bool lock_bitmaps(JNIEnv *env, jobjectArray bitmaps, std::vector<jobject> &objects, std::vector<ImageBuffer> &images) {
+    const int n = env->GetArrayLength(bitmaps);
+    objects.resize(n);
+    images.resize(n);
+    for (int i = 0; i < n; i++) {
+        objects[i] = env->GetObjectArrayElement(bitmaps, i);
+        if (objects[i] == nullptr || !lock_bitmap(env, objects[i], images[i])) {
+            for (int j = 0; j < i; j++)
+                unlock_bitmap(env, objects[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void unlock_bitmaps(JNIEnv *env, const std::vector<jobject> &objects) {
+    for (jobject bitmap : objects) {
+        unlock_bitmap(env, bitmap);
+        env->DeleteLocalRef(bitmap);
+    }
+}
+
+static jobjectArray to_box_arrays(JNIEnv *env, const std::vector<std::vector<BoxInfo>> &results) {
+    jobjectArray ret = env->NewObjectArray(results.size(), java.box_array_cls, nullptr);
+    for (size_t i = 0; i < results.size(); i++) {
+        jobjectArray boxes = to_box_array(env, results[i]);
+        env->SetObjectArrayElement(ret, i, boxes);
+        env->DeleteLocalRef(boxes);
+    }
+    return ret;
+}
 
 
 JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
     ncnn::create_gpu_instance();
-    if (ncnn::get_gpu_count() > 0) {
-        NanoDetPlus::hasGPU = true;
-        YOLOv5s::hasGPU = true;
+
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv((void **) &env, JNI_VERSION_1_6) != JNI_OK)
+        return JNI_ERR;
+    java.box_cls = find_global_class(env, "com/objdetection/Box");
+    java.box_array_cls = find_global_class(env, "[Lcom/objdetection/Box;");
+    java.result_cls = find_global_class(env, "com/objdetection/DetectResult");
+    if (java.box_cls == nullptr || java.box_array_cls == nullptr || java.result_cls == nullptr)
+        return JNI_ERR;
+    java.box_init = env->GetMethodID(java.box_cls, "<init>", "(FFFFIF)V");
+    java.result_init = env->GetMethodID(java.result_cls, "<init>", "(JII[Lcom/objdetection/Box;)V");
+    // a constructor renamed or stripped on the Java side, NoSuchMethodError is pending
+    if (java.box_init == nullptr || java.result_init == nullptr) {
+        env->ExceptionClear();
+        return JNI_ERR;
     }
 //    LOGD("jni onload");
     return JNI_VERSION_1_6;
 }
 
 JNIEXPORT void JNI_OnUnload(JavaVM *vm, void *reserved) {
+    stop_pipeline();
+    stop_temporal();
+    stop_roi();
+    stop_stream();
+    // the nets hold vulkan resources, release them before the instance
+    registry.clear();
     ncnn::destroy_gpu_instance();
-    delete NanoDetPlus::detector;
-    delete YOLOv5s::detector;
+
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv((void **) &env, JNI_VERSION_1_6) == JNI_OK) {
+        env->DeleteGlobalRef(java.box_cls);
+        env->DeleteGlobalRef(java.box_array_cls);
+        env->DeleteGlobalRef(java.result_cls);
+    }
 //    LOGD("jni onunload");
 }
 
 /*********************************************************************************************
                                          NanoDet-Plus
  ********************************************************************************************/
-extern "C" JNIEXPORT void JNICALL
+extern "C" JNIEXPORT jint JNICALL
 Java_com_objdetection_NanoDetPlus_init(JNIEnv *env, jobject thiz, jobject assetManager, jboolean useGPU, jint threads_number) {
-    if (NanoDetPlus::detector != nullptr) {
-        delete NanoDetPlus::detector;
-        NanoDetPlus::detector = nullptr;
-    }
-    if (NanoDetPlus::detector == nullptr) {
-        AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
-        NanoDetPlus::detector = new NanoDetPlus(mgr, "NanoDetPlus.param", "NanoDetPlus.bin", useGPU, threads_number);
-    }
+    stop_pipeline();
+    stop_temporal();
+    stop_roi();
+    stop_stream();
+    AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
+    // loaded before the swap, detections in flight finish on the previous instance
+    // NanoDetPlus.cfg next to the weights overrides the built-in description
+    ModelConfig config = NanoDetPlus::default_config();
+    load_model_config(mgr, "NanoDetPlus.cfg", config);
+    int error;
+    auto detector = load_detector(mgr, "NanoDetPlus", config, useGPU, threads_number, error);
+    if (detector)
+        registry.put("NanoDetPlus", detector);
+    return error;
 }
 
 extern "C" JNIEXPORT jobjectArray JNICALL
 Java_com_objdetection_NanoDetPlus_detect(JNIEnv *env, jobject thiz, jobject image, jfloat threshold,
                                          jfloat nms_threshold) {
-    auto result = NanoDetPlus::detector->detect(env, image, threshold, nms_threshold);
+    std::shared_ptr<Detector> detector = registry.get("NanoDetPlus");
+    if (!detector)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+    auto result = detector->detect(buffer, threshold, nms_threshold);
+    unlock_bitmap(env, image);
 
-    auto box_cls = env->FindClass("com/objdetection/Box");
-    auto cid = env->GetMethodID(box_cls, "<init>", "(FFFFIF)V");
-    jobjectArray ret = env->NewObjectArray(result.size(), box_cls, nullptr);
-    int i = 0;
-    for (auto &box:result) {
-        env->PushLocalFrame(1);
-        jobject obj = env->NewObject(box_cls, cid, box.x1, box.y1, box.w, box.h, box.label, box.score);
-        obj = env->PopLocalFrame(obj);
-        env->SetObjectArrayElement(ret, i++, obj);
-    }
-    return ret;
+    return to_box_array(env, result);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_NanoDetPlus_detectYUV(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                            jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation, jfloat threshold,
+                                            jfloat nms_threshold) {
+    std::shared_ptr<Detector> detector = registry.get("NanoDetPlus");
+    if (!detector)
+        return nullptr;
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return nullptr;
+    auto result = detector->detect(frame, threshold, nms_threshold);
+
+    return to_box_array(env, result);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_NanoDetPlus_detectInto(JNIEnv *env, jobject thiz, jobject image, jfloat threshold, jfloat nms_threshold,
+                                             jobject boxes, jobject labels) {
+    std::shared_ptr<Detector> detector = registry.get("NanoDetPlus");
+    if (!detector)
+        return -1;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return -1;
+    // kept by the calling thread, so a steady camera stream doesn't allocate here
+    static thread_local std::vector<BoxInfo> result;
+    detector->detect(buffer, threshold, nms_threshold, result);
+    unlock_bitmap(env, image);
+
+    return write_boxes(env, result, boxes, labels);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_NanoDetPlus_detectYUVInto(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                                jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation, jfloat threshold,
+                                                jfloat nms_threshold, jobject boxes, jobject labels) {
+    std::shared_ptr<Detector> detector = registry.get("NanoDetPlus");
+    if (!detector)
+        return -1;
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return -1;
+    // kept by the calling thread, so a steady camera stream doesn't allocate here
+    static thread_local std::vector<BoxInfo> result;
+    detector->detect(frame, threshold, nms_threshold, result);
+
+    return write_boxes(env, result, boxes, labels);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_NanoDetPlus_detectBatch(JNIEnv *env, jobject thiz, jobjectArray images, jfloat threshold,
+                                              jfloat nms_threshold) {
+    std::shared_ptr<Detector> detector = registry.get("NanoDetPlus");
+    if (!detector)
+        return nullptr;
+    std::vector<jobject> bitmaps;
+    std::vector<ImageBuffer> buffers;
+    if (!lock_bitmaps(env, images, bitmaps, buffers))
+        return nullptr;
+    std::vector<std::vector<BoxInfo>> results;
+    detector->detect_batch(buffers, threshold, nms_threshold, results);
+    unlock_bitmaps(env, bitmaps);
+
+    return to_box_arrays(env, results);
 }
 
 
 /*********************************************************************************************
                                          YOLOv5s
  ********************************************************************************************/
-extern "C" JNIEXPORT void JNICALL
+extern "C" JNIEXPORT jint JNICALL
 Java_com_objdetection_YOLOv5s_init(JNIEnv *env, jobject thiz, jobject assetManager, jboolean useGPU, jint threads_number) {
-    if (YOLOv5s::detector != nullptr) {
-        delete YOLOv5s::detector;
-        YOLOv5s::detector = nullptr;
-    }
-    if (YOLOv5s::detector == nullptr) {
-        AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
-        YOLOv5s::detector = new YOLOv5s(mgr, "YOLOv5s.param", "YOLOv5s.bin", useGPU, threads_number);
-    }
+    stop_pipeline();
+    stop_temporal();
+    stop_roi();
+    stop_stream();
+    AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
+    // loaded before the swap, detections in flight finish on the previous instance
+    // YOLOv5s.cfg next to the weights overrides the built-in description
+    ModelConfig config = YOLOv5s::default_config();
+    load_model_config(mgr, "YOLOv5s.cfg", config);
+    int error;
+    auto detector = load_detector(mgr, "YOLOv5s", config, useGPU, threads_number, error);
+    if (detector)
+        registry.put("YOLOv5s", detector);
+    return error;
 }
 
 extern "C" JNIEXPORT jobjectArray JNICALL
 Java_com_objdetection_YOLOv5s_detect(JNIEnv *env, jobject thiz, jobject image, jfloat threshold,
                                      jfloat nms_threshold) {
-    auto result = YOLOv5s::detector->detect(env, image, threshold, nms_threshold);
+    std::shared_ptr<Detector> detector = registry.get("YOLOv5s");
+    if (!detector)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+    auto result = detector->detect(buffer, threshold, nms_threshold);
+    unlock_bitmap(env, image);
 
-    auto box_cls = env->FindClass("com/objdetection/Box");
-    auto cid = env->GetMethodID(box_cls, "<init>", "(FFFFIF)V");
-    jobjectArray ret = env->NewObjectArray(result.size(), box_cls, nullptr);
-    int i = 0;
-    for (auto &box:result) {
-        env->PushLocalFrame(1);
-        jobject obj = env->NewObject(box_cls, cid, box.x1, box.y1, box.w, box.h, box.label, box.score);
-        obj = env->PopLocalFrame(obj);
-        env->SetObjectArrayElement(ret, i++, obj);
+    return to_box_array(env, result);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_YOLOv5s_detectYUV(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                        jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation, jfloat threshold,
+                                        jfloat nms_threshold) {
+    std::shared_ptr<Detector> detector = registry.get("YOLOv5s");
+    if (!detector)
+        return nullptr;
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return nullptr;
+    auto result = detector->detect(frame, threshold, nms_threshold);
+
+    return to_box_array(env, result);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_YOLOv5s_detectInto(JNIEnv *env, jobject thiz, jobject image, jfloat threshold, jfloat nms_threshold,
+                                         jobject boxes, jobject labels) {
+    std::shared_ptr<Detector> detector = registry.get("YOLOv5s");
+    if (!detector)
+        return -1;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return -1;
+    // kept by the calling thread, so a steady camera stream doesn't allocate here
+    static thread_local std::vector<BoxInfo> result;
+    detector->detect(buffer, threshold, nms_threshold, result);
+    unlock_bitmap(env, image);
+
+    return write_boxes(env, result, boxes, labels);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_YOLOv5s_detectYUVInto(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                            jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation, jfloat threshold,
+                                            jfloat nms_threshold, jobject boxes, jobject labels) {
+    std::shared_ptr<Detector> detector = registry.get("YOLOv5s");
+    if (!detector)
+        return -1;
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return -1;
+    // kept by the calling thread, so a steady camera stream doesn't allocate here
+    static thread_local std::vector<BoxInfo> result;
+    detector->detect(frame, threshold, nms_threshold, result);
+
+    return write_boxes(env, result, boxes, labels);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_YOLOv5s_detectBatch(JNIEnv *env, jobject thiz, jobjectArray images, jfloat threshold,
+                                          jfloat nms_threshold) {
+    std::shared_ptr<Detector> detector = registry.get("YOLOv5s");
+    if (!detector)
+        return nullptr;
+    std::vector<jobject> bitmaps;
+    std::vector<ImageBuffer> buffers;
+    if (!lock_bitmaps(env, images, bitmaps, buffers))
+        return nullptr;
+    std::vector<std::vector<BoxInfo>> results;
+    detector->detect_batch(buffers, threshold, nms_threshold, results);
+    unlock_bitmaps(env, bitmaps);
+
+    return to_box_arrays(env, results);
+}
+
+
+/*********************************************************************************************
+                                         Configured models
+ ********************************************************************************************/
+// Any model described by <name>.cfg, loaded from <name>.param (or .param.bin) / <name>.bin and registered under name,
+// returns a LoadError
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_GenericDetector_load(JNIEnv *env, jobject thiz, jobject assetManager, jstring name, jboolean useGPU,
+                                           jint threads_number) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::string model_name(chars);
+    env->ReleaseStringUTFChars(name, chars);
+
+    AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
+    ModelConfig config;
+    std::string error;
+    if (!load_model_config(mgr, (model_name + ".cfg").c_str(), config, &error)) {
+        __android_log_print(ANDROID_LOG_ERROR, "objdetection", "%s.cfg: %s", model_name.c_str(), error.c_str());
+        return LOAD_CONFIG_INVALID;
     }
-    return ret;
+    int load_error;
+    auto detector = load_detector(mgr, model_name, config, useGPU, threads_number, load_error);
+    if (detector)
+        registry.put(model_name, detector);
+    return load_error;
+}
+
+// Directory for inflated copies of compressed weight assets, e.g. codeCacheDir; empty disables the copies
+extern "C" JNIEXPORT void JNICALL
+Java_com_objdetection_GenericDetector_setCacheDir(JNIEnv *env, jobject thiz, jstring path) {
+    const char *chars = env->GetStringUTFChars(path, nullptr);
+    std::lock_guard<std::mutex> lock(cache_dir_mutex);
+    cache_dir = chars;
+    env->ReleaseStringUTFChars(path, chars);
+}
+
+// Runs a blank width x height frame through the model on a thread of its own and returns at once,
+// so the first camera frame does not pay for the lazy setup of the net
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_warmUp(JNIEnv *env, jobject thiz, jstring name, jint width, jint height) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector || width <= 0 || height <= 0)
+        return JNI_FALSE;
+
+    // the thread keeps the detector alive, a hot-swap meanwhile only warms the replaced instance
+    std::thread([detector, width, height]() { detector->prewarm(width, height); }).detach();
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_GenericDetector_detect(JNIEnv *env, jobject thiz, jstring name, jobject image, jfloat threshold,
+                                             jfloat nms_threshold) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+    auto result = detector->detect(buffer, threshold, nms_threshold);
+    unlock_bitmap(env, image);
+
+    return to_box_array(env, result);
+}
+
+
+// High-resolution photo cut into model-sized tiles, tile_size <= 0 uses the model's input size
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_GenericDetector_detectTiled(JNIEnv *env, jobject thiz, jstring name, jobject image, jfloat threshold,
+                                                  jfloat nms_threshold, jint tile_size, jfloat overlap,
+                                                  jboolean global_pass) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+
+    TileOptions options;
+    options.tile_size = tile_size;
+    options.overlap = overlap;
+    options.global_pass = global_pass;
+    std::vector<BoxInfo> result;
+    detector->detect_tiled(buffer, threshold, nms_threshold, options, result);
+    unlock_bitmap(env, image);
+
+    return to_box_array(env, result);
+}
+
+
+// Adaptive input size for a registered model ("NanoDetPlus", "YOLOv5s" or a configured one),
+// target_ms <= 0 goes back to the fixed size
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setAdaptive(JNIEnv *env, jobject thiz, jstring name, jfloat target_ms) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    AdaptiveOptions options;
+    options.target_ms = target_ms;
+    detector->set_adaptive(options);
+    return JNI_TRUE;
+}
+
+// Inference on the plan's CPU clusters ("clusters=1 threads=1 aux=1" or a preset: "prime", "performance", "all").
+// Call it before detecting on the model; pipelines pin their workers when they start.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setScheduling(JNIEnv *env, jobject thiz, jstring name, jstring plan) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    const char *plan_chars = env->GetStringUTFChars(plan, nullptr);
+    SchedulingPlan parsed;
+    const bool ok = parse_plan(plan_chars, parsed);
+    env->ReleaseStringUTFChars(plan, plan_chars);
+    if (!ok)
+        return JNI_FALSE;
+
+    detector->set_scheduling(parsed);
+    return JNI_TRUE;
+}
+
+// Times the candidate plans on a width x height frame and keeps the fastest, returned for setScheduling next time;
+// takes a few seconds, nothing else may detect on the model meanwhile
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_objdetection_GenericDetector_autotune(JNIEnv *env, jobject thiz, jstring name, jint width, jint height) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector || width <= 0 || height <= 0)
+        return nullptr;
+
+    std::vector<SchedulingPlan> candidates;
+    candidate_plans(candidates);
+    std::vector<double> median_ms;
+    SchedulingPlan best = detector->autotune_scheduling(width, height, 8, &median_ms);
+    for (size_t i = 0; i < candidates.size(); i++)
+        __android_log_print(ANDROID_LOG_INFO, "objdetection", "scheduling %s: %.2f ms",
+                            format_plan(candidates[i]).c_str(), median_ms[i]);
+    return env->NewStringUTF(format_plan(best).c_str());
+}
+
+// Cluster layout of this device, saved tuning results are keyed by it
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_objdetection_GenericDetector_cpuLayout(JNIEnv *env, jobject thiz) {
+    return env->NewStringUTF(cpu_layout().c_str());
+}
+
+// Heads with a stride below min_stride are skipped, 16 or 32 when only large objects matter; 0 runs them all
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setMinStride(JNIEnv *env, jobject thiz, jstring name, jint min_stride) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    detector->set_min_stride(min_stride);
+    return JNI_TRUE;
+}
+
+// Decoding each head while the net computes the next one, on by default
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setDecodeOverlap(JNIEnv *env, jobject thiz, jstring name, jboolean enabled) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    detector->set_decode_overlap(enabled == JNI_TRUE);
+    return JNI_TRUE;
+}
+
+// Stage latency histograms, proposal counts and pool hits of a registered model, switchable while detecting;
+// trace_events > 0 also keeps the last stage events for writeTrace
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setStatsEnabled(JNIEnv *env, jobject thiz, jstring name, jboolean enabled,
+                                                      jint trace_events) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    detector->set_stats_enabled(enabled == JNI_TRUE, trace_events);
+    return JNI_TRUE;
+}
+
+// Snapshot of the stats as JSON (format_stats in DetectStats.h), null if the model is not loaded
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_objdetection_GenericDetector_getStats(JNIEnv *env, jobject thiz, jstring name) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return nullptr;
+
+    return env->NewStringUTF(format_stats(detector->get_stats()).c_str());
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_resetStats(JNIEnv *env, jobject thiz, jstring name) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    detector->reset_stats();
+    return JNI_TRUE;
+}
+
+// Chrome trace JSON of the buffered stage events, for chrome://tracing or ui.perfetto.dev
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_writeTrace(JNIEnv *env, jobject thiz, jstring name, jstring path) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    const char *path_chars = env->GetStringUTFChars(path, nullptr);
+    const bool ok = detector->write_trace(path_chars);
+    env->ReleaseStringUTFChars(path, path_chars);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+// Per-layer timing of the net, CPU only; the first enable wraps the layers, before detecting starts
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_GenericDetector_setLayerProfiling(JNIEnv *env, jobject thiz, jstring name, jboolean enabled) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return JNI_FALSE;
+
+    return detector->set_layer_profiling(enabled == JNI_TRUE) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Layer table of format_layer_report (LayerProfiler.h), null if the model is not loaded
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_objdetection_GenericDetector_layerReport(JNIEnv *env, jobject thiz, jstring name, jint max_rows) {
+    const char *chars = env->GetStringUTFChars(name, nullptr);
+    std::shared_ptr<Detector> detector = registry.get(chars);
+    env->ReleaseStringUTFChars(name, chars);
+    if (!detector)
+        return nullptr;
+
+    return env->NewStringUTF(format_layer_report(detector->layer_profile(), max_rows).c_str());
+}
+
+
+/*********************************************************************************************
+                                         Camera frames
+ ********************************************************************************************/
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_CameraFrame_toBitmap(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                           jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation,
+                                           jobject bitmap) {
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return JNI_FALSE;
+
+    ImageBuffer image;
+    if (!lock_bitmap(env, bitmap, image))
+        return JNI_FALSE;
+
+    int rotated_w, rotated_h;
+    yuv_rotated_size(frame, rotated_w, rotated_h);
+    bool fits = image.width == rotated_w && image.height == rotated_h;
+    if (fits)
+        yuv_to_rgba(frame, (unsigned char *) image.data, image.stride);
+    unlock_bitmap(env, bitmap);
+
+    return fits ? JNI_TRUE : JNI_FALSE;
+}
+
+
+/*********************************************************************************************
+                                         Pipeline
+ ********************************************************************************************/
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_DetectPipeline_start(JNIEnv *env, jobject thiz, jint model, jint depth, jint drop_policy,
+                                           jint max_key_interval) {
+    stop_pipeline();
+
+    std::shared_ptr<Detector> detector = model_detector(model);
+    if (!detector)
+        return JNI_FALSE;
+
+    PipelineOptions options;
+    options.depth = depth;
+    options.drop_policy = (DropPolicy) std::min(std::max((int) drop_policy, (int) DROP_NEWEST), (int) BLOCK);
+    options.temporal_reuse = max_key_interval > 1;
+    options.temporal.max_interval = max_key_interval;
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    pipeline = std::make_shared<DetectPipeline>(detector, options);
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_objdetection_DetectPipeline_stop(JNIEnv *env, jobject thiz) {
+    stop_pipeline();
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_objdetection_DetectPipeline_submitYUV(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width, jint height,
+                                               jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride, jint rotation,
+                                               jfloat threshold, jfloat nms_threshold) {
+    std::shared_ptr<DetectPipeline> current = current_pipeline();
+    if (!current)
+        return -1;
+
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return -1;
+
+    return current->submit(frame, threshold, nms_threshold);
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_objdetection_DetectPipeline_poll(JNIEnv *env, jobject thiz) {
+    std::shared_ptr<DetectPipeline> current = current_pipeline();
+    DetectResult result;
+    if (!current || !current->poll(result))
+        return nullptr;
+
+    jobjectArray boxes = to_box_array(env, result.boxes);
+    return env->NewObject(java.result_cls, java.result_init, (jlong) result.frame_id, result.width, result.height, boxes);
+}
+
+// Allocation-free poll for long camera sessions: info receives the box count, width and height
+// Returns the frame id, -1 when no frame is ready
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_objdetection_DetectPipeline_pollInto(JNIEnv *env, jobject thiz, jobject boxes, jobject labels, jintArray info) {
+    std::shared_ptr<DetectPipeline> current = current_pipeline();
+    DetectResult result;
+    if (!current || env->GetArrayLength(info) < 3 || !current->poll(result))
+        return -1;
+
+    jint values[3] = {write_boxes(env, result.boxes, boxes, labels), result.width, result.height};
+    env->SetIntArrayRegion(info, 0, 3, values);
+    return values[0] < 0 ? -1 : (jlong) result.frame_id;
+}
+
+
+/*********************************************************************************************
+                                         Video
+ ********************************************************************************************/
+// max_key_interval <= 1 runs the detector on every frame, the boxes are still tracked
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_TemporalDetector_start(JNIEnv *env, jobject thiz, jint model, jint max_key_interval) {
+    std::shared_ptr<Detector> detector = model_detector(model);
+    if (!detector)
+        return JNI_FALSE;
+
+    TemporalOptions options;
+    options.max_interval = max_key_interval;
+    std::lock_guard<std::mutex> lock(temporal_mutex);
+    temporal.reset(new TemporalDetector(detector, options));
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_objdetection_TemporalDetector_stop(JNIEnv *env, jobject thiz) {
+    stop_temporal();
+}
+
+// track_ids receives the track of every box, as far as it is long enough
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_TemporalDetector_detect(JNIEnv *env, jobject thiz, jobject image, jfloat threshold,
+                                              jfloat nms_threshold, jintArray track_ids) {
+    std::lock_guard<std::mutex> lock(temporal_mutex);
+    if (!temporal)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+    std::vector<BoxInfo> result;
+    std::vector<int> ids;
+    temporal->detect(buffer, threshold, nms_threshold, result, ids);
+    unlock_bitmap(env, image);
+
+    if (track_ids != nullptr) {
+        const jsize count = std::min((jsize) ids.size(), env->GetArrayLength(track_ids));
+        env->SetIntArrayRegion(track_ids, 0, count, ids.data());
+    }
+    return to_box_array(env, result);
+}
+
+
+/*********************************************************************************************
+                                         Still camera
+ ********************************************************************************************/
+// refresh_interval: frames between two full-frame detections, <= 0 only on large changes
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_MotionRoiDetector_start(JNIEnv *env, jobject thiz, jint model, jint refresh_interval) {
+    std::shared_ptr<Detector> detector = model_detector(model);
+    if (!detector)
+        return JNI_FALSE;
+
+    RoiOptions options;
+    options.refresh_interval = refresh_interval;
+    std::lock_guard<std::mutex> lock(roi_mutex);
+    roi.reset(new RoiDetector(detector, options));
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_objdetection_MotionRoiDetector_stop(JNIEnv *env, jobject thiz) {
+    stop_roi();
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_objdetection_MotionRoiDetector_detect(JNIEnv *env, jobject thiz, jobject image, jfloat threshold,
+                                               jfloat nms_threshold) {
+    std::lock_guard<std::mutex> lock(roi_mutex);
+    if (!roi)
+        return nullptr;
+    ImageBuffer buffer;
+    if (!lock_bitmap(env, image, buffer))
+        return nullptr;
+    std::vector<BoxInfo> result;
+    roi->detect(buffer, threshold, nms_threshold, result);
+    unlock_bitmap(env, image);
+
+    return to_box_array(env, result);
+}
+
+
+/*********************************************************************************************
+                                         Fixed-size stream
+ ********************************************************************************************/
+// Frames of width x height once rotated; warm_up runs a blank frame so the first camera frame finds the pools sized
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_objdetection_StreamSession_start(JNIEnv *env, jobject thiz, jint model, jint width, jint height,
+                                          jboolean warm_up) {
+    stop_stream();
+
+    std::shared_ptr<Detector> detector = model_detector(model);
+    if (!detector || width <= 0 || height <= 0)
+        return JNI_FALSE;
+
+    std::unique_ptr<StreamSession> session(new StreamSession(detector, width, height));
+    if (warm_up == JNI_TRUE)
+        session->warm_up();
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    stream = std::move(session);
+    return JNI_TRUE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_objdetection_StreamSession_stop(JNIEnv *env, jobject thiz) {
+    stop_stream();
+}
+
+// Box count, -1 without a session or for a frame of another size
+extern "C" JNIEXPORT jint JNICALL
+Java_com_objdetection_StreamSession_detectYUVInto(JNIEnv *env, jobject thiz, jobject y, jobject u, jobject v, jint width,
+                                                  jint height, jint y_row_stride, jint uv_row_stride, jint uv_pixel_stride,
+                                                  jint rotation, jfloat threshold, jfloat nms_threshold, jobject boxes,
+                                                  jobject labels) {
+    YuvImageBuffer frame;
+    if (!wrap_yuv_planes(env, y, u, v, width, height, y_row_stride, uv_row_stride, uv_pixel_stride, rotation, frame))
+        return -1;
+    static thread_local std::vector<BoxInfo> result;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        if (!stream || !stream->detect(frame, threshold, nms_threshold, result))
+            return -1;
+    }
+    return write_boxes(env, result, boxes, labels);
+}
+
+// JSON of the session's memory (format_footprint in StreamSession.h), null without a session
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_objdetection_StreamSession_footprint(JNIEnv *env, jobject thiz) {
+    StreamFootprint footprint;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        if (!stream)
+            return nullptr;
+        footprint = stream->footprint();
+    }
+    return env->NewStringUTF(format_footprint(footprint).c_str());
 }
@@ -0,0 +1,174 @@
+//
+// Image folders and labels for the host tools
+// Images are decoded with OpenCV when the tools were built with it, otherwise binary PPM / PGM are read
+// (convert a folder with e.g. `mogrify -format ppm *.jpg`). Labels use the YOLO text format: one
+// "class cx cy w h" line per object next to each image, coordinates normalized to the image size.
+//
+
+#ifndef ToolUtils_H
+#define ToolUtils_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Common.h"
+#if OBJDET_HAVE_OPENCV
+#include <opencv2/imgcodecs.hpp>
+#endif
+
+static inline double get_current_time()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+}
+
+// Decoded image, tightly packed RGB
+typedef struct LoadedImage {
+    std::string path;
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+
+    ImageBuffer buffer() const
+    {
+        ImageBuffer image;
+        image.data = pixels.data();
+        image.width = width;
+        image.height = height;
+        image.stride = 0;
+        image.format = PIXEL_FORMAT_RGB;
+        return image;
+    }
+} LoadedImage;
+
+static inline bool is_image_file(const std::filesystem::path &path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+#if OBJDET_HAVE_OPENCV
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp" || ext == ".ppm" || ext == ".pgm";
+#else
+    return ext == ".ppm" || ext == ".pgm";
+#endif
+}
+
+// Sorted, so two runs see the images in the same order
+static inline std::vector<std::string> list_images(const char *dir, int max_images)
+{
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+    {
+        if (entry.is_regular_file() && is_image_file(entry.path()))
+            paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    if (max_images > 0 && (int) paths.size() > max_images)
+        paths.resize(max_images);
+    return paths;
+}
+
+#if !OBJDET_HAVE_OPENCV
+// Header token of a netpbm file, skipping whitespace and comments
+static inline bool read_pnm_token(FILE *fp, int &value)
+{
+    int c = fgetc(fp);
+    while (c != EOF && (isspace(c) || c == '#'))
+    {
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+                c = fgetc(fp);
+        }
+        c = fgetc(fp);
+    }
+    if (c == EOF || !isdigit(c))
+        return false;
+
+    value = 0;
+    while (c != EOF && isdigit(c))
+    {
+        value = value * 10 + (c - '0');
+        c = fgetc(fp);
+    }
+    return true;
+}
+#endif
+
+static inline bool load_image(const std::string &path, LoadedImage &image)
+{
+    image.path = path;
+#if OBJDET_HAVE_OPENCV
+    cv::Mat bgr = cv::imread(path, cv::IMREAD_COLOR);
+    if (bgr.empty())
+        return false;
+
+    image.width = bgr.cols;
+    image.height = bgr.rows;
+    image.pixels.resize((size_t) image.width * image.height * 3);
+    for (int y = 0; y < image.height; y++)
+    {
+        const unsigned char *src = bgr.ptr<unsigned char>(y);
+        unsigned char *dst = image.pixels.data() + (size_t) y * image.width * 3;
+        for (int x = 0; x < image.width; x++)
+        {
+            dst[x * 3] = src[x * 3 + 2];
+            dst[x * 3 + 1] = src[x * 3 + 1];
+            dst[x * 3 + 2] = src[x * 3];
+        }
+    }
+    return true;
+#else
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    char magic[2] = {0, 0};
+    int maxval = 0;
+    bool ok = fread(magic, 1, 2, fp) == 2 && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')
+              && read_pnm_token(fp, image.width) && read_pnm_token(fp, image.height) && read_pnm_token(fp, maxval)
+              && maxval == 255 && image.width > 0 && image.height > 0;
+    if (ok)
+    {
+        const int channels = magic[1] == '6' ? 3 : 1;
+        std::vector<unsigned char> raw((size_t) image.width * image.height * channels);
+        ok = fread(raw.data(), 1, raw.size(), fp) == raw.size();
+
+        image.pixels.resize((size_t) image.width * image.height * 3);
+        for (size_t i = 0; ok && i < (size_t) image.width * image.height; i++)
+        {
+            for (int c = 0; c < 3; c++)
+                image.pixels[i * 3 + c] = raw[i * channels + (channels == 3 ? c : 0)];
+        }
+    }
+    fclose(fp);
+    return ok;
+#endif
+}
+
+// YOLO labels of an image in pixels, score 1; missing file means no objects
+static inline std::vector<BoxInfo> load_labels(const std::string &image_path, int width, int height)
+{
+    std::vector<BoxInfo> labels;
+    std::ifstream file(std::filesystem::path(image_path).replace_extension(".txt"));
+    int label;
+    float cx, cy, w, h;
+    while (file >> label >> cx >> cy >> w >> h)
+    {
+        BoxInfo box;
+        box.x1 = (cx - w / 2) * width;
+        box.y1 = (cy - h / 2) * height;
+        box.w = w * width;
+        box.h = h * height;
+        box.score = 1.f;
+        box.label = label;
+        labels.push_back(box);
+    }
+    return labels;
+}
+
+#endif //ToolUtils_H
@@ -0,0 +1,514 @@
+//
+// Per-stage latency of the detection pipeline, as JSON for diffing runs and catching regressions
+// Usage: objdet_bench <model dir> [model name]... [-i image or dir]... [-n runs] [-w warmup] [-t threads,...]
+//                     [-o report.json] [-b baseline.json] [-r tolerance]
+//
+// Every model name loads <model dir>/<name>.cfg, .param and .bin like objdet_compare, YOLOv5s and NanoDetPlus
+// when none is given (the sidecars are in app/src/main/assets). Each model runs on two fixed synthetic frames,
+// 640 x 480 and 1280 x 720, plus the images given with -i, once per thread count of -t. A run times
+// preprocess, every extract, decode, top-k sort, NMS and the copy into the app's direct box buffers
+// (BoxBuffer.kt), and the report gives mean / min / p50 / p90 / p99 / max of each. With -b, a stage whose p50
+// is more than tolerance (default 0.10) and 0.05 ms slower than in the baseline fails the run.
+//
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include "CpuTopology.h"
+#include "GenericDetector.h"
+#include "ToolUtils.h"
+
+static const float score_threshold = 0.3f;
+static const float nms_threshold = 0.5f;
+// a slower p50 below this is noise, whatever the tolerance says
+static const double regression_floor_ms = 0.05;
+
+typedef struct BenchImage {
+    std::string name;
+    LoadedImage image;
+} BenchImage;
+
+typedef struct StageStats {
+    std::string name;
+    double mean = 0;
+    double min = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+} StageStats;
+
+typedef struct BenchResult {
+    std::string model;
+    std::string image;
+    int threads = 0;
+    int boxes = 0;
+    std::vector<StageStats> stages;
+} BenchResult;
+
+// Gray background with a few flat rectangles, the same pixels on every run
+static BenchImage synthetic_image(int width, int height, unsigned int seed)
+{
+    BenchImage bench;
+    bench.name = "synthetic-" + std::to_string(width) + "x" + std::to_string(height);
+    LoadedImage &image = bench.image;
+    image.path = bench.name;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t) width * height * 3);
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(100, 140);
+    for (auto &v : image.pixels)
+        v = (unsigned char) noise(rng);
+
+    std::uniform_int_distribution<int> color(0, 255);
+    for (int r = 0; r < 6; r++)
+    {
+        const int w = width / 8 + r * width / 32;
+        const int h = height / 6 + r * height / 48;
+        const int x0 = std::uniform_int_distribution<int>(0, width - w)(rng);
+        const int y0 = std::uniform_int_distribution<int>(0, height - h)(rng);
+        const unsigned char rgb[3] = {(unsigned char) color(rng), (unsigned char) color(rng), (unsigned char) color(rng)};
+        for (int y = y0; y < y0 + h; y++)
+        {
+            unsigned char *row = image.pixels.data() + ((size_t) y * width + x0) * 3;
+            for (int x = 0; x < w; x++)
+                memcpy(row + x * 3, rgb, 3);
+        }
+    }
+    return bench;
+}
+
+static StageStats summarize(const std::string &name, std::vector<double> samples)
+{
+    StageStats stats;
+    stats.name = name;
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        const size_t k = (size_t) std::lround(p * (samples.size() - 1));
+        return samples[std::min(k, samples.size() - 1)];
+    };
+    for (double v : samples)
+        stats.mean += v;
+    stats.mean /= samples.size();
+    stats.min = samples.front();
+    stats.p50 = percentile(0.50);
+    stats.p90 = percentile(0.90);
+    stats.p99 = percentile(0.99);
+    stats.max = samples.back();
+    return stats;
+}
+
+static bool same_boxes(const std::vector<BoxInfo> &a, const std::vector<BoxInfo> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].label != b[i].label || memcmp(&a[i].x1, &b[i].x1, sizeof(float) * 5) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Same layout as write_boxes() in jni_interface.cpp: x1, y1, w, h, score per box and the labels apart
+static void marshal_boxes(const std::vector<BoxInfo> &boxes, std::vector<float> &box_data, std::vector<int> &label_data)
+{
+    for (size_t i = 0; i < boxes.size() && i < label_data.size(); i++)
+    {
+        box_data[i * 5] = boxes[i].x1;
+        box_data[i * 5 + 1] = boxes[i].y1;
+        box_data[i * 5 + 2] = boxes[i].w;
+        box_data[i * 5 + 3] = boxes[i].h;
+        box_data[i * 5 + 4] = boxes[i].score;
+        label_data[i] = boxes[i].label;
+    }
+}
+
+// Stage by stage like detect(), on a context of our own so the stage times can be read back
+static bool run_model(GenericDetector &detector, const BenchImage &bench, int threads, int runs, int warmup,
+                      BenchResult &result)
+{
+    const ImageBuffer image = bench.image.buffer();
+    const ModelConfig &config = detector.model_config();
+
+    DetectContext ctx;
+    ctx.num_threads = threads;
+    ctx.times.enabled = true;
+
+    std::vector<BoxInfo> boxes;
+    std::vector<float> box_data(100 * 5);
+    std::vector<int> label_data(100);
+    const int n = (int) config.outputs.size();
+    std::vector<std::vector<double>> samples(n + 6);
+    for (int r = -warmup; r < runs; r++)
+    {
+        const double start = get_current_time();
+        detector.preprocess(image, ctx);
+        const double preprocessed = get_current_time();
+        detector.infer_postprocess(ctx, score_threshold, nms_threshold, boxes);
+        const double selected = get_current_time();
+        marshal_boxes(boxes, box_data, label_data);
+        const double end = get_current_time();
+        if (r < 0)
+            continue;
+
+        samples[0].push_back(preprocessed - start);
+        for (int i = 0; i < n; i++)
+            samples[1 + i].push_back(ctx.times.extract[i]);
+        samples[n + 1].push_back(ctx.times.ms[STAGE_DECODE]);
+        samples[n + 2].push_back(ctx.times.ms[STAGE_SORT]);
+        samples[n + 3].push_back(ctx.times.ms[STAGE_NMS]);
+        samples[n + 4].push_back(end - selected);
+        samples[n + 5].push_back(end - start);
+    }
+
+    // the stages have to give what detect() gives
+    if (!same_boxes(boxes, detector.detect(image, score_threshold, nms_threshold)))
+    {
+        fprintf(stderr, "%s on %s: staged boxes differ from detect()\n", result.model.c_str(), bench.name.c_str());
+        return false;
+    }
+
+    result.image = bench.name;
+    result.threads = threads;
+    result.boxes = (int) boxes.size();
+    result.stages.clear();
+    result.stages.push_back(summarize("preprocess", samples[0]));
+    for (int i = 0; i < n; i++)
+        result.stages.push_back(summarize("extract " + config.outputs[i].blob, samples[1 + i]));
+    result.stages.push_back(summarize("decode", samples[n + 1]));
+    result.stages.push_back(summarize("sort", samples[n + 2]));
+    result.stages.push_back(summarize("nms", samples[n + 3]));
+    result.stages.push_back(summarize("marshal", samples[n + 4]));
+    result.stages.push_back(summarize("total", samples[n + 5]));
+    return true;
+}
+
+static std::string json_string(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void write_report(FILE *fp, const std::vector<BenchResult> &results, int runs, int warmup)
+{
+    fprintf(fp, "{\n  \"cpu_layout\": %s,\n  \"runs\": %d,\n  \"warmup\": %d,\n  \"results\": [", json_string(cpu_layout()).c_str(),
+            runs, warmup);
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const BenchResult &result = results[r];
+        fprintf(fp, "%s\n    {\"model\": %s, \"image\": %s, \"threads\": %d, \"boxes\": %d, \"stages\": {", r ? "," : "",
+                json_string(result.model).c_str(), json_string(result.image).c_str(), result.threads, result.boxes);
+        for (size_t s = 0; s < result.stages.size(); s++)
+        {
+            const StageStats &stats = result.stages[s];
+            fprintf(fp, "%s\n      %s: {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                    s ? "," : "", json_string(stats.name).c_str(), stats.mean, stats.min, stats.p50, stats.p90, stats.p99,
+                    stats.max);
+        }
+        fprintf(fp, "\n    }}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+// Just enough JSON to read a report back: objects, arrays, strings, numbers and literals
+typedef struct JsonValue {
+    enum { NUL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> members;
+
+    const JsonValue *get(const std::string &key) const
+    {
+        auto it = members.find(key);
+        return it == members.end() ? nullptr : &it->second;
+    }
+} JsonValue;
+
+static bool parse_json(const char *&p, JsonValue &value);
+
+static void skip_space(const char *&p)
+{
+    while (*p && isspace((unsigned char) *p))
+        p++;
+}
+
+static bool parse_json_string(const char *&p, std::string &text)
+{
+    if (*p != '"')
+        return false;
+    for (p++; *p && *p != '"'; p++)
+    {
+        if (*p == '\\' && p[1])
+            p++;
+        text += *p;
+    }
+    if (*p != '"')
+        return false;
+    p++;
+    return true;
+}
+
+static bool parse_json(const char *&p, JsonValue &value)
+{
+    skip_space(p);
+    if (*p == '{')
+    {
+        value.type = JsonValue::OBJECT;
+        for (p++, skip_space(p); *p && *p != '}';)
+        {
+            std::string key;
+            if (!parse_json_string(p, key))
+                return false;
+            skip_space(p);
+            if (*p++ != ':' || !parse_json(p, value.members[key]))
+                return false;
+            skip_space(p);
+            if (*p == ',')
+                p++;
+            skip_space(p);
+        }
+    }
+    else if (*p == '[')
+    {
+        value.type = JsonValue::ARRAY;
+        for (p++, skip_space(p); *p && *p != ']';)
+        {
+            value.items.push_back(JsonValue());
+            if (!parse_json(p, value.items.back()))
+                return false;
+            skip_space(p);
+            if (*p == ',')
+                p++;
+            skip_space(p);
+        }
+    }
+    else if (*p == '"')
+    {
+        value.type = JsonValue::STRING;
+        return parse_json_string(p, value.text);
+    }
+    else if (isalpha((unsigned char) *p))
+    {
+        // true, false and null are not in our reports, read them as null
+        while (isalpha((unsigned char) *p))
+            p++;
+        return true;
+    }
+    else
+    {
+        char *end;
+        value.type = JsonValue::NUMBER;
+        value.number = strtod(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+        return true;
+    }
+
+    if (!*p)
+        return false;
+    p++;
+    return true;
+}
+
+// Stages slower than in the baseline report, printed; -1 when the baseline cannot be read
+static int count_regressions(const char *path, const std::vector<BenchResult> &results, double tolerance)
+{
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    const std::string json = text.str();
+    const char *p = json.c_str();
+    JsonValue baseline;
+    const JsonValue *entries = nullptr;
+    if (!file || !parse_json(p, baseline) || !(entries = baseline.get("results")) || entries->type != JsonValue::ARRAY)
+    {
+        fprintf(stderr, "cannot read the baseline %s\n", path);
+        return -1;
+    }
+
+    int regressions = 0;
+    for (const BenchResult &result : results)
+    {
+        const JsonValue *stages = nullptr;
+        for (const JsonValue &entry : entries->items)
+        {
+            const JsonValue *model = entry.get("model");
+            const JsonValue *image = entry.get("image");
+            const JsonValue *threads = entry.get("threads");
+            if (model && model->text == result.model && image && image->text == result.image && threads
+                && (int) threads->number == result.threads)
+                stages = entry.get("stages");
+        }
+        if (!stages)
+        {
+            fprintf(stderr, "  %s / %s / %d threads: not in the baseline\n", result.model.c_str(), result.image.c_str(),
+                    result.threads);
+            continue;
+        }
+
+        for (const StageStats &stats : result.stages)
+        {
+            const JsonValue *stage = stages->get(stats.name);
+            const JsonValue *p50 = stage ? stage->get("p50") : nullptr;
+            if (!p50)
+                continue;
+            if (stats.p50 > p50->number * (1 + tolerance) && stats.p50 - p50->number > regression_floor_ms)
+            {
+                fprintf(stderr, "  REGRESSION %s / %s / %d threads / %s: p50 %.3f ms, baseline %.3f ms (%+.1f%%)\n",
+                        result.model.c_str(), result.image.c_str(), result.threads, stats.name.c_str(), stats.p50,
+                        p50->number, 100 * (stats.p50 / p50->number - 1));
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *model_dir = nullptr;
+    std::vector<std::string> names;
+    std::vector<std::string> image_args;
+    std::vector<int> thread_counts;
+    int runs = 50;
+    int warmup = 5;
+    const char *output = nullptr;
+    const char *baseline = nullptr;
+    double tolerance = 0.10;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            image_args.push_back(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            warmup = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+                thread_counts.push_back(atoi(item.c_str()));
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            baseline = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (!model_dir)
+            model_dir = argv[i];
+        else
+            names.push_back(argv[i]);
+    }
+    if (!model_dir)
+    {
+        fprintf(stderr, "Usage: %s <model dir> [model name]... [-i image or dir]... [-n runs] [-w warmup] [-t threads,...]"
+                        " [-o report.json] [-b baseline.json] [-r tolerance]\n", argv[0]);
+        return -1;
+    }
+    if (names.empty())
+        names = {"YOLOv5s", "NanoDetPlus"};
+    if (thread_counts.empty())
+        thread_counts = {1, 2, 4};
+
+    std::vector<BenchImage> images;
+    images.push_back(synthetic_image(640, 480, 20240801));
+    images.push_back(synthetic_image(1280, 720, 20240802));
+    for (const std::string &arg : image_args)
+    {
+        std::vector<std::string> paths;
+        if (std::filesystem::is_directory(arg))
+            paths = list_images(arg.c_str(), 0);
+        else
+            paths.push_back(arg);
+        for (const std::string &path : paths)
+        {
+            BenchImage bench;
+            bench.name = std::filesystem::path(path).filename().string();
+            if (!load_image(path, bench.image))
+            {
+                fprintf(stderr, "cannot read %s\n", path.c_str());
+                return -1;
+            }
+            images.push_back(std::move(bench));
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const std::string &name : names)
+    {
+        const std::string base = std::string(model_dir) + "/" + name;
+        ModelConfig config;
+        std::string error;
+        if (!load_model_config((base + ".cfg").c_str(), config, &error))
+        {
+            fprintf(stderr, "%s.cfg: %s\n", base.c_str(), error.c_str());
+            return -1;
+        }
+        const std::string param = std::filesystem::exists(base + ".param.bin") ? base + ".param.bin" : base + ".param";
+        GenericDetector detector(config, param.c_str(), (base + ".bin").c_str(), false, 0);
+        if (detector.load_error() != LOAD_OK)
+        {
+            fprintf(stderr, "%s: %s\n", base.c_str(), load_error_string(detector.load_error()));
+            return -1;
+        }
+
+        for (int threads : thread_counts)
+        {
+            for (const BenchImage &bench : images)
+            {
+                BenchResult result;
+                result.model = name;
+                if (!run_model(detector, bench, threads, runs, warmup, result))
+                    return -1;
+
+                fprintf(stderr, "%s / %s / %d threads, %d boxes\n", name.c_str(), bench.name.c_str(), threads, result.boxes);
+                for (const StageStats &stats : result.stages)
+                    fprintf(stderr, "  %-24s mean %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f ms\n", stats.name.c_str(),
+                            stats.mean, stats.p50, stats.p90, stats.p99);
+                results.push_back(result);
+            }
+        }
+    }
+
+    FILE *fp = output ? fopen(output, "wb") : stdout;
+    if (!fp)
+    {
+        fprintf(stderr, "cannot write %s\n", output);
+        return -1;
+    }
+    write_report(fp, results, runs, warmup);
+    if (output)
+        fclose(fp);
+
+    if (baseline)
+    {
+        const int regressions = count_regressions(baseline, results, tolerance);
+        if (regressions != 0)
+        {
+            if (regressions > 0)
+                fprintf(stderr, "%d stages slower than %s\n", regressions, baseline);
+            return 1;
+        }
+        fprintf(stderr, "no regression against %s\n", baseline);
+    }
+    return 0;
+}
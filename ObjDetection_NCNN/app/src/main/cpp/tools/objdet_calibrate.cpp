@@ -0,0 +1,425 @@
+//
+// INT8 calibration table for ncnn2int8
+// Usage: objdet_calibrate <model.cfg> <model.param> <model.bin> <image dir> <out.table> [max_images]
+//
+// The images go through the same letterbox preprocessing as on device, so the activation ranges are
+// the ones the quantized net will meet. Weight scales are per output channel (per group for depthwise),
+// activation scales come from the KL-divergence threshold of a 2048-bin histogram, as ncnn2table does.
+// Then quantize with
+//   ncnn2int8 model.param model.bin model-int8.param model-int8.bin model.table
+// and load model-int8 through a sidecar with "precision = int8".
+//
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include "modelbin.h"
+#include "net.h"
+#include "ModelConfig.h"
+#include "Preprocess.h"
+#include "ToolUtils.h"
+
+static const int num_histogram_bins = 2048;
+static const int target_bins = 128;
+
+// Layers ncnn2int8 quantizes, with the ids of their parameters
+typedef struct QuantLayerType {
+    const char *type;
+    int bias_term_id;
+    int weight_data_size_id;
+    bool depthwise;
+} QuantLayerType;
+
+static const QuantLayerType quant_types[] = {
+    {"Convolution", 5, 6, false},
+    {"ConvolutionDepthWise", 5, 6, true},
+    {"InnerProduct", 1, 2, false},
+};
+
+typedef struct QuantLayer {
+    std::string name;
+    std::string bottom;
+    int type;                   // index into quant_types
+    std::vector<float> weight_scales;
+    float absmax = 0.f;
+    std::vector<float> histogram;
+    float bottom_scale = 0.f;
+} QuantLayer;
+
+// Stands in for a quantizable layer while the weights are read: keeps the scale of every output channel
+class WeightScaleLayer : public ncnn::Layer {
+public:
+    int load_param(const ncnn::ParamDict &pd) override
+    {
+        const QuantLayerType &t = quant_types[quant_type];
+        num_output = pd.get(0, 0);
+        bias_term = pd.get(t.bias_term_id, 0);
+        weight_data_size = pd.get(t.weight_data_size_id, 0);
+        group = t.depthwise ? pd.get(7, 1) : 1;
+        int8_scale_term = pd.get(8, 0);
+        dynamic_weight = t.depthwise || quant_type == 2 ? 0 : pd.get(19, 0);
+        return 0;
+    }
+
+    int load_model(const ncnn::ModelBin &mb) override
+    {
+        if (dynamic_weight)
+            return 0;
+
+        // same reads as the real layer, the following layers find their weights where they expect them
+        ncnn::Mat weight_data = mb.load(weight_data_size, 0);
+        if (weight_data.empty())
+            return -100;
+        if (bias_term && mb.load(num_output, 1).empty())
+            return -100;
+        if (int8_scale_term)
+        {
+            fprintf(stderr, "%s is quantized already\n", name.c_str());
+            return -1;
+        }
+        if (!scales)
+            return 0;
+
+        const int channels = quant_types[quant_type].depthwise ? group : num_output;
+        const int per_channel = weight_data_size / std::max(channels, 1);
+        const float *ptr = weight_data;
+        scales->resize(channels);
+        for (int c = 0; c < channels; c++)
+        {
+            float absmax = 0.f;
+            for (int i = 0; i < per_channel; i++)
+                absmax = std::max(absmax, std::fabs(ptr[c * per_channel + i]));
+            (*scales)[c] = absmax == 0.f ? 1.f : 127.f / absmax;
+        }
+        return 0;
+    }
+
+    int quant_type = 0;           // index into quant_types
+    std::vector<float> *scales = nullptr;
+
+private:
+    int num_output = 0;
+    int bias_term = 0;
+    int weight_data_size = 0;
+    int group = 1;
+    int int8_scale_term = 0;
+    int dynamic_weight = 0;
+};
+
+// Renamed layer types, so the stand-ins are found without replacing ncnn's built-in layers
+static const char *const standin_names[] = {"ObjdetCalibConvolution", "ObjdetCalibConvolutionDepthWise", "ObjdetCalibInnerProduct"};
+
+template<int Type>
+static ncnn::Layer *create_standin(void * /*userdata*/)
+{
+    WeightScaleLayer *layer = new WeightScaleLayer();
+    layer->quant_type = Type;
+    return layer;
+}
+
+// Parse the text .param: the quantizable layers, their input blob, and the param text with their
+// types replaced by the stand-ins
+static bool read_param(const char *path, std::vector<QuantLayer> &layers, std::string &standin_param)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    std::string line;
+    int magic = 0;
+    if (!std::getline(file, line) || (std::istringstream(line) >> magic, magic != 7767517))
+    {
+        fprintf(stderr, "%s is not a text param file\n", path);
+        return false;
+    }
+    standin_param = line + "\n";
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string type, name;
+        int num_bottom = 0, num_top = 0;
+        if (!(fields >> type >> name >> num_bottom >> num_top))
+        {
+            standin_param += line + "\n";
+            continue;
+        }
+
+        for (int t = 0; t < 3; t++)
+        {
+            if (type != quant_types[t].type)
+                continue;
+
+            QuantLayer layer;
+            layer.name = name;
+            layer.type = t;
+            if (num_bottom > 0)
+                fields >> layer.bottom;
+            layers.push_back(layer);
+            line = standin_names[t] + line.substr(type.size());
+            break;
+        }
+        standin_param += line + "\n";
+    }
+    return true;
+}
+
+static float kl_divergence(const std::vector<float> &p, const std::vector<float> &q)
+{
+    float p_sum = 0.f, q_sum = 0.f;
+    for (size_t i = 0; i < p.size(); i++)
+    {
+        p_sum += p[i];
+        q_sum += q[i];
+    }
+    if (p_sum == 0.f || q_sum == 0.f)
+        return FLT_MAX;
+
+    float kl = 0.f;
+    for (size_t i = 0; i < p.size(); i++)
+    {
+        const float pi = p[i] / p_sum;
+        const float qi = q[i] / q_sum;
+        if (pi == 0.f)
+            continue;
+        // a bin the quantized distribution lost entirely
+        kl += qi == 0.f ? 1.f : pi * std::log(pi / qi);
+    }
+    return kl;
+}
+
+// Histogram bin where clipping loses the least information once folded into target_bins levels
+static int kl_threshold(const std::vector<float> &histogram)
+{
+    const int length = (int) histogram.size();
+    float outliers = 0.f;
+    for (int i = target_bins; i < length; i++)
+        outliers += histogram[i];
+
+    int best = length - 1;
+    float best_kl = FLT_MAX;
+    std::vector<float> quantized(target_bins);
+    for (int threshold = target_bins; threshold < length; threshold++)
+    {
+        // P: the histogram clipped at threshold, the clipped mass lands in the last bin
+        std::vector<float> p(histogram.begin(), histogram.begin() + threshold);
+        p[threshold - 1] += outliers;
+        outliers -= histogram[threshold];
+
+        // Q: the clipped range merged into target_bins levels, spread back over the non-empty source bins
+        const float bins_per_level = (float) threshold / target_bins;
+        std::vector<float> q(threshold, 0.f);
+        for (int level = 0; level < target_bins; level++)
+        {
+            const float start = level * bins_per_level;
+            const float end = start + bins_per_level;
+            const int first = (int) std::ceil(start);
+            const int last = (int) std::floor(end);
+
+            float sum = 0.f, count = 0.f;
+            if (first > start)
+            {
+                sum += (first - start) * histogram[first - 1];
+                count += histogram[first - 1] != 0.f ? first - start : 0.f;
+            }
+            if (last < end && last < threshold)
+            {
+                sum += (end - last) * histogram[last];
+                count += histogram[last] != 0.f ? end - last : 0.f;
+            }
+            for (int j = first; j < last; j++)
+            {
+                sum += histogram[j];
+                count += histogram[j] != 0.f ? 1.f : 0.f;
+            }
+            if (count == 0.f)
+                continue;
+
+            const float value = sum / count;
+            if (first > start && histogram[first - 1] != 0.f)
+                q[first - 1] += value * (first - start);
+            if (last < end && last < threshold && histogram[last] != 0.f)
+                q[last] += value * (end - last);
+            for (int j = first; j < last; j++)
+            {
+                if (histogram[j] != 0.f)
+                    q[j] += value;
+            }
+        }
+
+        const float kl = kl_divergence(p, q);
+        if (kl < best_kl)
+        {
+            best_kl = kl;
+            best = threshold;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 6)
+    {
+        fprintf(stderr, "Usage: %s <model.cfg> <model.param> <model.bin> <image dir> <out.table> [max_images]\n", argv[0]);
+        return -1;
+    }
+    const int max_images = argc > 6 ? atoi(argv[6]) : 0;
+
+    ModelConfig config;
+    std::string error;
+    if (!load_model_config(argv[1], config, &error))
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return -1;
+    }
+
+    std::vector<QuantLayer> layers;
+    std::string standin_param;
+    if (!read_param(argv[2], layers, standin_param))
+        return -1;
+    if (layers.empty())
+    {
+        fprintf(stderr, "no layer to quantize in %s\n", argv[2]);
+        return -1;
+    }
+
+    // weight scales: the model loaded once more with the stand-ins in place of the quantizable layers
+    {
+        ncnn::Net weights;
+        weights.register_custom_layer(standin_names[0], create_standin<0>);
+        weights.register_custom_layer(standin_names[1], create_standin<1>);
+        weights.register_custom_layer(standin_names[2], create_standin<2>);
+        if (weights.load_param_mem(standin_param.c_str()))
+        {
+            fprintf(stderr, "cannot load %s\n", argv[2]);
+            return -1;
+        }
+        size_t next = 0;
+        for (ncnn::Layer *layer : weights.mutable_layers())
+        {
+            for (int t = 0; t < 3; t++)
+            {
+                if (layer->type == standin_names[t] && next < layers.size())
+                    ((WeightScaleLayer *) layer)->scales = &layers[next++].weight_scales;
+            }
+        }
+        if (weights.load_model(argv[3]))
+        {
+            fprintf(stderr, "cannot load %s\n", argv[3]);
+            return -1;
+        }
+    }
+
+    ncnn::Net net;
+    net.opt.use_bf16_storage = false;
+    net.opt.use_fp16_packed = false;
+    net.opt.use_fp16_storage = false;
+    net.opt.use_fp16_arithmetic = false;
+    net.opt.use_int8_inference = false;
+    if (net.load_param(argv[2]) || net.load_model(argv[3]))
+    {
+        fprintf(stderr, "cannot load %s / %s\n", argv[2], argv[3]);
+        return -1;
+    }
+
+    std::vector<std::string> paths = list_images(argv[4], max_images);
+    if (paths.empty())
+    {
+        fprintf(stderr, "no image in %s\n", argv[4]);
+        return -1;
+    }
+
+    // bottoms shared by several layers are collected once
+    std::map<std::string, std::vector<QuantLayer *>> bottoms;
+    for (QuantLayer &layer : layers)
+        bottoms[layer.bottom].push_back(&layer);
+
+    LetterboxPreprocessor preprocessor;
+    ncnn::Mat in_pad;
+    // two passes over the images: the range of every activation, then its histogram over that range
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int loaded = 0;
+        for (const std::string &path : paths)
+        {
+            LoadedImage image;
+            if (!load_image(path, image))
+            {
+                fprintf(stderr, "skipping %s\n", path.c_str());
+                continue;
+            }
+            loaded++;
+
+            LetterboxInfo letterbox = compute_letterbox(image.width, image.height, config.target_size, config.max_stride);
+            preprocessor.run(image.buffer(), letterbox, config.to_bgr, config.pad_value, config.mean_vals,
+                             config.norm_vals, in_pad);
+
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_light_mode(false);
+            ex.input(config.input_blob.c_str(), in_pad);
+
+            for (auto &bottom : bottoms)
+            {
+                ncnn::Mat blob;
+                if (ex.extract(bottom.first.c_str(), blob))
+                    continue;
+
+                QuantLayer &first = *bottom.second[0];
+                if (pass == 0 && first.histogram.empty())
+                    first.histogram.assign(num_histogram_bins, 0.f);
+                const float bin_width = first.absmax / num_histogram_bins;
+                for (int q = 0; q < blob.c; q++)
+                {
+                    const float *ptr = blob.channel(q);
+                    for (int i = 0; i < blob.w * blob.h; i++)
+                    {
+                        const float v = std::fabs(ptr[i]);
+                        if (pass == 0)
+                            first.absmax = std::max(first.absmax, v);
+                        else if (v != 0.f && bin_width > 0.f)
+                            first.histogram[std::min((int) (v / bin_width), num_histogram_bins - 1)] += 1.f;
+                    }
+                }
+            }
+        }
+        fprintf(stderr, "pass %d: %d images\n", pass + 1, loaded);
+    }
+
+    for (auto &bottom : bottoms)
+    {
+        QuantLayer &first = *bottom.second[0];
+        float scale = 1.f;
+        if (first.absmax > 0.f)
+        {
+            const float bin_width = first.absmax / num_histogram_bins;
+            const float threshold = (kl_threshold(first.histogram) + 0.5f) * bin_width;
+            scale = 127.f / threshold;
+        }
+        for (QuantLayer *layer : bottom.second)
+            layer->bottom_scale = scale;
+    }
+
+    // ncnn2int8 table: weight scales per layer, then the scale of each layer's input
+    FILE *fp = fopen(argv[5], "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot write %s\n", argv[5]);
+        return -1;
+    }
+    for (const QuantLayer &layer : layers)
+    {
+        fprintf(fp, "%s_param_0", layer.name.c_str());
+        for (float scale : layer.weight_scales)
+            fprintf(fp, " %f", scale);
+        fprintf(fp, "\n");
+    }
+    for (const QuantLayer &layer : layers)
+        fprintf(fp, "%s %f\n", layer.name.c_str(), layer.bottom_scale);
+    fclose(fp);
+
+    fprintf(stderr, "%d layers calibrated on %d images into %s\n", (int) layers.size(), (int) paths.size(), argv[5]);
+    return 0;
+}
@@ -0,0 +1,214 @@
+//
+// Accuracy / latency report of model variants on a labeled image set
+// Usage: objdet_compare <dataset dir> <model dir> <model name>... [-t threads] [-n max_images]
+//
+// Every model name loads <model dir>/<name>.cfg, .param and .bin, the sidecar picks the precision,
+// e.g. YOLOv5s (bf16), YOLOv5s-fp32 and YOLOv5s-int8. The dataset holds images with YOLO labels
+// (see ToolUtils.h). The first model is the baseline of the speedup and mAP columns.
+//
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include "GenericDetector.h"
+#include "ToolUtils.h"
+
+// Detections are kept down to a low score so the precision / recall curve is complete
+static const float score_threshold = 0.05f;
+static const float nms_threshold = 0.6f;
+static const float match_iou = 0.5f;
+
+static float iou(const BoxInfo &a, const BoxInfo &b)
+{
+    const float iw = std::min(a.x1 + a.w, b.x1 + b.w) - std::max(a.x1, b.x1);
+    const float ih = std::min(a.y1 + a.h, b.y1 + b.h) - std::max(a.y1, b.y1);
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    return iw * ih / (a.w * a.h + b.w * b.h - iw * ih);
+}
+
+typedef struct ModelReport {
+    std::string name;
+    std::string precision;
+    double map50 = 0;
+    double recall = 0;          // at score >= 0.3, the app's default threshold
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p90_ms = 0;
+} ModelReport;
+
+// VOC all-point average precision of every class with labels, averaged
+static void evaluate(const std::vector<std::vector<BoxInfo>> &truth, const std::vector<std::vector<BoxInfo>> &detections,
+                     double &map50, double &recall)
+{
+    struct Hit {
+        float score;
+        bool tp;
+    };
+    std::map<int, std::vector<Hit>> hits;
+    std::map<int, int> num_truth;
+    int found = 0;
+    int total = 0;
+
+    for (size_t i = 0; i < truth.size(); i++)
+    {
+        for (const BoxInfo &object : truth[i])
+            num_truth[object.label]++;
+        total += (int) truth[i].size();
+
+        std::vector<BoxInfo> sorted = detections[i];
+        std::sort(sorted.begin(), sorted.end(), [](const BoxInfo &a, const BoxInfo &b) { return a.score > b.score; });
+        std::vector<char> used(truth[i].size(), 0);
+        for (const BoxInfo &box : sorted)
+        {
+            int best = -1;
+            float best_iou = match_iou;
+            for (size_t j = 0; j < truth[i].size(); j++)
+            {
+                const float v = truth[i][j].label == box.label && !used[j] ? iou(box, truth[i][j]) : 0.f;
+                if (v >= best_iou)
+                {
+                    best_iou = v;
+                    best = (int) j;
+                }
+            }
+            if (best >= 0)
+            {
+                used[best] = 1;
+                found += box.score >= 0.3f;
+            }
+            hits[box.label].push_back({box.score, best >= 0});
+        }
+    }
+
+    double ap_sum = 0;
+    for (const auto &cls : num_truth)
+    {
+        std::vector<Hit> &list = hits[cls.first];
+        std::sort(list.begin(), list.end(), [](const Hit &a, const Hit &b) { return a.score > b.score; });
+
+        std::vector<double> precision(list.size()), recall_at(list.size());
+        int tp = 0;
+        for (size_t k = 0; k < list.size(); k++)
+        {
+            tp += list[k].tp;
+            precision[k] = (double) tp / (k + 1);
+            recall_at[k] = (double) tp / cls.second;
+        }
+        // precision envelope, then the area under the steps
+        for (int k = (int) list.size() - 2; k >= 0; k--)
+            precision[k] = std::max(precision[k], precision[k + 1]);
+        double ap = 0, last_recall = 0;
+        for (size_t k = 0; k < list.size(); k++)
+        {
+            ap += (recall_at[k] - last_recall) * precision[k];
+            last_recall = recall_at[k];
+        }
+        ap_sum += ap;
+    }
+
+    map50 = num_truth.empty() ? 0 : ap_sum / num_truth.size();
+    recall = total ? (double) found / total : 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> names;
+    const char *dataset = nullptr;
+    const char *model_dir = nullptr;
+    int threads = 4;
+    int max_images = 500;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            max_images = atoi(argv[++i]);
+        else if (!dataset)
+            dataset = argv[i];
+        else if (!model_dir)
+            model_dir = argv[i];
+        else
+            names.push_back(argv[i]);
+    }
+    if (!dataset || !model_dir || names.empty())
+    {
+        fprintf(stderr, "Usage: %s <dataset dir> <model dir> <model name>... [-t threads] [-n max_images]\n", argv[0]);
+        return -1;
+    }
+
+    std::vector<LoadedImage> images;
+    std::vector<std::vector<BoxInfo>> truth;
+    for (const std::string &path : list_images(dataset, max_images))
+    {
+        LoadedImage image;
+        if (!load_image(path, image))
+        {
+            fprintf(stderr, "skipping %s\n", path.c_str());
+            continue;
+        }
+        truth.push_back(load_labels(path, image.width, image.height));
+        images.push_back(std::move(image));
+    }
+    if (images.empty())
+    {
+        fprintf(stderr, "no image in %s\n", dataset);
+        return -1;
+    }
+
+    static const char *const precision_names[] = {"fp32", "bf16", "int8"};
+    std::vector<ModelReport> reports;
+    for (const std::string &name : names)
+    {
+        const std::string base = std::string(model_dir) + "/" + name;
+        ModelConfig config;
+        std::string error;
+        if (!load_model_config((base + ".cfg").c_str(), config, &error))
+        {
+            fprintf(stderr, "%s.cfg: %s\n", base.c_str(), error.c_str());
+            return -1;
+        }
+        const std::string param = std::filesystem::exists(base + ".param.bin") ? base + ".param.bin" : base + ".param";
+        GenericDetector detector(config, param.c_str(), (base + ".bin").c_str(), false, threads);
+        if (detector.load_error() != LOAD_OK)
+        {
+            fprintf(stderr, "%s: %s\n", base.c_str(), load_error_string(detector.load_error()));
+            return -1;
+        }
+
+        std::vector<std::vector<BoxInfo>> detections(images.size());
+        std::vector<double> times;
+        // the first images also warm up the pools, they are not timed
+        for (size_t i = 0; i < std::min(images.size(), (size_t) 3); i++)
+            detector.detect(images[i].buffer(), score_threshold, nms_threshold, detections[i]);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            const double start = get_current_time();
+            detector.detect(images[i].buffer(), score_threshold, nms_threshold, detections[i]);
+            times.push_back(get_current_time() - start);
+        }
+
+        ModelReport report;
+        report.name = name;
+        report.precision = precision_names[config.precision];
+        evaluate(truth, detections, report.map50, report.recall);
+        for (double t : times)
+            report.mean_ms += t;
+        report.mean_ms /= times.size();
+        std::sort(times.begin(), times.end());
+        report.p50_ms = times[times.size() / 2];
+        report.p90_ms = times[std::min(times.size() * 9 / 10, times.size() - 1)];
+        reports.push_back(report);
+    }
+
+    fprintf(stdout, "%d images, %d threads\n", (int) images.size(), threads);
+    fprintf(stdout, "%-24s %-5s %8s %9s %8s %8s %8s %8s %8s\n", "model", "prec", "mAP@.5", "d mAP", "recall", "mean ms",
+            "p50 ms", "p90 ms", "speedup");
+    for (const ModelReport &report : reports)
+    {
+        fprintf(stdout, "%-24s %-5s %8.4f %+9.4f %7.1f%% %8.2f %8.2f %8.2f %7.2fx\n", report.name.c_str(),
+                report.precision.c_str(), report.map50, report.map50 - reports[0].map50, 100 * report.recall,
+                report.mean_ms, report.p50_ms, report.p90_ms, reports[0].mean_ms / report.mean_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+//
+// Where the time of a model goes, layer by layer
+// Usage: objdet_profile <model dir> <model name> [-i image] [-n runs] [-w warmup] [-t threads] [-r rows]
+//                       [-f folded.txt]
+//
+// Loads <model dir>/<name>.cfg, .param and .bin like objdet_compare, runs warmup detections, then profiles runs
+// detections of the image (a synthetic 640 x 480 frame without -i) on the CPU. Prints the layers slowest first
+// with their mean and max forward time, share of the total, output shape and size, then the time per layer type.
+// -f writes the profile as folded stacks for flamegraph.pl or speedscope.app.
+//
+
+#include <cstring>
+#include <random>
+#include "GenericDetector.h"
+#include "ToolUtils.h"
+
+static const float score_threshold = 0.3f;
+static const float nms_threshold = 0.5f;
+
+int main(int argc, char **argv)
+{
+    const char *model_dir = nullptr;
+    const char *name = nullptr;
+    const char *image_path = nullptr;
+    const char *folded_path = nullptr;
+    int runs = 50;
+    int warmup = 5;
+    int threads = 0;
+    int rows = 30;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            image_path = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            warmup = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rows = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            folded_path = argv[++i];
+        else if (!model_dir)
+            model_dir = argv[i];
+        else if (!name)
+            name = argv[i];
+    }
+    if (!model_dir || !name)
+    {
+        fprintf(stderr, "Usage: %s <model dir> <model name> [-i image] [-n runs] [-w warmup] [-t threads] [-r rows]"
+                        " [-f folded.txt]\n", argv[0]);
+        return -1;
+    }
+
+    LoadedImage image;
+    if (image_path)
+    {
+        if (!load_image(image_path, image))
+        {
+            fprintf(stderr, "cannot read %s\n", image_path);
+            return -1;
+        }
+    }
+    else
+    {
+        image.path = "synthetic-640x480";
+        image.width = 640;
+        image.height = 480;
+        image.pixels.resize((size_t) image.width * image.height * 3);
+        std::mt19937 rng(20240810);
+        std::uniform_int_distribution<int> noise(0, 255);
+        for (auto &v : image.pixels)
+            v = (unsigned char) noise(rng);
+    }
+
+    const std::string base = std::string(model_dir) + "/" + name;
+    ModelConfig config;
+    std::string error;
+    if (!load_model_config((base + ".cfg").c_str(), config, &error))
+    {
+        fprintf(stderr, "%s.cfg: %s\n", base.c_str(), error.c_str());
+        return -1;
+    }
+    const std::string param = std::filesystem::exists(base + ".param.bin") ? base + ".param.bin" : base + ".param";
+    GenericDetector detector(config, param.c_str(), (base + ".bin").c_str(), false, threads);
+    if (detector.load_error() != LOAD_OK)
+    {
+        fprintf(stderr, "%s: %s\n", base.c_str(), load_error_string(detector.load_error()));
+        return -1;
+    }
+    if (!detector.set_layer_profiling(false))
+    {
+        fprintf(stderr, "%s: layer profiling needs a CPU net\n", name);
+        return -1;
+    }
+
+    // boxes of the plain net, the profiled runs have to find the same
+    const ImageBuffer buffer = image.buffer();
+    const std::vector<BoxInfo> reference = detector.detect(buffer, score_threshold, nms_threshold);
+    detector.set_layer_profiling(true);
+    for (int i = 0; i < warmup; i++)
+        detector.detect(buffer, score_threshold, nms_threshold);
+    detector.reset_layer_profile();
+
+    const double start = get_current_time();
+    std::vector<BoxInfo> boxes;
+    for (int i = 0; i < runs; i++)
+        boxes = detector.detect(buffer, score_threshold, nms_threshold);
+    const double frame_ms = (get_current_time() - start) / runs;
+    detector.set_layer_profiling(false);
+
+    if (boxes.size() != reference.size())
+    {
+        fprintf(stderr, "%d boxes while profiling, %d without\n", (int) boxes.size(), (int) reference.size());
+        return -1;
+    }
+
+    const std::vector<LayerProfile> profile = detector.layer_profile();
+    double layers_ms = 0;
+    for (const LayerProfile &layer : profile)
+        layers_ms += layer.mean_ms;
+    printf("%s / %s: %d runs, %.3f ms per frame, %.3f ms in %d layers\n\n", name, image.path.c_str(), runs, frame_ms,
+           layers_ms, (int) profile.size());
+    printf("%s", format_layer_report(profile, rows).c_str());
+
+    if (folded_path)
+    {
+        FILE *fp = fopen(folded_path, "wb");
+        const std::string folded = format_folded_stacks(profile, name);
+        if (!fp || fwrite(folded.data(), 1, folded.size(), fp) != folded.size() || fclose(fp) != 0)
+        {
+            fprintf(stderr, "cannot write %s\n", folded_path);
+            return -1;
+        }
+        fprintf(stderr, "folded stacks in %s\n", folded_path);
+    }
+    return 0;
+}
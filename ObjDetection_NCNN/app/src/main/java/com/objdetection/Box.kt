@@ -17,7 +17,7 @@ class Box(
     }
 
     fun getLabel(): String {
-        return labels[label]
+        return labelName(label)
     }
 
     fun getScore(): Float {
@@ -25,11 +25,19 @@ class Box(
     }
 
     fun getColor(): Int {
-        val random = Random(label.toLong())
-        return Color.argb(255, random.nextInt(256), random.nextInt(256), random.nextInt(256))
+        return color(label)
     }
 
     companion object {
+        fun labelName(label: Int): String {
+            return labels[label]
+        }
+
+        fun color(label: Int): Int {
+            val random = Random(label.toLong())
+            return Color.argb(255, random.nextInt(256), random.nextInt(256), random.nextInt(256))
+        }
+
         private val labels = arrayOf(
             "person", "bicycle", "car", "motorcycle", "airplane","bus","train", "truck", "boat", "traffic light",
             "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
@@ -0,0 +1,23 @@
+package com.objdetection
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
+import java.nio.IntBuffer
+
+// Reusable output of the *Into detect calls, filled by native code without creating objects:
+// x0, y0, w, h, score of box i at boxes[i * 5] and its class at labels[i]
+class BoxBuffer(val capacity: Int = 100) {
+    val boxes: FloatBuffer = ByteBuffer.allocateDirect(capacity * 5 * 4)
+        .order(ByteOrder.nativeOrder()).asFloatBuffer()
+    val labels: IntBuffer = ByteBuffer.allocateDirect(capacity * 4)
+        .order(ByteOrder.nativeOrder()).asIntBuffer()
+    var count = 0
+
+    fun x0(i: Int): Float = boxes.get(i * 5)
+    fun y0(i: Int): Float = boxes.get(i * 5 + 1)
+    fun w(i: Int): Float = boxes.get(i * 5 + 2)
+    fun h(i: Int): Float = boxes.get(i * 5 + 3)
+    fun score(i: Int): Float = boxes.get(i * 5 + 4)
+    fun label(i: Int): Int = labels.get(i)
+}
@@ -0,0 +1,17 @@
+package com.objdetection
+
+import android.graphics.Bitmap
+import java.nio.ByteBuffer
+
+object CameraFrame {
+    // Upright ARGB_8888 copy of a YUV_420_888 frame, the bitmap must already have the rotated size
+    external fun toBitmap(
+        y: ByteBuffer, u: ByteBuffer, v: ByteBuffer, width: Int, height: Int,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int, rotation: Int,
+        bitmap: Bitmap
+    ): Boolean
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}
@@ -0,0 +1,42 @@
+package com.objdetection
+
+import java.nio.ByteBuffer
+import java.nio.FloatBuffer
+import java.nio.IntBuffer
+
+// Native pipeline: preprocessing, inference and post-processing of consecutive frames overlap
+object DetectPipeline {
+    const val DROP_NEWEST = 0
+    const val DROP_OLDEST = 1
+    const val BLOCK = 2
+
+    // model is MainActivity's NANODET / YOLOV5S, the model must already be initialized
+    // maxKeyInterval > 1 only runs the model on key frames and tracks the boxes in between
+    external fun start(model: Int, depth: Int, dropPolicy: Int, maxKeyInterval: Int): Boolean
+    external fun stop()
+
+    // Copies the planes, returns the frame id or -1 when the frame was dropped
+    external fun submitYUV(
+        y: ByteBuffer, u: ByteBuffer, v: ByteBuffer, width: Int, height: Int,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int, rotation: Int,
+        threshold: Float, nms_threshold: Float
+    ): Long
+
+    // Oldest finished frame, null when none is ready
+    external fun poll(): DetectResult?
+
+    // Same without allocating: boxes go into out, info receives count, width and height
+    // Returns the frame id, -1 when none is ready
+    external fun pollInto(boxes: FloatBuffer, labels: IntBuffer, info: IntArray): Long
+
+    fun pollInto(out: BoxBuffer, info: IntArray): Long {
+        val frameId = pollInto(out.boxes, out.labels, info)
+        if (frameId >= 0)
+            out.count = info[0]
+        return frameId
+    }
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}
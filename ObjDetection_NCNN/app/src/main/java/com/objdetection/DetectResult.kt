@@ -0,0 +1,8 @@
+package com.objdetection
+
+class DetectResult(
+    val frameId: Long,
+    val width: Int,
+    val height: Int,
+    val boxes: Array<Box>
+)
@@ -0,0 +1,80 @@
+package com.objdetection
+
+import android.content.res.AssetManager
+import android.graphics.Bitmap
+
+// Models described by a sidecar in the assets: <name>.cfg, <name>.param and <name>.bin
+// Box labels are indexes into the model's own class list
+object GenericDetector {
+    // Load results, same values as LoadError in cpp/ModelFile.h
+    const val LOAD_OK = 0
+    const val LOAD_CONFIG_INVALID = -1
+    const val LOAD_PARAM_MISSING = -2
+    const val LOAD_PARAM_INVALID = -3
+    const val LOAD_MODEL_MISSING = -4
+    const val LOAD_MODEL_INVALID = -5
+    const val LOAD_BLOB_NOT_FOUND = -6
+
+    // <name>.param.bin (ncnn2mem, blobs given by index in the sidecar) is used instead of <name>.param when present
+    external fun load(manager: AssetManager?, name: String, useGPU: Boolean, threadsNumber: Int): Int
+    external fun detect(name: String, bitmap: Bitmap?, threshold: Float, nms_threshold: Float): Array<Box>?
+
+    // Large photos: overlapping tiles at the model's input size (tileSize <= 0) keep small objects detectable,
+    // globalPass also runs the whole image for objects bigger than a tile
+    external fun detectTiled(
+        name: String, bitmap: Bitmap?, threshold: Float, nms_threshold: Float,
+        tileSize: Int, overlap: Float, globalPass: Boolean
+    ): Array<Box>?
+
+    // Trade input resolution for latency to stay within targetMs per frame, also for the stock models
+    // registered as "NanoDetPlus" / "YOLOv5s"; targetMs <= 0 restores the fixed resolution
+    external fun setAdaptive(name: String, targetMs: Float): Boolean
+
+    // Inference threads on chosen CPU clusters, pre/post-processing on the others: a plan returned by autotune,
+    // or "prime" (fastest cluster), "performance" (all but the slowest) or "all"; call it before detecting
+    external fun setScheduling(name: String, plan: String): Boolean
+
+    // Times the candidate plans on a width x height frame, applies the fastest and returns it for setScheduling,
+    // null if the model is not loaded; takes a few seconds, keep other detections off the model meanwhile
+    external fun autotune(name: String, width: Int, height: Int): String?
+
+    // CPU clusters of the device as "<max kHz>x<cores>,...", fastest first
+    external fun cpuLayout(): String
+
+    // Skips the heads finer than minStride (8, 16, 32...) when only large objects matter, the coarsest head
+    // always runs; 0 runs every head. Call it before detecting.
+    external fun setMinStride(name: String, minStride: Int): Boolean
+
+    // Each head output is decoded on a helper thread while the net computes the next one, on by default
+    external fun setDecodeOverlap(name: String, enabled: Boolean): Boolean
+
+    // Per-stage latency histograms, proposal counts and allocator pool hits, cheap enough to leave on;
+    // traceEvents > 0 also keeps that many stage events for writeTrace
+    external fun setStatsEnabled(name: String, enabled: Boolean, traceEvents: Int): Boolean
+
+    // JSON snapshot: frames, mean / p50 / p90 / p99 / max ms per stage, proposals and pool hits
+    external fun getStats(name: String): String?
+
+    external fun resetStats(name: String): Boolean
+
+    // Chrome trace / Perfetto JSON of the last stage events, e.g. into getExternalFilesDir(null)
+    external fun writeTrace(name: String, path: String): Boolean
+
+    // Forward time, output shape and size of every layer, summed over the frames detected while on;
+    // CPU models only, enable it once before detecting
+    external fun setLayerProfiling(name: String, enabled: Boolean): Boolean
+
+    // Slowest maxRows layers (all when 0) with their share of the time, then the time per layer type
+    external fun layerReport(name: String, maxRows: Int): String?
+
+    // Weights stored compressed in the APK are inflated once into path and mapped from there afterwards;
+    // call before loading, codeCacheDir is cleared with every app update
+    external fun setCacheDir(path: String)
+
+    // Runs a blank frame through a loaded model in the background, returns at once
+    external fun warmUp(name: String, width: Int, height: Int): Boolean
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}
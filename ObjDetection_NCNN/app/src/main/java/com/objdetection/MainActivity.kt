@@ -9,11 +9,8 @@ import android.database.Cursor
 import android.graphics.Bitmap
 import android.graphics.BitmapFactory
 import android.graphics.Canvas
-import android.graphics.ImageFormat
 import android.graphics.Matrix
 import android.graphics.Paint
-import android.graphics.Rect
-import android.graphics.YuvImage
 import android.net.Uri
 import android.os.Build
 import android.os.Bundle
@@ -42,7 +39,6 @@ import androidx.exifinterface.media.ExifInterface
 import androidx.preference.PreferenceManager
 import com.objdetection.databinding.ActivityMainBinding
 import wseemann.media.FFmpegMediaMetadataRetriever
-import java.io.ByteArrayOutputStream
 import java.io.IOException
 import java.util.Locale
 import java.util.concurrent.ExecutionException
@@ -70,6 +66,8 @@ class MainActivity : AppCompatActivity() {
     private val detectCamera = AtomicBoolean(false)
     private val detectPhoto = AtomicBoolean(false)
     private val detectVideo = AtomicBoolean(false)
+    // the scheduling auto-tune owns the model until it is done
+    private val schedulingTuning = AtomicBoolean(false)
 
     private var errorFlag = 1
 
@@ -89,6 +87,13 @@ class MainActivity : AppCompatActivity() {
     private var FPSCount = 0
 
     private var mutableBitmap: Bitmap? = null
+    // frames still in the pipeline plus the one on screen
+    private val cameraFrames = arrayOfNulls<Bitmap>(PIPELINE_DEPTH + 2)
+    @Volatile private var pipelineStarted = false
+    // camera results are polled into these, nothing is allocated per frame
+    private val cameraBoxes = BoxBuffer()
+    private val cameraInfo = IntArray(3)
+    private var lastResultTime: Long = 0
 //    private var mReusableBitmap: Bitmap? = null
     private var detectService = Executors.newSingleThreadExecutor()
     private lateinit var mCameraProvider: ProcessCameraProvider
@@ -130,14 +135,18 @@ class MainActivity : AppCompatActivity() {
             ActivityCompat.requestPermissions(this@MainActivity, permissionList, 0)
         }
 
+        val prefs: SharedPreferences = PreferenceManager.getDefaultSharedPreferences(this)
+        // Number of threads in CPU Mode, read before the model is loaded with it
+        threadsNumber = prefs.getString("numThreads", "0")?.toInt()!!
+
         initModel()
+        initScheduling(prefs)
+        // the first camera frame then finds the net ready
+        if (!schedulingTuning.get())
+            GenericDetector.warmUp(registeredModelName(), PROBE_WIDTH, PROBE_HEIGHT)
         initView()
         initViewListener()
 
-        val prefs: SharedPreferences = PreferenceManager.getDefaultSharedPreferences(this)
-        // Number of threads in CPU Mode
-        threadsNumber = prefs.getString("numThreads", "0")?.toInt()!!
-
         // Replace StartActivityForResult()
         // Select picture
         val photoActivity =
@@ -241,10 +250,44 @@ class MainActivity : AppCompatActivity() {
 
     // Init the model
     private fun initModel() {
-        when (useModel) {
+        GenericDetector.setCacheDir(codeCacheDir.absolutePath)
+        val error = when (useModel) {
             NANODET -> NanoDetPlus.init(assets, useGPU, threadsNumber)
             YOLOV5S -> YOLOv5s.init(assets, useGPU, threadsNumber)
+            else -> GenericDetector.LOAD_OK
+        }
+        if (error != GenericDetector.LOAD_OK) {
+            Log.e(TAG, "model load failed: $error")
+            Toast.makeText(this, "Model load failed ($error)", Toast.LENGTH_LONG).show()
+        }
+    }
+    // Place the inference threads as the "scheduling" setting says; "auto" times the candidate plans once
+    // per model, backend and CPU layout and reuses the fastest one afterwards
+    private fun initScheduling(prefs: SharedPreferences) {
+        val mode = prefs.getString("scheduling", "default") ?: "default"
+        if (mode == "default")
+            return
+        val name = registeredModelName()
+        if (mode != "auto") {
+            GenericDetector.setScheduling(name, mode)
+            return
         }
+
+        val key = "schedulingPlan/$name/${if (useGPU) "gpu" else "cpu"}/${GenericDetector.cpuLayout()}"
+        val saved = prefs.getString(key, null)
+        if (saved != null && GenericDetector.setScheduling(name, saved))
+            return
+
+        schedulingTuning.set(true)
+        Thread {
+            // runs the model many times, no separate warm-up needed afterwards
+            val plan = GenericDetector.autotune(name, PROBE_WIDTH, PROBE_HEIGHT)
+            if (plan != null) {
+                Log.i(TAG, "scheduling plan $plan")
+                prefs.edit().putString(key, plan).apply()
+            }
+            schedulingTuning.set(false)
+        }.start()
     }
     // Init the interface
     private fun initView() {
@@ -338,6 +381,12 @@ class MainActivity : AppCompatActivity() {
 //          }
         private const val TAG = "ObjDetection"
         private const val REQUEST_CODE_PERMISSIONS = 10
+        private const val PIPELINE_DEPTH = 4
+        // longest run of frames the tracker covers for the model on a still scene
+        private const val MAX_KEY_INTERVAL = 6
+        // camera-sized blank frame the scheduling plans are timed on and the model is warmed up with
+        private const val PROBE_WIDTH = 640
+        private const val PROBE_HEIGHT = 480
     }
 
 
@@ -409,61 +458,69 @@ class MainActivity : AppCompatActivity() {
     }
 
     private fun detectOnModel(image: ImageProxy, rotationDegrees: Int) {
-        if (detectCamera.get() || detectPhoto.get() || detectVideo.get()) {
+        if (detectPhoto.get() || detectVideo.get() || schedulingTuning.get()) {
             return
         }
-        if (detectService == null) {
-            detectCamera.set(false)
-            return
-        }
-        detectCamera.set(true)
-        startTime = System.currentTimeMillis()
-        val bitmapsrc = imageToBitmap(image) // format conversion
-
-        detectService.execute {
-            val matrix = Matrix()
-            matrix.postRotate(rotationDegrees.toFloat())
-            width = bitmapsrc.width
-            height = bitmapsrc.height
-            val bitmap = Bitmap.createBitmap(bitmapsrc, 0, 0, width, height, matrix, false)
-            detectAndDraw(bitmap)
-            if(errorFlag == 1)
-                showResultOnUI()
+        if (!pipelineStarted) {
+            pipelineStarted = DetectPipeline.start(useModel, PIPELINE_DEPTH, DetectPipeline.DROP_OLDEST, MAX_KEY_INTERVAL)
+            if (!pipelineStarted)
+                return
         }
 
-    }
-
-    private fun imageToBitmap(image: ImageProxy): Bitmap {
-        val nv21 = imageToNV21(image)
-        val yuvImage = YuvImage(nv21, ImageFormat.NV21, image.width, image.height, null)
-        val out = ByteArrayOutputStream()
-        yuvImage.compressToJpeg(Rect(0, 0, yuvImage.width, yuvImage.height), 100, out)
-        val imageBytes = out.toByteArray()
-        try {
-            out.close()
-        } catch (e: IOException) {
-            e.printStackTrace()
-        }
-        return BitmapFactory.decodeByteArray(imageBytes, 0, imageBytes.size)
-    }
-
-    private fun imageToNV21(image: ImageProxy): ByteArray {
+        // The planes are only valid until the ImageProxy is closed, the pipeline copies them and
+        // works on the frame while the camera delivers the next ones
         val planes = image.planes
         val y = planes[0]
         val u = planes[1]
         val v = planes[2]
-        val yBuffer = y.buffer
-        val uBuffer = u.buffer
-        val vBuffer = v.buffer
-        val ySize = yBuffer.remaining()
-        val uSize = uBuffer.remaining()
-        val vSize = vBuffer.remaining()
-        val nv21 = ByteArray(ySize + uSize + vSize)
-        // U and V are swapped
-        yBuffer[nv21, 0, ySize]
-        vBuffer[nv21, ySize, vSize]
-        uBuffer[nv21, ySize + vSize, uSize]
-        return nv21
+        width = image.width
+        height = image.height
+
+        val frameId = DetectPipeline.submitYUV(
+            y.buffer, u.buffer, v.buffer, width, height,
+            y.rowStride, u.rowStride, u.pixelStride, rotationDegrees, threshold, nmsThreshold
+        )
+
+        // upright copy for display, kept until the frame leaves the pipeline
+        if (frameId >= 0) {
+            val transposed = rotationDegrees == 90 || rotationDegrees == 270
+            val frameWidth = if (transposed) height else width
+            val frameHeight = if (transposed) width else height
+            val index = (frameId % cameraFrames.size).toInt()
+            var frame = cameraFrames[index]
+            if (frame == null || frame.width != frameWidth || frame.height != frameHeight) {
+                frame = Bitmap.createBitmap(frameWidth, frameHeight, Bitmap.Config.ARGB_8888)
+                cameraFrames[index] = frame
+            }
+            CameraFrame.toBitmap(
+                y.buffer, u.buffer, v.buffer, width, height,
+                y.rowStride, u.rowStride, u.pixelStride, rotationDegrees, frame!!
+            )
+        }
+
+        // show the newest finished frame, older ones are already stale
+        var latestId = -1L
+        while (true) {
+            val frameId = DetectPipeline.pollInto(cameraBoxes, cameraInfo)
+            if (frameId < 0)
+                break
+            latestId = frameId
+        }
+        if (latestId < 0)
+            return
+        val frame = cameraFrames[(latestId % cameraFrames.size).toInt()] ?: return
+
+        // FPS from the interval between two results, i.e. the pipeline throughput
+        startTime = lastResultTime
+        lastResultTime = System.currentTimeMillis()
+        mutableBitmap = drawBoxRects(frame, cameraBoxes)
+        if (errorFlag == 1)
+            showResultOnUI()
+    }
+
+    private fun stopCameraPipeline() {
+        DetectPipeline.stop()
+        pipelineStarted = false
     }
 
     private fun showResultOnUI() {
@@ -496,6 +553,22 @@ class MainActivity : AppCompatActivity() {
             YOLOV5S -> result = YOLOv5s.detect(image, threshold, nmsThreshold)
         }
 
+        return drawResult(image, result)
+    }
+
+    // Photos much larger than the model input are cut into tiles, small objects would vanish in one letterbox
+    private fun detectPhotoAndDraw(image: Bitmap): Bitmap? {
+        val inputSize = if (useModel == YOLOV5S) 640 else 320
+        if (maxOf(image.width, image.height) <= 2 * inputSize) {
+            return detectAndDraw(image)
+        }
+
+        val name = if (useModel == YOLOV5S) "YOLOv5s" else "NanoDetPlus"
+        val result = GenericDetector.detectTiled(name, image, threshold, nmsThreshold, 0, 0.2f, true)
+        return drawResult(image, result)
+    }
+
+    private fun drawResult(image: Bitmap, result: Array<Box>?): Bitmap? {
         if (result == null) {
             detectCamera.set(false)
             errorFlag = 0
@@ -509,6 +582,11 @@ class MainActivity : AppCompatActivity() {
         return mutableBitmap
     }
 
+    // name of the loaded model in the native registry
+    private fun registeredModelName(): String {
+        return if (useModel == YOLOV5S) "YOLOv5s" else "NanoDetPlus"
+    }
+
     private fun getModelName(): String {
         var modelName = "NULL"
         when (useModel) {
@@ -549,6 +627,36 @@ class MainActivity : AppCompatActivity() {
         return bitmapCopy
     }
 
+    private fun drawBoxRects(bitmap: Bitmap, results: BoxBuffer): Bitmap {
+        if (results.count == 0) {
+            return bitmap
+        }
+        val bitmapCopy = bitmap.copy(Bitmap.Config.ARGB_8888, true)
+
+        val canvas = Canvas(bitmapCopy)
+        val boxPaint = Paint()
+        boxPaint.alpha = 200
+        boxPaint.strokeWidth = 4 * bitmapCopy.width / 800.0f
+        boxPaint.textSize = 30 * bitmapCopy.width / 800.0f
+        for (i in 0 until results.count) {
+            val x0 = results.x0(i)
+            val y0 = results.y0(i)
+            boxPaint.color = Box.color(results.label(i))
+            boxPaint.style = Paint.Style.FILL
+            canvas.drawText(
+                Box.labelName(results.label(i)) + java.lang.String.format(
+                    Locale.CHINESE,
+                    " %.3f",
+                    results.score(i)
+                ), x0 + 3, y0 + 30 * bitmapCopy.width / 1000.0f, boxPaint
+            )
+            boxPaint.style = Paint.Style.STROKE
+            canvas.drawRect(x0, y0, x0 + results.w(i), y0 + results.h(i), boxPaint)
+        }
+
+        return bitmapCopy
+    }
+
     private fun runByPhoto(resultCode: Int, data: Intent?) {
         if (resultCode != RESULT_OK || data == null) {
             Toast.makeText(this, "Photo error", Toast.LENGTH_SHORT).show()
@@ -558,6 +666,10 @@ class MainActivity : AppCompatActivity() {
             Toast.makeText(this, "Video is running", Toast.LENGTH_SHORT).show()
             return
         }
+        if (schedulingTuning.get()) {
+            Toast.makeText(this, "Tuning threads, try again", Toast.LENGTH_SHORT).show()
+            return
+        }
         detectPhoto.set(true)
         var image: Bitmap? = getPicture(data.data)
         if (image == null) {
@@ -575,6 +687,7 @@ class MainActivity : AppCompatActivity() {
         }
 
         mCameraProvider.unbindAll()
+        stopCameraPipeline()
         binding.viewFinder.visibility = View.INVISIBLE
         binding.btnBack.visibility = View.VISIBLE
         binding.btnBack.setOnClickListener {
@@ -595,7 +708,7 @@ class MainActivity : AppCompatActivity() {
             width = image.width
             height = image.height
 
-            mutableBitmap = detectAndDraw(imageCopy)
+            mutableBitmap = detectPhotoAndDraw(imageCopy)
             val dur = System.currentTimeMillis() - start
             runOnUiThread {
                 val modelName = getModelName()
@@ -693,11 +806,16 @@ class MainActivity : AppCompatActivity() {
             Toast.makeText(this, "Video is running", Toast.LENGTH_SHORT).show()
             return
         }
+        if (schedulingTuning.get()) {
+            Toast.makeText(this, "Tuning threads, try again", Toast.LENGTH_SHORT).show()
+            return
+        }
         detectVideo.set(true)
         Toast.makeText(this@MainActivity, "FPS is not accurate!", Toast.LENGTH_SHORT).show()
         binding.sbVideo.visibility = View.VISIBLE
         binding.sbVideoSpeed.visibility = View.VISIBLE
         mCameraProvider.unbindAll()
+        stopCameraPipeline()
         binding.viewFinder.visibility = View.INVISIBLE
         binding.btnBack.visibility = View.VISIBLE
 
@@ -726,6 +844,7 @@ class MainActivity : AppCompatActivity() {
                 mmr!!.extractMetadata(FFmpegMediaMetadataRetriever.METADATA_KEY_VIDEO_ROTATION) // rotation
             val duration = dur.toInt()
             val fps = sfps.toFloat()
+            val temporal = TemporalDetector.start(useModel, MAX_KEY_INTERVAL)
 
             val rotate = rota.toFloat()
             binding.sbVideo.max = duration * 1000
@@ -745,11 +864,17 @@ class MainActivity : AppCompatActivity() {
                 height = b.height
                 val bitmap = Bitmap.createBitmap(b, 0, 0, width, height, matrix, false)
                 startTime = System.currentTimeMillis()
-                detectAndDraw(bitmap.copy(Bitmap.Config.ARGB_8888, true))
+                val frame = bitmap.copy(Bitmap.Config.ARGB_8888, true)
+                if (temporal) {
+                    drawResult(frame, TemporalDetector.detect(frame, threshold, nmsThreshold, null))
+                } else {
+                    detectAndDraw(frame)
+                }
                 showResultOnUI()
                 frameDis = 1.0f / fps * 1000 * 1000 * videoSpeed
             }
             mmr!!.release()
+            TemporalDetector.stop()
             if (detectVideo.get()) {
                 runOnUiThread {
                     binding.sbVideo.visibility = View.GONE
@@ -775,6 +900,7 @@ class MainActivity : AppCompatActivity() {
 
 //        analyzing = false
         mCameraProvider.unbindAll()
+        stopCameraPipeline()
         if (cameraExecutor != null) {
             cameraExecutor.shutdown()
             cameraExecutor = null
@@ -0,0 +1,18 @@
+package com.objdetection
+
+import android.graphics.Bitmap
+
+// Mounted cameras: the model only runs on crops around what moved, boxes elsewhere are carried over
+// A full frame is detected every refreshInterval frames and whenever most of the scene changed
+object MotionRoiDetector {
+    // model is MainActivity's NANODET / YOLOV5S, the model must already be initialized
+    external fun start(model: Int, refreshInterval: Int): Boolean
+    external fun stop()
+
+    // Frames of one stream, in order
+    external fun detect(bitmap: Bitmap, threshold: Float, nms_threshold: Float): Array<Box>?
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}
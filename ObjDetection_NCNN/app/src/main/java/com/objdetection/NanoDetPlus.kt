@@ -2,11 +2,41 @@ package com.objdetection
 
 import android.content.res.AssetManager
 import android.graphics.Bitmap
+import java.nio.ByteBuffer
+import java.nio.FloatBuffer
+import java.nio.IntBuffer
 
 object NanoDetPlus {
-    external fun init(manager: AssetManager?, useGPU: Boolean, threadsNumber: Int)
+    // 0, or the negative load error (see GenericDetector.LOAD_*)
+    external fun init(manager: AssetManager?, useGPU: Boolean, threadsNumber: Int): Int
     external fun detect(bitmap: Bitmap?, threshold: Float, nms_threshold: Float): Array<Box>?
 
+    // YUV_420_888 planes (direct buffers) of a camera frame, boxes are in the rotated frame
+    external fun detectYUV(
+        y: ByteBuffer, u: ByteBuffer, v: ByteBuffer, width: Int, height: Int,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int, rotation: Int,
+        threshold: Float, nms_threshold: Float
+    ): Array<Box>?
+
+    // Allocation-free variants writing into the buffers of a BoxBuffer, return the box count or -1
+    external fun detectInto(
+        bitmap: Bitmap, threshold: Float, nms_threshold: Float, boxes: FloatBuffer, labels: IntBuffer
+    ): Int
+
+    external fun detectYUVInto(
+        y: ByteBuffer, u: ByteBuffer, v: ByteBuffer, width: Int, height: Int,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int, rotation: Int,
+        threshold: Float, nms_threshold: Float, boxes: FloatBuffer, labels: IntBuffer
+    ): Int
+
+    fun detectInto(bitmap: Bitmap, threshold: Float, nms_threshold: Float, out: BoxBuffer): Int {
+        out.count = maxOf(detectInto(bitmap, threshold, nms_threshold, out.boxes, out.labels), 0)
+        return out.count
+    }
+
+    // Offline jobs (galleries, decoded video): result i belongs to bitmaps[i]
+    external fun detectBatch(bitmaps: Array<Bitmap>, threshold: Float, nms_threshold: Float): Array<Array<Box>>?
+
     init {
         System.loadLibrary("objdetection")
     }
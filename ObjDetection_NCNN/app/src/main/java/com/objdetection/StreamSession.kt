@@ -0,0 +1,28 @@
+package com.objdetection
+
+import java.nio.ByteBuffer
+import java.nio.FloatBuffer
+import java.nio.IntBuffer
+
+// Camera stream of one fixed frame size: the extractor, letterbox and blob pools are set up on the first
+// frame and reused by every following one, so the memory stays where the first frame left it
+object StreamSession {
+    // model is MainActivity's NANODET / YOLOV5S, the model must already be initialized
+    // width x height is the frame once rotated; warmUp sizes the pools with a blank frame right away
+    external fun start(model: Int, width: Int, height: Int, warmUp: Boolean): Boolean
+    external fun stop()
+
+    // Box count, -1 without a session or for a frame of another size
+    external fun detectYUVInto(
+        y: ByteBuffer, u: ByteBuffer, v: ByteBuffer, width: Int, height: Int,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int, rotation: Int,
+        threshold: Float, nms_threshold: Float, boxes: FloatBuffer, labels: IntBuffer
+    ): Int
+
+    // JSON: frames, pool_bytes, peak_blob_bytes, peak_workspace_bytes, input_bytes, peak_bytes, grown_frames
+    external fun footprint(): String?
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}
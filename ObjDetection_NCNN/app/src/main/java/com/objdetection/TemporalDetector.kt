@@ -0,0 +1,18 @@
+package com.objdetection
+
+import android.graphics.Bitmap
+
+// Video frames: the model runs on key frames only, boxes are tracked in between
+// Key frames come every maxKeyInterval frames on a still scene and more often when things move
+object TemporalDetector {
+    // model is MainActivity's NANODET / YOLOV5S, the model must already be initialized
+    external fun start(model: Int, maxKeyInterval: Int): Boolean
+    external fun stop()
+
+    // Frames in display order, trackIds (optional) receives the stable id of each box
+    external fun detect(bitmap: Bitmap, threshold: Float, nms_threshold: Float, trackIds: IntArray?): Array<Box>?
+
+    init {
+        System.loadLibrary("objdetection")
+    }
+}